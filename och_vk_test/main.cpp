@@ -2,8 +2,20 @@
 #include <GLFW/glfw3.h>
 
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 #include <vector>
 #include <unordered_map>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
 
 #include "och_fmt.h"
 #include "och_fio.h"
@@ -11,7 +23,18 @@
 
 #include "och_error_handling.h"
 #include "och_bmp_header.h"
+#include "och_vt_header.h"
+#include "och_latency_histogram.h"
+#include "och_trace.h"
+#include "och_benchmark.h"
 #include "och_matmath.h"
+#include "och_render_graph.h"
+#include "och_state_tracker.h"
+#include "och_shader_reload.h"
+#include "och_pipeline_cache.h"
+#include "och_shader_blobs.h"
+#include "och_task_graph.h"
+#include "och_startup_report.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -25,9 +48,25 @@
 
 #define OCH_VALIDATE
 
+// VK_KHR_present_wait needs headers from SDK 1.2.189 on. Without it, latency is measured until vkQueuePresentKHR returns.
+#if defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+#define OCH_PRESENT_WAIT
+#endif // VK_KHR_present_id && VK_KHR_present_wait
+
+// Single-asset scene used when no manifest is passed via --scene
 #define OCH_ASSET_NAME "viking_room"
 //#define OCH_ASSET_NAME "vase"
 
+// Sample the asset through a paged virtual texture instead of a fully resident one
+//#define OCH_VIRTUAL_TEXTURE
+
+// Bind all textures as one partially bound descriptor array and draw through an indirect buffer
+//#define OCH_BINDLESS
+
+#if defined(OCH_VIRTUAL_TEXTURE) && defined(OCH_BINDLESS)
+#error OCH_VIRTUAL_TEXTURE and OCH_BINDLESS cannot be combined
+#endif
+
 #define OCH_ASSET_OFFSET {0.0F, 0.0F, 0.3F}
 #define OCH_ASSET_SCALE 2.0F
 
@@ -68,6 +107,10 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback_fn(VkDebugUtilsMessageSeverityFlag
 
 void framebuffer_resize_callback_fn(GLFWwindow* window, int width, int height);
 
+void key_callback_fn(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+void print_error_stack();
+
 VkDebugUtilsMessengerCreateInfoEXT populate_messenger_create_info() noexcept
 {
 	VkDebugUtilsMessengerCreateInfoEXT create_info{};
@@ -99,11 +142,10 @@ struct swapchain_support_details
 	std::vector<VkPresentModeKHR> present_modes{};
 };
 
+// Premultiplied on the CPU, so the vertex shaders take a single matrix multiply
 struct uniform_buffer_obj
 {
-	och::mat4 model;
-	och::mat4 view;
-	och::mat4 projection;
+	och::mat4 model_view_projection;
 };
 
 struct vertex
@@ -131,6 +173,157 @@ static_assert(vertex::attribute_descs[0].offset == offsetof(vertex, vertex::pos)
 static_assert(vertex::attribute_descs[1].offset == offsetof(vertex, vertex::col));
 static_assert(vertex::attribute_descs[2].offset == offsetof(vertex, vertex::tex_pos));
 
+enum gpu_scope : uint32_t
+{
+	gpu_scope_render_pass,
+	gpu_scope_vt_upload,
+	gpu_scope_texture_stream,
+	gpu_scope_cnt,
+};
+
+static constexpr const char* gpu_scope_names[gpu_scope_cnt]{ "render pass", "vt upload", "texture stream" };
+
+// Keeps the most recent samples of a timing, so its summary follows the current workload
+struct rolling_stats
+{
+	static constexpr uint32_t window = 512;
+
+	float samples[window];
+
+	uint32_t sample_cnt = 0;
+
+	uint32_t next_idx = 0;
+
+	void add(float sample) noexcept
+	{
+		samples[next_idx] = sample;
+
+		next_idx = (next_idx + 1) % window;
+
+		if (sample_cnt != window)
+			++sample_cnt;
+	}
+
+	void summarize(float& out_min, float& out_avg, float& out_p99) const
+	{
+		std::vector<float> sorted(samples, samples + sample_cnt);
+
+		std::sort(sorted.begin(), sorted.end());
+
+		float sum = 0.0F;
+
+		for (float sample : sorted)
+			sum += sample;
+
+		out_min = sorted.empty() ? 0.0F : sorted.front();
+
+		out_avg = sorted.empty() ? 0.0F : sum / sorted.size();
+
+		out_p99 = sorted.empty() ? 0.0F : sorted[(sorted.size() * 99) / 100];
+	}
+};
+
+enum cpu_phase : uint32_t
+{
+	cpu_phase_frame,
+	cpu_phase_streaming,
+	cpu_phase_frame_wait,
+	cpu_phase_acquire,
+	cpu_phase_uniforms,
+	cpu_phase_submit,
+	cpu_phase_present,
+	cpu_phase_cnt,
+};
+
+static constexpr const char* cpu_phase_names[cpu_phase_cnt]{ "frame", "streaming", "frame wait", "acquire", "uniforms", "submit", "present" };
+
+// Records the lifetime of the timer into a histogram, in microseconds, and as a trace zone
+struct scoped_phase_timer
+{
+	latency_histogram& histogram;
+
+	och::time beg_t;
+
+	och::trace_zone zone;
+
+	scoped_phase_timer(latency_histogram& histogram, const char* name) noexcept : histogram{ histogram }, beg_t{ och::time::now() }, zone{ name } {}
+
+	~scoped_phase_timer() noexcept
+	{
+		histogram.record(static_cast<uint64_t>((och::time::now() - beg_t).microseconds()));
+	}
+};
+
+struct pending_present
+{
+	uint64_t id;
+	och::time input_t;
+};
+
+struct scene_mesh
+{
+	std::string model_path;
+	glm::vec3 offset;
+	float scale;
+	uint32_t texture_idx;
+
+	// Draw range inside the vertex and index mega-buffers
+	uint32_t first_index;
+	uint32_t index_cnt;
+	int32_t vertex_offset;
+};
+
+struct scene_texture
+{
+	VkImage image = nullptr;
+	VkDeviceMemory memory = nullptr;
+	VkImageView view = nullptr;
+};
+
+// Scene texture decoded during initialisation, with room for its whole mip chain
+struct decoded_texture
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t mip_levels;
+	std::vector<VkDeviceSize> mip_offsets;
+	std::vector<uint32_t> texels;
+};
+
+struct decoded_mesh
+{
+	std::vector<vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// Everything a submitted mip generation needs until it retired
+struct mip_gen_job
+{
+	VkCommandBuffer command_buffer = nullptr;
+	VkDescriptorPool descriptor_pool = nullptr;
+	std::vector<VkImageView> level_views;
+	VkBuffer staging_buf = nullptr;
+	VkDeviceMemory staging_buf_mem = nullptr;
+	uint64_t timeline_value = 0;
+};
+
+// A GLSL source in shaders/ and one of the SPIR-V files compiled from it
+struct shader_target
+{
+	const char* source;
+	const char* defines;
+	const char* output;
+	bool is_scene_shader;
+};
+
+struct mega_buffer
+{
+	VkBuffer buffer = nullptr;
+	VkDeviceMemory memory = nullptr;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize used = 0;
+};
+
 namespace std {
 	template<> struct hash<vertex> {
 		size_t operator()(vertex const& vertex) const {
@@ -146,7 +339,54 @@ namespace std {
 
 struct hello_vulkan
 {
-	static constexpr uint32_t max_frames_in_flight = 2;
+	// Capacity of the per-frame arrays; frames_in_flight picks how many of them are cycled through
+	static constexpr uint32_t max_frames_in_flight = 4;
+
+	// Indexed by och::benchmark_present_mode, which also names them
+	static constexpr VkPresentModeKHR policy_present_modes[]{ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+
+	static constexpr uint32_t texture_stream_tail_dim = 256;
+
+	// Same as compile_shaders.bat, with outputs named like the embedded och::shader_blobs they replace once recompiled.
+	// Changes to scene shaders rebuild the scene pipelines, others only take effect when their pipeline is created next.
+	static constexpr shader_target shader_targets[]{
+		{ "shader.vert", "", "vert.spv", true },
+		{ "depth.vert", "", "depth_vert.spv", true },
+		{ "shader.frag", "", "frag.spv", true },
+		{ "shader.frag", "-DOCH_VIRTUAL_TEXTURE", "frag_vt.spv", true },
+		{ "shader.frag", "-DOCH_BINDLESS", "frag_bindless.spv", true },
+		{ "downsample.comp", "", "downsample_comp.spv", false },
+	};
+
+	static_assert([]() { for (const shader_target& target : shader_targets) if (!och::find_shader_blob(target.output)) return false; return true; }(), "Every shader target needs an embedded blob");
+
+	// Levels one dispatch of downsample.comp writes at most, matching its view array
+	static constexpr uint32_t downsample_max_levels = 12;
+
+	static constexpr uint32_t vt_page_dim = 128;
+
+	static constexpr uint32_t vt_border_dim = 4;
+
+	static constexpr uint32_t vt_atlas_tiles = 16;
+
+	static constexpr uint32_t vt_feedback_scale = 8;
+
+	static constexpr uint32_t vt_max_uploads_per_frame = 8;
+
+	static constexpr uint32_t bindless_max_textures = 4096;
+
+	static constexpr VkDeviceSize mega_buffer_min_bytes = 1 << 20;
+
+	static constexpr uint32_t gpu_profile_report_interval = 1000;
+
+	static constexpr uint32_t msaa_tier_cnt = 4;
+
+	static constexpr const char* msaa_tier_names[msaa_tier_cnt]{ "off", "2x", "4x", "8x" };
+
+	static constexpr float render_scale_min = 0.5F;
+
+	// Render pass timings averaged for every adjustment of render_scale
+	static constexpr uint32_t render_scale_interval = 8;
 
 #ifdef OCH_VALIDATE
 	static constexpr const char* required_validation_layers[]{ "VK_LAYER_KHRONOS_validation" };
@@ -154,13 +394,139 @@ struct hello_vulkan
 
 	static constexpr const char* required_device_extensions[]{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
-	std::vector<vertex> vertices;
+#ifdef _WIN32
+	static constexpr VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+	static constexpr VkTimeDomainEXT host_time_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif // _WIN32
 
-	std::vector<uint32_t> indices;
+	const char* scene_path = nullptr;
+
+	// Sorted by texture, so consecutive draws share descriptor sets
+	std::vector<scene_mesh> scene_meshes;
+
+	std::vector<std::string> scene_texture_paths;
+
+	// Entry 0 stays empty, as the first texture is streamed into vk_texture_image
+	std::vector<scene_texture> scene_textures;
+
+	// Filled by initialisation tasks ahead of the uploads, and released by them
+	std::vector<decoded_texture> decoded_textures;
+
+	std::vector<decoded_mesh> decoded_meshes;
 
 	uint32_t window_width = 1440;
 	uint32_t window_height = 810;
 
+	// Renders window_width x window_height offscreen images instead of presenting to a window
+	bool headless = false;
+
+	// Matched against device names (substring) and UUIDs; the best scoring match wins
+	const char* physical_device_override = nullptr;
+
+	uint32_t headless_frame_cnt = 1000;
+
+	uint32_t frames_in_flight = 2;
+
+	// AA tier, as the upper bound for vk_msaa_samples, which is further limited by the device. Cycled with M.
+	uint32_t msaa_sample_limit = 4;
+
+	// Shades every sample instead of every pixel if the device supports it. Toggled with N.
+	bool sample_shading = false;
+
+	bool has_sample_rate_shading = false;
+
+	// Set from the key callback, so AA tier and depth pre-pass changes happen between frames
+	bool msaa_change_requested = false;
+
+	// Depth is 1 at the near plane and falls towards 0 at an infinite far plane, which spreads float precision evenly over distance
+	bool reversed_z = true;
+
+	// Lays down depth in a position-only subpass, so the main subpass shades every pixel once with an EQUAL test. Toggled with Z.
+	bool depth_prepass = false;
+
+	// Toggled with B
+	VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+
+	// Draws triangle edges only if the device supports it. Toggled with L.
+	bool wireframe = false;
+
+	bool has_fill_mode_non_solid = false;
+
+	// Toggled with T
+	bool depth_test = true;
+
+	// och::shader_feature_* bits. Vertex colour tinting is toggled with C, texture coordinate display with U.
+	uint32_t shader_features = 0;
+
+	// Render pass time dynamic resolution aims for; 0 always renders at the swapchain's resolution
+	float gpu_frame_budget_ms = 0.0F;
+
+	// Fraction of the swapchain extent rendered to, see update_render_scale
+	float render_scale = 1.0F;
+
+	float render_scale_gpu_ms_sum = 0.0F;
+
+	uint32_t render_scale_sample_cnt = 0;
+
+	// Used if the surface supports it, with FIFO as the fallback. Cycled with V.
+	VkPresentModeKHR preferred_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+	VkPresentModeKHR vk_present_mode;
+
+	// 0 asks for one image more than the surface's minimum
+	uint32_t requested_swapchain_image_cnt = 0;
+
+	// Set from the key callback and applied between frames by apply_present_policy. F cycles frames in flight.
+	uint32_t next_frames_in_flight = 0;
+
+	bool present_mode_change_requested = false;
+
+	// Requires VK_KHR_present_id and VK_KHR_present_wait, see OCH_PRESENT_WAIT
+	bool has_present_wait = false;
+
+#ifdef OCH_PRESENT_WAIT
+	PFN_vkWaitForPresentKHR vk_wait_for_present = nullptr;
+#endif // OCH_PRESENT_WAIT
+
+	uint64_t next_present_id = 1;
+
+	// Presents not yet seen on screen, oldest first
+	std::vector<pending_present> pending_presents;
+
+	// When update_uniforms sampled input and animation for the frame being submitted
+	och::time frame_input_t;
+
+	// Microseconds from frame_input_t until the frame was displayed, or until vkQueuePresentKHR returned without present wait
+	latency_histogram present_latency_histogram;
+
+	och::time latency_window_beg_t;
+
+	uint64_t latency_window_frame_cnt = 0;
+
+	// Number of times every scene mesh is drawn
+	uint32_t instance_cnt = 1;
+
+	// Runs headless_frame_cnt frames even with a window and fills benchmark_stats
+	bool benchmark = false;
+
+	// Frames rendered before any statistics are kept, so the texture stream and driver caches settle
+	uint32_t warmup_frame_cnt = 0;
+
+	// Seconds the animation advances per frame; 0 follows the wall clock
+	float fixed_timestep = 0.0F;
+
+	uint64_t animation_frame_idx = 0;
+
+	// Projection times view, only recomputed by update_uniforms once the swapchain extent changed
+	och::mat4 view_projection;
+
+	bool camera_dirty = true;
+
+	och::benchmark_result benchmark_stats{};
+
+	std::vector<VkDeviceMemory> vk_offscreen_images_memory;
+
 	GLFWwindow* window = nullptr;
 
 	VkInstance vk_instance = nullptr;
@@ -175,6 +541,9 @@ struct hello_vulkan
 
 	VkQueue vk_present_queue = nullptr;
 
+	// Same as vk_graphics_queue unless the device has a compute family without graphics
+	VkQueue vk_compute_queue = nullptr;
+
 	VkSwapchainKHR vk_swapchain = nullptr;
 
 	std::vector<VkImage> vk_swapchain_images;
@@ -191,26 +560,73 @@ struct hello_vulkan
 
 	VkPipelineLayout vk_pipeline_layout = nullptr;
 
+	// Owned by pipeline_cache, see select_pipeline_variant
 	VkPipeline vk_graphics_pipeline = nullptr;
 
+	VkPipeline vk_depth_prepass_pipeline = nullptr;
+
+	och::pipeline_variant_cache pipeline_cache;
+
 	std::vector<VkFramebuffer> vk_swapchain_framebuffers;
 
 	VkCommandPool vk_command_pool = nullptr;
 
 	std::vector<VkCommandBuffer> vk_command_buffers;
 
+	// Binary, as swapchains cannot wait on or signal timeline semaphores
 	VkSemaphore vk_image_available_semaphores[max_frames_in_flight];
 	VkSemaphore vk_render_complete_semaphores[max_frames_in_flight];
-	VkFence vk_inflight_fences[max_frames_in_flight];
-	std::vector<VkFence> vk_images_inflight_fences;
 
-	VkBuffer vk_vertex_buffer = nullptr;
+	// Graphics queue timeline. Frame N signals N, so frame N's per-frame resources are free again once frame N - frames_in_flight reached its value.
+	VkSemaphore vk_frame_timeline = nullptr;
+
+	// Value signalled by the last submitted frame
+	uint64_t frame_timeline_value = 0;
+
+	// Value of the last frame that rendered to each swapchain image, 0 if there was none
+	std::vector<uint64_t> vk_image_timeline_values;
+
+	// Two timestamps per gpu_scope for every swapchain image, plus one group for the texture stream's own submits.
+	// Results are only read once the group's frame value was reached, so readback never stalls.
+	VkQueryPool vk_timestamp_query_pool = nullptr;
+
+	std::vector<uint32_t> gpu_scope_written_masks;
+
+	float gpu_timestamp_period_ms;
+
+	uint64_t gpu_timestamp_valid_mask;
+
+	rolling_stats gpu_scope_stats[gpu_scope_cnt];
+
+	// Render pass timings per AA tier, see msaa_tier_idx
+	rolling_stats msaa_tier_stats[msaa_tier_cnt * 2];
 
-	VkDeviceMemory vk_vertex_buffer_memory = nullptr;
+	uint64_t gpu_profiled_frame_cnt = 0;
 
-	VkBuffer vk_index_buffer = nullptr;
+	// Set if VK_EXT_calibrated_timestamps can relate device timestamps to host_time_domain, which trace zones use
+	bool has_calibrated_timestamps = false;
 
-	VkDeviceMemory vk_index_buffer_memory = nullptr;
+	PFN_vkGetCalibratedTimestampsEXT vk_get_calibrated_timestamps = nullptr;
+
+	uint64_t gpu_calibration_ticks;
+
+	uint64_t gpu_calibration_host_ns;
+
+	const char* trace_path = nullptr;
+
+	// Stages of startup until the first frame, printed and written to startup_report_path once it is out
+	och::startup_report startup_report;
+
+	const char* startup_report_path = nullptr;
+
+	latency_histogram cpu_phase_histograms[cpu_phase_cnt];
+
+	// Set from the key callback, so the dump happens between frames
+	bool profile_dump_requested = false;
+
+	mega_buffer vk_vertex_mega_buffer;
+
+	mega_buffer vk_index_mega_buffer;
 
 	std::vector<VkBuffer> vk_uniform_buffers;
 	
@@ -218,1308 +634,4739 @@ struct hello_vulkan
 
 	VkDescriptorPool vk_descriptor_pool = nullptr;
 
+	// One set per swapchain image and descriptor texture, see descriptor_set_idx
 	std::vector<VkDescriptorSet> vk_descriptor_sets;
 
-	uint32_t vk_texture_image_mipmap_levels;
+	// Layouts and accesses of the sampled images, which are only ever touched by upload and mip generation commands outside the frame graph
+	och::resource_state_tracker resource_states;
 
-	VkImage vk_texture_image = nullptr;
+	// Requires VK_KHR_synchronization2, see OCH_SYNCHRONIZATION2
+	bool has_synchronization2 = false;
 
-	VkDeviceMemory vk_texture_image_memory = nullptr;
+	// Mips of fully uploaded textures are generated by downsample.comp on the compute queue. Without it they are downsampled on the CPU.
+	bool has_compute_mip_generation = false;
 
-	VkImageView vk_texture_image_view = nullptr;
+	VkCommandPool vk_compute_command_pool = nullptr;
 
-	VkSampler vk_texture_sampler = nullptr;
+	VkDescriptorSetLayout vk_downsample_set_layout = nullptr;
 
-	VkImage vk_depth_image = nullptr;
+	VkPipelineLayout vk_downsample_pipeline_layout = nullptr;
 
-	VkDeviceMemory vk_depth_image_memory = nullptr;
+	VkPipeline vk_downsample_pipeline = nullptr;
 
-	VkImageView vk_depth_image_view = nullptr;
+	// Global atomic counter of downsample.comp, zeroed before every dispatch
+	VkBuffer vk_downsample_counter = nullptr;
 
-	VkSampleCountFlagBits vk_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	VkDeviceMemory vk_downsample_counter_memory = nullptr;
 
-	VkImage vk_colour_image = nullptr;
+	// Compute queue timeline. Job N signals N and frames wait for the last submitted value while any job is outstanding.
+	VkSemaphore vk_mip_timeline = nullptr;
 
-	VkDeviceMemory vk_colour_image_memory = nullptr;
+	uint64_t mip_timeline_value = 0;
 
-	VkImageView vk_colour_image_view = nullptr;
+	std::vector<mip_gen_job> mip_gen_jobs;
 
-	size_t curr_frame = 0;
+	uint32_t vk_texture_image_mipmap_levels;
 
-	bool framebuffer_resized = false;
+	uint32_t vk_texture_width;
 
-#ifdef OCH_VALIDATE
-	VkDebugUtilsMessengerEXT vk_debug_messenger = nullptr;
-#endif // OCH_VALIDATE
+	uint32_t vk_texture_height;
 
-	err_info run()
-	{
-		init_window();
+	uint32_t vk_texture_resident_level;
 
-		check(init_vulkan());
+	VkImage vk_texture_image = nullptr;
 
-		check(main_loop());
+	VkDeviceMemory vk_texture_image_memory = nullptr;
 
-		cleanup();
+	VkImageView vk_texture_image_view = nullptr;
 
-		return {};
-	}
+	std::vector<VkImageView> vk_texture_image_level_views;
 
-	void init_window()
-	{
-		glfwInit();
+	std::vector<VkDeviceSize> texture_mip_offsets;
 
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	uint32_t texture_stream_tail_level;
 
-		// glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	uint32_t texture_stream_next_level = ~0u;
 
-		window = glfwCreateWindow(window_width, window_height, "Hello Vulkan", nullptr, nullptr);
+	uint32_t texture_stream_pending_level = ~0u;
 
-		glfwSetWindowUserPointer(window, this);
+	VkBuffer texture_stream_staging_buf = nullptr;
 
-		glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback_fn);
-	}
+	VkDeviceMemory texture_stream_staging_buf_mem = nullptr;
 
-	err_info init_vulkan()
-	{
-		check(create_vk_instance());
+	uint8_t* texture_stream_staging_data = nullptr;
 
-		check(create_vk_debug_messenger());
+	VkCommandBuffer texture_stream_command_buffer = nullptr;
 
-		check(create_vk_surface());
+	// Frame value by which the pending level's upload has completed. It is submitted ahead of that frame on the same queue.
+	uint64_t texture_stream_pending_value = 0;
 
-		check(select_vk_physical_device());
+	std::thread texture_stream_thread;
 
-		check(create_vk_logical_device());
+	std::atomic<bool> texture_stream_ready = false;
 
-		check(create_vk_swapchain());
+	std::atomic<bool> texture_stream_failed = false;
 
-		check(get_vk_swapchain_views());
+	std::vector<bool> vk_descriptor_sets_stale;
 
-		check(create_vk_render_pass());
+	// Shader hot reload in interactive runs, see shader_reload_worker
+	std::thread shader_reload_thread;
 
-		check(create_vk_descriptor_set_layout());
+	std::atomic<bool> shader_reload_stop = false;
 
-		check(create_vk_graphics_pipeline());
+	// Bit i is set once shader_targets[i] was recompiled, after which its SPIR-V is loaded from shaders/ instead of the embedded blob
+	std::atomic<uint32_t> reloaded_shader_mask = 0;
 
-		check(create_vk_command_pool());
+	// Pipelines replaced by a rebuild, each with the frame timeline value after which no submitted frame uses it anymore
+	std::vector<std::pair<VkPipeline, uint64_t>> retired_pipelines;
 
-		check(create_vk_colour_resources());
+	// Set for every command buffer when pipelines were swapped, so each is re-recorded once its image comes up next
+	std::vector<bool> vk_command_buffers_stale;
 
-		check(create_vk_depth_resources());
+#ifdef OCH_BINDLESS
+	uint32_t bindless_texture_capacity;
 
-		check(create_vk_swapchain_framebuffers());
+	// Slot i holds scene texture i, with slot 0 being the streamed one
+	std::vector<VkImageView> bindless_texture_views;
 
-		check(create_vk_texture_image());
+	// Views last written to binding 2 of each descriptor set, so stale sets only rewrite the slots that changed
+	std::vector<std::vector<VkImageView>> bindless_written_views;
 
-		check(create_vk_texture_image_view());
+	std::vector<VkDrawIndexedIndirectCommand> vk_draw_commands;
 
-		check(create_vk_texture_sampler());
+	VkBuffer vk_indirect_buffer = nullptr;
 
-		check(load_obj_model());
+	VkDeviceMemory vk_indirect_buffer_memory = nullptr;
+#endif // OCH_BINDLESS
 
-		check(create_vk_vertex_buffer());
+#ifdef OCH_VIRTUAL_TEXTURE
+	virtual_texture_header vt_header;
 
-		check(create_vk_index_buffer());
+	// Only ever read, so read_vt_tile can run on the render thread and vt_stream_thread alike
+	std::unique_ptr<och::mapped_file<uint8_t>> vt_file;
 
-		check(create_vk_uniform_buffers());
+	VkImage vt_atlas_image = nullptr;
 
-		check(create_vk_descriptor_pool());
+	VkDeviceMemory vt_atlas_image_memory = nullptr;
 
-		check(create_vk_descriptor_sets());
+	VkImageView vt_atlas_image_view = nullptr;
 
-		check(create_vk_command_buffers());
+	VkSampler vt_atlas_sampler = nullptr;
 
-		check(create_vk_sync_objects());
+	uint32_t vt_page_table_width;
 
-		return {};
-	}
+	uint32_t vt_page_table_height;
 
-	err_info create_vk_instance()
-	{
-		VkApplicationInfo app_info{};
-		app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-		app_info.pApplicationName = "Hello Vulkan";
-		app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-		app_info.pEngineName = "No Engine";
-		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		app_info.apiVersion = VK_API_VERSION_1_0;
+	VkImage vt_page_table_image = nullptr;
 
-		std::vector<const char*> extensions;
+	VkDeviceMemory vt_page_table_image_memory = nullptr;
 
-		och::range<const char* const> layers;
+	VkImageView vt_page_table_image_view = nullptr;
 
-		check(get_required_instance_extensions(extensions));
+	VkSampler vt_page_table_sampler = nullptr;
 
-		check(get_required_instance_validation_layers(layers));
+	std::vector<VkBuffer> vt_feedback_buffers;
 
-		VkInstanceCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-		create_info.pApplicationInfo = &app_info;
-		create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-		create_info.ppEnabledExtensionNames = extensions.data();
-		create_info.enabledLayerCount = static_cast<uint32_t>(layers.len());
-		create_info.ppEnabledLayerNames = layers.beg;
+	std::vector<VkDeviceMemory> vt_feedback_buffers_memory;
 
-#ifdef OCH_VALIDATE
+	uint32_t vt_feedback_width;
 
-		VkDebugUtilsMessengerCreateInfoEXT messenger_info = populate_messenger_create_info();
-		create_info.pNext = &messenger_info;
+	uint32_t vt_feedback_height;
 
-#endif // OCH_VALIDATE
+	VkBuffer vt_staging_bufs[max_frames_in_flight]{};
 
-		check(vkCreateInstance(&create_info, nullptr, &vk_instance));
+	VkDeviceMemory vt_staging_bufs_memory[max_frames_in_flight]{};
 
-		return {};
-	}
+	VkCommandBuffer vt_upload_command_buffers[max_frames_in_flight]{};
 
-	err_info get_required_instance_extensions(std::vector<const char*>& required_extensions)
-	{
-		uint32_t glfw_cnt;
+	bool vt_has_uploads = false;
 
-		const char** glfw_names = glfwGetRequiredInstanceExtensions(&glfw_cnt);
+	// CPU mirror of the page table, all levels back to back
+	std::vector<uint32_t> vt_page_table;
 
-		required_extensions = std::vector(glfw_names, glfw_names + glfw_cnt);
+	std::vector<uint32_t> vt_page_table_offsets;
 
-#ifdef OCH_VALIDATE
-		required_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-#endif // OCH_VALIDATE
+	std::unordered_map<uint32_t, uint32_t> vt_resident_pages;
 
-		uint32_t vk_cnt;
+	std::vector<uint32_t> vt_tile_pages;
 
-		check(vkEnumerateInstanceExtensionProperties(nullptr, &vk_cnt, nullptr));
+	std::vector<uint64_t> vt_tile_last_use;
 
-		std::vector<VkExtensionProperties> available_exts(vk_cnt);
+	uint64_t vt_frame_idx = 1;
 
-		check(vkEnumerateInstanceExtensionProperties(nullptr, &vk_cnt, available_exts.data()));
+	struct vt_loaded_tile
+	{
+		uint32_t key;
 
-		for (const auto& req : required_extensions)
-		{
-			bool is_available = false;
+		std::vector<uint8_t> texels;
+	};
 
-			for (const auto& avl : available_exts)
-				if (!strcmp(req, avl.extensionName))
-				{
-					is_available = true;
-					break;
-				}
+	// Reads the pages stream_vt_pages requests, see vt_stream_worker
+	std::thread vt_stream_thread;
 
-			if (!is_available)
-				return ERROR(1);
-		}
+	// Guards everything below
+	std::mutex vt_stream_mutex;
 
-		return {};
-	}
+	std::condition_variable vt_stream_cv;
 
-	err_info get_required_instance_validation_layers(och::range<const char* const>& required_layers)
-	{
-#ifdef OCH_VALIDATE
-		uint32_t layer_cnt;
+	bool vt_stream_stop = false;
 
-		check(vkEnumerateInstanceLayerProperties(&layer_cnt, nullptr));
+	bool vt_stream_failed = false;
 
-		std::vector<VkLayerProperties> available_layers(layer_cnt);
+	// Sorted by key, so the coarsest page is read first from the back
+	std::vector<uint32_t> vt_stream_requests;
 
-		check(vkEnumerateInstanceLayerProperties(&layer_cnt, available_layers.data()));
+	uint32_t vt_stream_reading_key = ~0u;
 
-		for (const auto& req : required_validation_layers)
-		{
-			bool is_available = false;
+	// Read but not yet uploaded, oldest first
+	std::vector<vt_loaded_tile> vt_stream_loaded;
+#endif // OCH_VIRTUAL_TEXTURE
 
-			for (const auto& avl : available_layers)
-				if (!strcmp(req, avl.layerName))
-				{
-					is_available = true;
-					break;
-				}
+	VkSampler vk_texture_sampler = nullptr;
 
-			if (!is_available)
-				return ERROR(1);
-		}
+	VkImage vk_depth_image = nullptr;
 
-		required_layers = och::range<const char* const>(required_validation_layers);
+	VkImageView vk_depth_image_view = nullptr;
 
-#endif // OCH_VALIDATE
+	VkSampleCountFlagBits vk_msaa_samples = VK_SAMPLE_COUNT_1_BIT;
 
-		return {};
-	}
+	// Depth never leaves the render pass, so its image can be transient
+	static constexpr VkAttachmentStoreOp depth_store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-	err_info create_vk_debug_messenger()
-	{
-#ifdef OCH_VALIDATE
+	// Transient attachments are backed by lazily allocated memory if the device has some, e.g. tile memory on mobile GPUs
+	bool has_lazily_allocated_memory = false;
 
-		VkDebugUtilsMessengerCreateInfoEXT create_info = populate_messenger_create_info();
+	VkImage vk_colour_image = nullptr;
 
-		auto create_fn = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(vk_instance, "vkCreateDebugUtilsMessengerEXT"));
+	VkImageView vk_colour_image_view = nullptr;
 
-		if (create_fn)
+	// With dynamic resolution the scene is rendered into the top left vk_render_extent of this swapchain-sized image and then blitted to the swapchain
+	VkImage vk_scene_image = nullptr;
+
+	VkImageView vk_scene_image_view = nullptr;
+
+	// Render targets are transient images of the frame graph. Those in the same alias class and with disjoint lifetimes share a block.
+	// Only transient attachments may go into lazily allocated memory, hence their own class.
+	static constexpr uint32_t alias_class_lazy = 0;
+
+	static constexpr uint32_t alias_class_device = 1;
+
+	std::vector<och::rg_memory_block> render_target_blocks;
+
+	// Frame graph resource index to block index, as planned when the render targets were created
+	std::vector<uint32_t> render_target_block_idxs;
+
+	std::vector<VkDeviceMemory> vk_render_target_memory;
+
+	VkFilter vk_upscale_filter = VK_FILTER_LINEAR;
+
+	VkExtent2D vk_render_extent;
+
+	// Render extent each command buffer was recorded with, so they can be re-recorded once their image is reused
+	std::vector<VkExtent2D> vk_recorded_render_extents;
+
+	size_t curr_frame = 0;
+
+	bool framebuffer_resized = false;
+
+#ifdef OCH_VALIDATE
+	VkDebugUtilsMessengerEXT vk_debug_messenger = nullptr;
+#endif // OCH_VALIDATE
+
+	err_info run()
+	{
+		startup_report.beg_ns = och::trace_now_ns();
+
+		if (!headless)
 		{
-			check(create_fn(vk_instance, &create_info, nullptr, &vk_debug_messenger));
+			const och::startup_stage_timer timer;
+
+			init_window();
+
+			startup_report.add("init_window", timer);
 		}
-		else
-			return ERROR(1);
 
-#endif // OCH_VALIDATE
+		err_info err = init_vulkan();
 
-		return {};
-	}
+		if (!err)
+			err = main_loop();
 
-	err_info create_vk_surface()
-	{
-		check(glfwCreateWindowSurface(vk_instance, window, nullptr, &vk_surface));
+		// Failures can leave initialisation anywhere partway, which cleanup copes with
+		cleanup();
 
-		return {};
+		return err;
 	}
 
-	err_info select_vk_physical_device()
+	void init_window()
 	{
-		uint32_t device_cnt;
-
-		check(vkEnumeratePhysicalDevices(vk_instance, &device_cnt, nullptr));
+		glfwInit();
 
-		if (!device_cnt)
-			return ERROR(1);
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-		std::vector<VkPhysicalDevice> devices(device_cnt);
+		// glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-		check(vkEnumeratePhysicalDevices(vk_instance, &device_cnt, devices.data()));
+		window = glfwCreateWindow(window_width, window_height, "Hello Vulkan", nullptr, nullptr);
 
-		for (auto& dev : devices)
-		{
-			VkPhysicalDeviceProperties props;
+		glfwSetWindowUserPointer(window, this);
 
-			vkGetPhysicalDeviceProperties(dev, &props);
+		glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback_fn);
 
-			VkPhysicalDeviceFeatures feats;
+		glfwSetKeyCallback(window, key_callback_fn);
+	}
 
-			vkGetPhysicalDeviceFeatures(dev, &feats);
+	// Runs initialisation as a task graph. Scene textures are decoded, meshes parsed and the first pipelines built while the device is set up,
+	// and the uploads join on them. The Vulkan stages themselves stay in one chain on the calling thread, which GLFW requires, in the order they always ran in.
+	err_info init_vulkan()
+	{
+		OCH_ZONE(__FUNCTION__);
 
-			if (props.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-				continue;
+		// Cheap, and determines how many decode tasks there are
+		const och::startup_stage_timer load_timer;
 
-			if (!feats.geometryShader || !feats.samplerAnisotropy)
-				continue;
+		check(load_scene());
 
-			err_info err;
+		startup_report.add("load_scene", load_timer);
 
-			queue_family_indices queue_families;
+		och::task_graph graph;
 
-			check(query_queue_families(dev, vk_surface, queue_families));
+		uint32_t chain = och::task_graph::no_task;
 
-			if (!queue_families)
+		auto add_stage = [&](const char* name, err_info(hello_vulkan::* stage)(), std::vector<uint32_t> dependencies = {})
 			{
-				check(err);
+				if (chain != och::task_graph::no_task)
+					dependencies.push_back(chain);
 
-				continue;
-			}
-
-			bool supports_required_dev_extensions;
+				chain = graph.add(name, as_task([this, stage]() { return (this->*stage)(); }), std::move(dependencies), true);
+			};
 
-			check(check_required_device_extension_support(dev, supports_required_dev_extensions));
+		add_stage("create_vk_instance", &hello_vulkan::create_vk_instance);
 
-			if (!supports_required_dev_extensions)
-				continue;
-			
-			swapchain_support_details swapchain_details;
+		add_stage("create_vk_debug_messenger", &hello_vulkan::create_vk_debug_messenger);
 
-			check(query_swapchain_support(dev, vk_surface, swapchain_details));
+		if (!headless)
+			add_stage("create_vk_surface", &hello_vulkan::create_vk_surface);
 
-			if (swapchain_details.formats.empty() || swapchain_details.present_modes.empty())
-				continue;
+		add_stage("select_vk_physical_device", &hello_vulkan::select_vk_physical_device);
 
-			vk_physical_device = dev;
+		add_stage("create_vk_logical_device", &hello_vulkan::create_vk_logical_device);
 
-			vk_msaa_samples = query_max_msaa_samples();
+		const uint32_t logical_device_task = chain;
 
-			break;
-		}
+		if (headless)
+			add_stage("create_vk_offscreen_targets", &hello_vulkan::create_vk_offscreen_targets);
+		else
+			add_stage("create_vk_swapchain", &hello_vulkan::create_vk_swapchain);
 
-		if (!vk_physical_device)
-			return ERROR(1);
+		add_stage("get_vk_swapchain_views", &hello_vulkan::get_vk_swapchain_views);
 
-		return {};
-	}
+		add_stage("create_vk_render_pass", &hello_vulkan::create_vk_render_pass);
 
-	err_info check_required_device_extension_support(VkPhysicalDevice physical_dev, bool& all_supported)
-	{
-		uint32_t extension_cnt;
+		add_stage("create_vk_descriptor_set_layout", &hello_vulkan::create_vk_descriptor_set_layout);
 
-		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, nullptr));
+#ifdef OCH_VIRTUAL_TEXTURE
+		add_stage("open_virtual_texture_file", &hello_vulkan::open_virtual_texture_file);
+#endif // OCH_VIRTUAL_TEXTURE
 
-		std::vector<VkExtensionProperties> available_dev_extensions(extension_cnt);
+		// Mostly waits for the pipeline workers, off the chain
+		const uint32_t pipeline_task = graph.add("create_vk_graphics_pipeline", as_task([this]() { return create_vk_graphics_pipeline(); }), { chain });
 
-		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, available_dev_extensions.data()));
+		std::vector<uint32_t> texture_tasks;
 
-		all_supported = true;
+#ifndef OCH_VIRTUAL_TEXTURE
+		decoded_textures.resize(scene_texture_paths.size());
 
-		for (const auto& req : required_device_extensions)
+		for (size_t i = 1; i < scene_texture_paths.size(); ++i)
 		{
-			bool is_available = false;
+			const uint32_t decode_task = graph.add("decode " + scene_texture_paths[i], as_task([this, i]() { return decode_scene_texture(i); }));
 
-			for (const auto& avl : available_dev_extensions)
-				if (!strcmp(req, avl.extensionName))
+			// Whether the GPU generates the mips is only known once there is a device
+			texture_tasks.push_back(graph.add("downsample " + scene_texture_paths[i], [this, i]()
 				{
-					is_available = true;
-					break;
-				}
+					if (!has_compute_mip_generation)
+						downsample_scene_texture(i);
 
-			if (!is_available)
-			{
-				all_supported = false;
-				return {};
-			}
+					return true;
+				}, { decode_task, logical_device_task }));
 		}
+#endif // OCH_VIRTUAL_TEXTURE
 
-		return {};
-	}
+		std::vector<uint32_t> mesh_tasks;
 
-	err_info create_vk_logical_device()
-	{
-		queue_family_indices family_indices;
+		decoded_meshes.resize(scene_meshes.size());
 
-		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+		for (size_t i = 0; i != scene_meshes.size(); ++i)
+			mesh_tasks.push_back(graph.add("load " + scene_meshes[i].model_path, as_task([this, i]() { return load_scene_mesh(i); })));
 
-		float graphics_queue_priority = 1.0F;
+		add_stage("create_vk_command_pool", &hello_vulkan::create_vk_command_pool);
 
-		VkDeviceQueueCreateInfo queue_infos[2]{};
-		queue_infos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queue_infos[0].queueFamilyIndex = family_indices.graphics_idx;
-		queue_infos[0].queueCount = 1;
-		queue_infos[0].pQueuePriorities = &graphics_queue_priority;
-		queue_infos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queue_infos[1].queueFamilyIndex = family_indices.present_idx;
-		queue_infos[1].queueCount = 1;
-		queue_infos[1].pQueuePriorities = &graphics_queue_priority;
+		add_stage("create_vk_mip_generator", &hello_vulkan::create_vk_mip_generator_if_supported);
 
-		VkPhysicalDeviceFeatures enabled_dev_features{};
-		enabled_dev_features.samplerAnisotropy = VK_TRUE;
+		add_stage("create_vk_render_targets", &hello_vulkan::create_vk_render_targets);
 
-		VkDeviceCreateInfo dev_info{};
-		dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		dev_info.pQueueCreateInfos = queue_infos;
-		dev_info.queueCreateInfoCount = 1 + family_indices.discrete_present_family();
-		dev_info.pEnabledFeatures = &enabled_dev_features;
-		dev_info.ppEnabledExtensionNames = required_device_extensions;
-		dev_info.enabledExtensionCount = sizeof(required_device_extensions) / sizeof(*required_device_extensions);
-#ifdef OCH_VALIDATE
-		dev_info.ppEnabledLayerNames = required_validation_layers;
-		dev_info.enabledLayerCount = sizeof(required_validation_layers) / sizeof(*required_validation_layers);
+		add_stage("create_vk_swapchain_framebuffers", &hello_vulkan::create_vk_swapchain_framebuffers);
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		add_stage("create_vk_virtual_texture", &hello_vulkan::create_vk_virtual_texture);
 #else
-		dev_info.ppEnabledLayerNames = nullptr;
-		dev_info.enabledLayerCount = 0;
-#endif // OCH_VALIDATE
+		add_stage("create_vk_texture_image", &hello_vulkan::create_vk_texture_image);
 
-		check(vkCreateDevice(vk_physical_device, &dev_info, nullptr, &vk_device));
+		add_stage("create_vk_texture_image_view", &hello_vulkan::create_vk_texture_image_view);
 
-		vkGetDeviceQueue(vk_device, family_indices.graphics_idx, 0, &vk_graphics_queue);
+		add_stage("create_vk_texture_sampler", &hello_vulkan::create_vk_texture_sampler);
 
-		vkGetDeviceQueue(vk_device, family_indices.present_idx, 0, &vk_present_queue);
+		add_stage("create_vk_scene_textures", &hello_vulkan::create_vk_scene_textures, texture_tasks);
+#endif // OCH_VIRTUAL_TEXTURE
 
-		return {};
-	}
+		add_stage("create_vk_scene_geometry", &hello_vulkan::create_vk_scene_geometry, mesh_tasks);
 
-	err_info create_vk_swapchain()
-	{
-		swapchain_support_details swapchain_details;
+#ifdef OCH_BINDLESS
+		add_stage("create_vk_indirect_buffer", &hello_vulkan::create_vk_indirect_buffer);
+#endif // OCH_BINDLESS
 
-		check(query_swapchain_support(vk_physical_device, vk_surface, swapchain_details));
+		add_stage("create_vk_uniform_buffers", &hello_vulkan::create_vk_uniform_buffers);
 
-		VkSurfaceFormatKHR chosen_format = swapchain_details.formats[0];
+		add_stage("create_vk_descriptor_pool", &hello_vulkan::create_vk_descriptor_pool);
 
-		for (const auto& format : swapchain_details.formats)
-			if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
-			{
-				chosen_format = format;
+		add_stage("create_vk_descriptor_sets", &hello_vulkan::create_vk_descriptor_sets);
 
-				break;
-			}
+		add_stage("create_vk_timestamp_query_pool", &hello_vulkan::create_vk_timestamp_query_pool);
 
-		VkPresentModeKHR chosen_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+		// Recording needs the pipelines
+		add_stage("create_vk_command_buffers", &hello_vulkan::create_vk_command_buffers, { pipeline_task });
 
-		for(const auto& present_mode : swapchain_details.present_modes)
-			if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		add_stage("create_vk_sync_objects", &hello_vulkan::create_vk_sync_objects);
+
+		// Workers for everything off the chain, which the calling thread runs
+		const uint32_t worker_cnt = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+		if (!graph.run(worker_cnt))
+			return ERROR(1);
+
+		startup_report.add(graph);
+
+		return {};
+	}
+
+	// Wraps an initialisation stage for the task graph. Errors are per thread, so the stack is printed on the one that failed.
+	template<typename Fn>
+	static och::task_graph::task_fn as_task(Fn stage)
+	{
+		return [stage]() mutable
 			{
-				chosen_present_mode = present_mode;
+				if (!stage())
+					return true;
 
-				break;
-			}
+				print_error_stack();
 
-		VkExtent2D chosen_extent = swapchain_details.capabilites.currentExtent;
+				return false;
+			};
+	}
 
-		if (swapchain_details.capabilites.currentExtent.width == ~0u)
-		{
-			uint32_t width, height;
+	err_info create_vk_mip_generator_if_supported()
+	{
+		if (has_compute_mip_generation)
+			check(create_vk_mip_generator());
 
-			glfwGetFramebufferSize(window, reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height));
+		return {};
+	}
 
-			if (width > swapchain_details.capabilites.maxImageExtent.width)
-				width = swapchain_details.capabilites.maxImageExtent.width;
-			else if (width < swapchain_details.capabilites.minImageExtent.width)
-				width = swapchain_details.capabilites.minImageExtent.width;
+	err_info load_scene()
+	{
+		OCH_ZONE(__FUNCTION__);
 
-			if (height > swapchain_details.capabilites.maxImageExtent.height)
-				height = swapchain_details.capabilites.maxImageExtent.height;
-			else if (height < swapchain_details.capabilites.minImageExtent.height)
-				height = swapchain_details.capabilites.minImageExtent.height;
+		if (!scene_path)
+		{
+			scene_texture_paths.assign(1, "textures/" OCH_ASSET_NAME ".bmp");
 
-			chosen_extent.width = static_cast<uint32_t>(width);
-			chosen_extent.height = static_cast<uint32_t>(height);
+			scene_meshes.assign(1, scene_mesh{ "models/" OCH_ASSET_NAME ".obj", OCH_ASSET_OFFSET, OCH_ASSET_SCALE, 0 });
+
+			return {};
 		}
 
-		och::print("width: {}; height: {}\n\n", chosen_extent.width, chosen_extent.height);
+		och::mapped_file<char> scene_file(scene_path, och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
 
-		uint32_t chosen_image_count = swapchain_details.capabilites.minImageCount + 1;
+		if (!scene_file)
+			return ERROR(1);
 
-		if (swapchain_details.capabilites.maxImageCount && chosen_image_count > swapchain_details.capabilites.maxImageCount)
-			chosen_image_count = swapchain_details.capabilites.maxImageCount;
+		std::istringstream file(std::string(scene_file.get_data().beg, scene_file.bytes));
 
-		VkSwapchainCreateInfoKHR info{};
+		// Every non-empty line not starting with '#' reads
+		// mesh <obj path> <bmp path> <offset x> <offset y> <offset z> <scale>
+		std::string line;
 
-		info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		info.imageFormat = chosen_format.format;
-		info.imageColorSpace = chosen_format.colorSpace;
-		info.presentMode = chosen_present_mode;
-		info.imageExtent = chosen_extent;
-		info.minImageCount = chosen_image_count;
-		info.surface = vk_surface;
-		info.imageArrayLayers = 1;
-		info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-		info.preTransform = swapchain_details.capabilites.currentTransform;
-		info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		info.clipped = VK_TRUE;
-		info.oldSwapchain = nullptr;
+		while (std::getline(file, line))
+		{
+			std::istringstream tokens(line);
 
-		queue_family_indices family_indices;
+			std::string keyword;
 
-		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+			if (!(tokens >> keyword) || keyword[0] == '#')
+				continue;
 
-		if (family_indices.discrete_present_family())
-		{
-			uint32_t queue_indices[]{ family_indices.graphics_idx, family_indices.present_idx };
+			if (keyword != "mesh")
+				return ERROR(1);
 
-			info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-			info.pQueueFamilyIndices = queue_indices;
-			info.queueFamilyIndexCount = sizeof(queue_indices) / sizeof(*queue_indices);
-		}
-		else
-			info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		
-		vkCreateSwapchainKHR(vk_device, &info, nullptr, &vk_swapchain);
+			scene_mesh mesh{};
 
-		uint32_t swapchain_image_cnt;
+			std::string texture_path;
 
-		check(vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &swapchain_image_cnt, nullptr));
+			if (!(tokens >> mesh.model_path >> texture_path >> mesh.offset.x >> mesh.offset.y >> mesh.offset.z >> mesh.scale))
+				return ERROR(1);
 
-		vk_swapchain_images.resize(swapchain_image_cnt);
+			auto texture_it = std::find(scene_texture_paths.begin(), scene_texture_paths.end(), texture_path);
 
-		check(vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &swapchain_image_cnt, vk_swapchain_images.data()));
+			mesh.texture_idx = static_cast<uint32_t>(texture_it - scene_texture_paths.begin());
 
-		vk_swapchain_format = chosen_format.format;
+			if (texture_it == scene_texture_paths.end())
+				scene_texture_paths.push_back(texture_path);
 
-		vk_swapchain_extent = chosen_extent;
+			scene_meshes.push_back(mesh);
+		}
 
-		return {};
-	}
+		if (scene_meshes.empty())
+			return ERROR(1);
 
-	err_info get_vk_swapchain_views()
-	{
-		vk_swapchain_views.resize(vk_swapchain_images.size());
+		std::stable_sort(scene_meshes.begin(), scene_meshes.end(), [](const scene_mesh& l, const scene_mesh& r) { return l.texture_idx < r.texture_idx; });
 
-		for (uint32_t i = 0; i != static_cast<uint32_t>(vk_swapchain_images.size()); ++i)
-			check(allocate_image_view(vk_swapchain_images[i], vk_swapchain_format, VK_IMAGE_ASPECT_COLOR_BIT, vk_swapchain_views[i]));
+		och::print("Scene {}: {} meshes, {} textures\n\n", scene_path, scene_meshes.size(), scene_texture_paths.size());
 
 		return {};
 	}
 
-	err_info create_vk_render_pass()
+	err_info create_vk_instance()
 	{
-		VkAttachmentDescription color_attachment{};
-		color_attachment.format = vk_swapchain_format;
-		color_attachment.samples = vk_msaa_samples;
-		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		OCH_ZONE(__FUNCTION__);
 
-		VkAttachmentDescription depth_attachment{};
-		depth_attachment.format = VK_FORMAT_D32_SFLOAT;
-		depth_attachment.samples = vk_msaa_samples;
-		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		VkApplicationInfo app_info{};
+		app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		app_info.pApplicationName = "Hello Vulkan";
+		app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+		app_info.pEngineName = "No Engine";
+		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+		app_info.apiVersion = VK_API_VERSION_1_2;
+
+		std::vector<const char*> extensions;
+
+		och::range<const char* const> layers;
+
+		check(get_required_instance_extensions(extensions));
+
+		check(get_required_instance_validation_layers(layers));
+
+		VkInstanceCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		create_info.pApplicationInfo = &app_info;
+		create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		create_info.ppEnabledExtensionNames = extensions.data();
+		create_info.enabledLayerCount = static_cast<uint32_t>(layers.len());
+		create_info.ppEnabledLayerNames = layers.beg;
+
+#ifdef OCH_VALIDATE
+
+		VkDebugUtilsMessengerCreateInfoEXT messenger_info = populate_messenger_create_info();
+		create_info.pNext = &messenger_info;
+
+#endif // OCH_VALIDATE
+
+		check(vkCreateInstance(&create_info, nullptr, &vk_instance));
+
+		return {};
+	}
+
+	err_info get_required_instance_extensions(std::vector<const char*>& required_extensions)
+	{
+		if (!headless)
+		{
+			uint32_t glfw_cnt;
+
+			const char** glfw_names = glfwGetRequiredInstanceExtensions(&glfw_cnt);
+
+			required_extensions = std::vector(glfw_names, glfw_names + glfw_cnt);
+		}
+
+#ifdef OCH_VALIDATE
+		required_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+#endif // OCH_VALIDATE
+
+		uint32_t vk_cnt;
+
+		check(vkEnumerateInstanceExtensionProperties(nullptr, &vk_cnt, nullptr));
+
+		std::vector<VkExtensionProperties> available_exts(vk_cnt);
+
+		check(vkEnumerateInstanceExtensionProperties(nullptr, &vk_cnt, available_exts.data()));
+
+		for (const auto& req : required_extensions)
+		{
+			bool is_available = false;
+
+			for (const auto& avl : available_exts)
+				if (!strcmp(req, avl.extensionName))
+				{
+					is_available = true;
+					break;
+				}
+
+			if (!is_available)
+				return ERROR(1);
+		}
+
+		return {};
+	}
+
+	err_info get_required_instance_validation_layers(och::range<const char* const>& required_layers)
+	{
+#ifdef OCH_VALIDATE
+		uint32_t layer_cnt;
+
+		check(vkEnumerateInstanceLayerProperties(&layer_cnt, nullptr));
+
+		std::vector<VkLayerProperties> available_layers(layer_cnt);
+
+		check(vkEnumerateInstanceLayerProperties(&layer_cnt, available_layers.data()));
+
+		for (const auto& req : required_validation_layers)
+		{
+			bool is_available = false;
+
+			for (const auto& avl : available_layers)
+				if (!strcmp(req, avl.layerName))
+				{
+					is_available = true;
+					break;
+				}
+
+			if (!is_available)
+				return ERROR(1);
+		}
+
+		required_layers = och::range<const char* const>(required_validation_layers);
+
+#endif // OCH_VALIDATE
+
+		return {};
+	}
+
+	err_info create_vk_debug_messenger()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+#ifdef OCH_VALIDATE
+
+		VkDebugUtilsMessengerCreateInfoEXT create_info = populate_messenger_create_info();
+
+		auto create_fn = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(vk_instance, "vkCreateDebugUtilsMessengerEXT"));
+
+		if (create_fn)
+		{
+			check(create_fn(vk_instance, &create_info, nullptr, &vk_debug_messenger));
+		}
+		else
+			return ERROR(1);
+
+#endif // OCH_VALIDATE
+
+		return {};
+	}
+
+	err_info create_vk_surface()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		check(glfwCreateWindowSurface(vk_instance, window, nullptr, &vk_surface));
+
+		return {};
+	}
+
+	err_info select_vk_physical_device()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		uint32_t device_cnt;
+
+		check(vkEnumeratePhysicalDevices(vk_instance, &device_cnt, nullptr));
+
+		if (!device_cnt)
+			return ERROR(1);
+
+		std::vector<VkPhysicalDevice> devices(device_cnt);
+
+		check(vkEnumeratePhysicalDevices(vk_instance, &device_cnt, devices.data()));
+
+		uint64_t best_score = 0;
+
+		for (auto& dev : devices)
+		{
+			VkPhysicalDeviceIDProperties id_props{};
+			id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 props_2{};
+			props_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			props_2.pNext = &id_props;
+
+			vkGetPhysicalDeviceProperties2(dev, &props_2);
+
+			const VkPhysicalDeviceProperties& props = props_2.properties;
+
+			char uuid[2 * VK_UUID_SIZE + 1];
+
+			format_uuid(id_props.deviceUUID, uuid);
+
+			bool is_suitable;
+
+			check(is_physical_device_suitable(dev, is_suitable));
+
+			uint64_t score = 0;
+
+			if (is_suitable)
+				check(score_physical_device(dev, score));
+
+			const bool is_override = physical_device_override && (strstr(props.deviceName, physical_device_override) || uuid_equals(uuid, physical_device_override));
+
+			och::print("{} {} [{}]: score {}\n", is_override ? "*" : " ", static_cast<const char*>(props.deviceName), static_cast<const char*>(uuid), score);
+
+			if (!is_suitable || (physical_device_override && !is_override))
+				continue;
+
+			if (score > best_score)
+			{
+				best_score = score;
+
+				vk_physical_device = dev;
+			}
+		}
+
+		if (!vk_physical_device)
+			return ERROR(1);
+
+		VkPhysicalDeviceProperties chosen_props;
+
+		vkGetPhysicalDeviceProperties(vk_physical_device, &chosen_props);
+
+		och::print("\nUsing {}\n\n", static_cast<const char*>(chosen_props.deviceName));
+
+		vk_msaa_samples = query_max_msaa_samples();
+
+		uint32_t unused_type_idx;
+
+		has_lazily_allocated_memory = !query_memory_type_index(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, unused_type_idx);
+
+		return {};
+	}
+
+	err_info is_physical_device_suitable(VkPhysicalDevice dev, bool& out_is_suitable)
+	{
+		out_is_suitable = false;
+
+		VkPhysicalDeviceProperties props;
+
+		vkGetPhysicalDeviceProperties(dev, &props);
+
+		VkPhysicalDeviceFeatures feats;
+
+		vkGetPhysicalDeviceFeatures(dev, &feats);
+
+		if (!feats.samplerAnisotropy)
+			return {};
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		if (!feats.fragmentStoresAndAtomics)
+			return {};
+#endif // OCH_VIRTUAL_TEXTURE
+
+		if (props.apiVersion < VK_API_VERSION_1_2)
+			return {};
+
+		VkPhysicalDeviceVulkan12Features feats_12{};
+		feats_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 feats_2{};
+		feats_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		feats_2.pNext = &feats_12;
+
+		vkGetPhysicalDeviceFeatures2(dev, &feats_2);
+
+		// Frame synchronization is built on a timeline semaphore
+		if (!feats_12.timelineSemaphore)
+			return {};
+
+#ifdef OCH_BINDLESS
+		// Draw commands pass their texture slot in firstInstance
+		if (!feats.multiDrawIndirect || !feats.drawIndirectFirstInstance)
+			return {};
+
+		if (!feats_12.runtimeDescriptorArray || !feats_12.descriptorBindingPartiallyBound || !feats_12.descriptorBindingSampledImageUpdateAfterBind || !feats_12.shaderSampledImageArrayNonUniformIndexing)
+			return {};
+#endif // OCH_BINDLESS
+
+		queue_family_indices queue_families;
+
+		check(query_queue_families(dev, vk_surface, queue_families));
+
+		if (!queue_families)
+			return {};
+
+		if (!headless)
+		{
+			bool supports_required_dev_extensions;
+
+			check(check_required_device_extension_support(dev, supports_required_dev_extensions));
+
+			if (!supports_required_dev_extensions)
+				return {};
+
+			swapchain_support_details swapchain_details;
+
+			check(query_swapchain_support(dev, vk_surface, swapchain_details));
+
+			if (swapchain_details.formats.empty() || swapchain_details.present_modes.empty())
+				return {};
+		}
+
+		out_is_suitable = true;
+
+		return {};
+	}
+
+	// Device type dominates, followed by device-local memory, then limits and queue topology as tie breakers.
+	err_info score_physical_device(VkPhysicalDevice dev, uint64_t& out_score)
+	{
+		VkPhysicalDeviceProperties props;
+
+		vkGetPhysicalDeviceProperties(dev, &props);
+
+		switch (props.deviceType)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			out_score = 4'000'000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			out_score = 3'000'000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			out_score = 2'000'000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			out_score = 1'000'000; break;
+		default:
+			out_score = 1; break;
+		}
+
+		VkPhysicalDeviceMemoryProperties mem_props;
+
+		vkGetPhysicalDeviceMemoryProperties(dev, &mem_props);
+
+		VkDeviceSize device_local_bytes = 0;
+
+		for (uint32_t i = 0; i != mem_props.memoryHeapCount; ++i)
+			if (mem_props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				device_local_bytes += mem_props.memoryHeaps[i].size;
+
+		// In 64 MiB steps, which keeps any realistic heap below the next device type
+		out_score += (device_local_bytes >> 26) < 500'000 ? device_local_bytes >> 26 : 500'000;
+
+		out_score += props.limits.maxImageDimension2D >> 10;
+
+		out_score += props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+
+		queue_family_indices queue_families;
+
+		check(query_queue_families(dev, vk_surface, queue_families));
+
+		if (!queue_families.discrete_present_family())
+			out_score += 64;
+
+		if (queue_families.transfer_idx != queue_families.graphics_idx)
+			out_score += 32;
+
+		if (queue_families.compute_idx != queue_families.graphics_idx)
+			out_score += 32;
+
+		return {};
+	}
+
+	static void format_uuid(const uint8_t(&uuid)[VK_UUID_SIZE], char(&out_str)[2 * VK_UUID_SIZE + 1])
+	{
+		static constexpr char hex_digits[]{ "0123456789abcdef" };
+
+		for (uint32_t i = 0; i != VK_UUID_SIZE; ++i)
+		{
+			out_str[2 * i] = hex_digits[uuid[i] >> 4];
+			out_str[2 * i + 1] = hex_digits[uuid[i] & 15];
+		}
+
+		out_str[2 * VK_UUID_SIZE] = '\0';
+	}
+
+	// Compares ignoring case and dashes, so both raw hex and the usual 8-4-4-4-12 form are accepted
+	static bool uuid_equals(const char* formatted_uuid, const char* str)
+	{
+		for (; *str; ++str)
+		{
+			if (*str == '-')
+				continue;
+
+			if (!*formatted_uuid || *formatted_uuid != (*str >= 'A' && *str <= 'F' ? *str - 'A' + 'a' : *str))
+				return false;
+
+			++formatted_uuid;
+		}
+
+		return !*formatted_uuid;
+	}
+
+	err_info check_required_device_extension_support(VkPhysicalDevice physical_dev, bool& all_supported)
+	{
+		uint32_t extension_cnt;
+
+		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, nullptr));
+
+		std::vector<VkExtensionProperties> available_dev_extensions(extension_cnt);
+
+		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, available_dev_extensions.data()));
+
+		all_supported = true;
+
+		for (const auto& req : required_device_extensions)
+		{
+			bool is_available = false;
+
+			for (const auto& avl : available_dev_extensions)
+				if (!strcmp(req, avl.extensionName))
+				{
+					is_available = true;
+					break;
+				}
+
+			if (!is_available)
+			{
+				all_supported = false;
+				return {};
+			}
+		}
+
+		return {};
+	}
+
+	err_info create_vk_logical_device()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		queue_family_indices family_indices;
+
+		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+
+		float graphics_queue_priority = 1.0F;
+
+		// One queue from each distinct family
+		const uint32_t queue_family_idxs[]{ family_indices.graphics_idx, family_indices.present_idx, family_indices.compute_idx };
+
+		VkDeviceQueueCreateInfo queue_infos[3]{};
+
+		uint32_t queue_info_cnt = 0;
+
+		for (uint32_t family_idx : queue_family_idxs)
+		{
+			if (std::any_of(queue_infos, queue_infos + queue_info_cnt, [family_idx](const VkDeviceQueueCreateInfo& info) { return info.queueFamilyIndex == family_idx; }))
+				continue;
+
+			queue_infos[queue_info_cnt].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queue_infos[queue_info_cnt].queueFamilyIndex = family_idx;
+			queue_infos[queue_info_cnt].queueCount = 1;
+			queue_infos[queue_info_cnt].pQueuePriorities = &graphics_queue_priority;
+
+			++queue_info_cnt;
+		}
+
+		VkPhysicalDeviceFeatures supported_dev_features;
+
+		vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_dev_features);
+
+		has_sample_rate_shading = supported_dev_features.sampleRateShading;
+
+		has_fill_mode_non_solid = supported_dev_features.fillModeNonSolid;
+
+		// downsample.comp indexes its array of level views
+		has_compute_mip_generation = supported_dev_features.shaderStorageImageArrayDynamicIndexing;
+
+		VkPhysicalDeviceFeatures enabled_dev_features{};
+		enabled_dev_features.samplerAnisotropy = VK_TRUE;
+		enabled_dev_features.sampleRateShading = supported_dev_features.sampleRateShading;
+		enabled_dev_features.fillModeNonSolid = supported_dev_features.fillModeNonSolid;
+		enabled_dev_features.shaderStorageImageArrayDynamicIndexing = supported_dev_features.shaderStorageImageArrayDynamicIndexing;
+#ifdef OCH_VIRTUAL_TEXTURE
+		enabled_dev_features.fragmentStoresAndAtomics = VK_TRUE;
+#endif // OCH_VIRTUAL_TEXTURE
+#ifdef OCH_BINDLESS
+		enabled_dev_features.multiDrawIndirect = VK_TRUE;
+		enabled_dev_features.drawIndirectFirstInstance = VK_TRUE;
+#endif // OCH_BINDLESS
+
+		std::vector<const char*> enabled_extensions;
+
+		if (!headless)
+			enabled_extensions.assign(required_device_extensions, required_device_extensions + sizeof(required_device_extensions) / sizeof(*required_device_extensions));
+
+		check(query_calibrated_timestamp_support(vk_physical_device, has_calibrated_timestamps));
+
+		if (has_calibrated_timestamps)
+			enabled_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+
+		VkDeviceCreateInfo dev_info{};
+		dev_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+		VkPhysicalDeviceVulkan12Features enabled_dev_features_12{};
+		enabled_dev_features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		enabled_dev_features_12.timelineSemaphore = VK_TRUE;
+#ifdef OCH_BINDLESS
+		enabled_dev_features_12.runtimeDescriptorArray = VK_TRUE;
+		enabled_dev_features_12.descriptorBindingPartiallyBound = VK_TRUE;
+		enabled_dev_features_12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		enabled_dev_features_12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+#endif // OCH_BINDLESS
+
+		dev_info.pNext = &enabled_dev_features_12;
+
+#ifdef OCH_PRESENT_WAIT
+		VkPhysicalDevicePresentIdFeaturesKHR enabled_present_id_features{};
+		enabled_present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		enabled_present_id_features.presentId = VK_TRUE;
+
+		VkPhysicalDevicePresentWaitFeaturesKHR enabled_present_wait_features{};
+		enabled_present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		enabled_present_wait_features.presentWait = VK_TRUE;
+		enabled_present_wait_features.pNext = &enabled_present_id_features;
+
+		if (!headless)
+			check(query_present_wait_support(vk_physical_device, has_present_wait));
+
+		if (has_present_wait)
+		{
+			enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+
+			enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+			enabled_present_id_features.pNext = const_cast<void*>(dev_info.pNext);
+
+			dev_info.pNext = &enabled_present_wait_features;
+		}
+#endif // OCH_PRESENT_WAIT
+
+#ifdef OCH_SYNCHRONIZATION2
+		VkPhysicalDeviceSynchronization2FeaturesKHR enabled_synchronization2_features{};
+		enabled_synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		enabled_synchronization2_features.synchronization2 = VK_TRUE;
+
+		check(query_synchronization2_support(vk_physical_device, has_synchronization2));
+
+		if (has_synchronization2)
+		{
+			enabled_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+			enabled_synchronization2_features.pNext = const_cast<void*>(dev_info.pNext);
+
+			dev_info.pNext = &enabled_synchronization2_features;
+		}
+#endif // OCH_SYNCHRONIZATION2
+
+		dev_info.pQueueCreateInfos = queue_infos;
+		dev_info.queueCreateInfoCount = queue_info_cnt;
+		dev_info.pEnabledFeatures = &enabled_dev_features;
+		dev_info.ppEnabledExtensionNames = enabled_extensions.data();
+		dev_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+#ifdef OCH_VALIDATE
+		dev_info.ppEnabledLayerNames = required_validation_layers;
+		dev_info.enabledLayerCount = sizeof(required_validation_layers) / sizeof(*required_validation_layers);
+#else
+		dev_info.ppEnabledLayerNames = nullptr;
+		dev_info.enabledLayerCount = 0;
+#endif // OCH_VALIDATE
+
+		check(vkCreateDevice(vk_physical_device, &dev_info, nullptr, &vk_device));
+
+		vkGetDeviceQueue(vk_device, family_indices.graphics_idx, 0, &vk_graphics_queue);
+
+		vkGetDeviceQueue(vk_device, family_indices.present_idx, 0, &vk_present_queue);
+
+		vkGetDeviceQueue(vk_device, family_indices.compute_idx, 0, &vk_compute_queue);
+
+		if (has_calibrated_timestamps)
+			vk_get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(vk_device, "vkGetCalibratedTimestampsEXT"));
+
+		has_calibrated_timestamps = vk_get_calibrated_timestamps != nullptr;
+
+#ifdef OCH_PRESENT_WAIT
+		if (has_present_wait)
+			vk_wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(vk_device, "vkWaitForPresentKHR"));
+
+		has_present_wait = vk_wait_for_present != nullptr;
+#endif // OCH_PRESENT_WAIT
+
+#ifdef OCH_SYNCHRONIZATION2
+		if (has_synchronization2)
+			resource_states.cmd_pipeline_barrier_2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(vk_device, "vkCmdPipelineBarrier2KHR"));
+
+		has_synchronization2 = resource_states.cmd_pipeline_barrier_2 != nullptr;
+#endif // OCH_SYNCHRONIZATION2
+
+		return {};
+	}
+
+	err_info query_device_extension(VkPhysicalDevice physical_dev, const char* extension_name, bool& out_is_supported)
+	{
+		out_is_supported = false;
+
+		uint32_t extension_cnt;
+
+		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, nullptr));
+
+		std::vector<VkExtensionProperties> available_dev_extensions(extension_cnt);
+
+		check(vkEnumerateDeviceExtensionProperties(physical_dev, nullptr, &extension_cnt, available_dev_extensions.data()));
+
+		for (const auto& avl : available_dev_extensions)
+			if (!strcmp(extension_name, avl.extensionName))
+				out_is_supported = true;
+
+		return {};
+	}
+
+#ifdef OCH_PRESENT_WAIT
+	err_info query_present_wait_support(VkPhysicalDevice physical_dev, bool& out_is_supported)
+	{
+		out_is_supported = false;
+
+		bool has_present_id_extension, has_present_wait_extension;
+
+		check(query_device_extension(physical_dev, VK_KHR_PRESENT_ID_EXTENSION_NAME, has_present_id_extension));
+
+		check(query_device_extension(physical_dev, VK_KHR_PRESENT_WAIT_EXTENSION_NAME, has_present_wait_extension));
+
+		if (!has_present_id_extension || !has_present_wait_extension)
+			return {};
+
+		VkPhysicalDevicePresentIdFeaturesKHR present_id_feats{};
+		present_id_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+		VkPhysicalDevicePresentWaitFeaturesKHR present_wait_feats{};
+		present_wait_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		present_wait_feats.pNext = &present_id_feats;
+
+		VkPhysicalDeviceFeatures2 feats_2{};
+		feats_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		feats_2.pNext = &present_wait_feats;
+
+		vkGetPhysicalDeviceFeatures2(physical_dev, &feats_2);
+
+		out_is_supported = present_id_feats.presentId && present_wait_feats.presentWait;
+
+		return {};
+	}
+#endif // OCH_PRESENT_WAIT
+
+#ifdef OCH_SYNCHRONIZATION2
+	err_info query_synchronization2_support(VkPhysicalDevice physical_dev, bool& out_is_supported)
+	{
+		out_is_supported = false;
+
+		bool has_extension;
+
+		check(query_device_extension(physical_dev, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, has_extension));
+
+		if (!has_extension)
+			return {};
+
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_feats{};
+		synchronization2_feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2 feats_2{};
+		feats_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		feats_2.pNext = &synchronization2_feats;
+
+		vkGetPhysicalDeviceFeatures2(physical_dev, &feats_2);
+
+		out_is_supported = synchronization2_feats.synchronization2;
+
+		return {};
+	}
+#endif // OCH_SYNCHRONIZATION2
+
+	err_info query_calibrated_timestamp_support(VkPhysicalDevice physical_dev, bool& out_is_supported)
+	{
+		out_is_supported = false;
+
+		bool has_extension;
+
+		check(query_device_extension(physical_dev, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, has_extension));
+
+		if (!has_extension)
+			return {};
+
+		auto get_time_domains_fn = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(vk_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+
+		if (!get_time_domains_fn)
+			return {};
+
+		uint32_t domain_cnt;
+
+		check(get_time_domains_fn(physical_dev, &domain_cnt, nullptr));
+
+		std::vector<VkTimeDomainEXT> domains(domain_cnt);
+
+		check(get_time_domains_fn(physical_dev, &domain_cnt, domains.data()));
+
+		bool has_device_domain = false, has_host_domain = false;
+
+		for (VkTimeDomainEXT domain : domains)
+		{
+			has_device_domain |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+
+			has_host_domain |= domain == host_time_domain;
+		}
+
+		out_is_supported = has_device_domain && has_host_domain;
+
+		return {};
+	}
+
+	err_info create_vk_swapchain()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		swapchain_support_details swapchain_details;
+
+		check(query_swapchain_support(vk_physical_device, vk_surface, swapchain_details));
+
+		VkSurfaceFormatKHR chosen_format = swapchain_details.formats[0];
+
+		for (const auto& format : swapchain_details.formats)
+			if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+			{
+				chosen_format = format;
+
+				break;
+			}
+
+		VkPresentModeKHR chosen_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+		for(const auto& present_mode : swapchain_details.present_modes)
+			if (present_mode == preferred_present_mode)
+			{
+				chosen_present_mode = present_mode;
+
+				break;
+			}
+
+		VkExtent2D chosen_extent = swapchain_details.capabilites.currentExtent;
+
+		if (swapchain_details.capabilites.currentExtent.width == ~0u)
+		{
+			uint32_t width, height;
+
+			glfwGetFramebufferSize(window, reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height));
+
+			if (width > swapchain_details.capabilites.maxImageExtent.width)
+				width = swapchain_details.capabilites.maxImageExtent.width;
+			else if (width < swapchain_details.capabilites.minImageExtent.width)
+				width = swapchain_details.capabilites.minImageExtent.width;
+
+			if (height > swapchain_details.capabilites.maxImageExtent.height)
+				height = swapchain_details.capabilites.maxImageExtent.height;
+			else if (height < swapchain_details.capabilites.minImageExtent.height)
+				height = swapchain_details.capabilites.minImageExtent.height;
+
+			chosen_extent.width = static_cast<uint32_t>(width);
+			chosen_extent.height = static_cast<uint32_t>(height);
+		}
+
+		och::print("width: {}; height: {}\n\n", chosen_extent.width, chosen_extent.height);
+
+		uint32_t chosen_image_count = requested_swapchain_image_cnt ? requested_swapchain_image_cnt : swapchain_details.capabilites.minImageCount + 1;
+
+		if (chosen_image_count < swapchain_details.capabilites.minImageCount)
+			chosen_image_count = swapchain_details.capabilites.minImageCount;
+
+		if (swapchain_details.capabilites.maxImageCount && chosen_image_count > swapchain_details.capabilites.maxImageCount)
+			chosen_image_count = swapchain_details.capabilites.maxImageCount;
+
+		VkSwapchainCreateInfoKHR info{};
+
+		info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		info.imageFormat = chosen_format.format;
+		info.imageColorSpace = chosen_format.colorSpace;
+		info.presentMode = chosen_present_mode;
+		info.imageExtent = chosen_extent;
+		info.minImageCount = chosen_image_count;
+		info.surface = vk_surface;
+		info.imageArrayLayers = 1;
+		info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (has_dynamic_resolution() ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+		info.preTransform = swapchain_details.capabilites.currentTransform;
+		info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		info.clipped = VK_TRUE;
+		info.oldSwapchain = nullptr;
+
+		queue_family_indices family_indices;
+
+		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+
+		if (family_indices.discrete_present_family())
+		{
+			uint32_t queue_indices[]{ family_indices.graphics_idx, family_indices.present_idx };
+
+			info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+			info.pQueueFamilyIndices = queue_indices;
+			info.queueFamilyIndexCount = sizeof(queue_indices) / sizeof(*queue_indices);
+		}
+		else
+			info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		
+		vkCreateSwapchainKHR(vk_device, &info, nullptr, &vk_swapchain);
+
+		uint32_t swapchain_image_cnt;
+
+		check(vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &swapchain_image_cnt, nullptr));
+
+		vk_swapchain_images.resize(swapchain_image_cnt);
+
+		check(vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &swapchain_image_cnt, vk_swapchain_images.data()));
+
+		vk_swapchain_format = chosen_format.format;
+
+		vk_swapchain_extent = chosen_extent;
+
+		camera_dirty = true;
+
+		vk_render_extent = scaled_render_extent();
+
+		vk_present_mode = chosen_present_mode;
+
+		och::print("present mode: {}; images: {}; frames in flight: {}\n\n", present_mode_name(vk_present_mode), swapchain_image_cnt, frames_in_flight);
+
+		return {};
+	}
+
+	// Stands in for the swapchain in headless mode, with one image per frame in flight
+	err_info create_vk_offscreen_targets()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_swapchain_format = VK_FORMAT_B8G8R8A8_SRGB;
+
+		vk_swapchain_extent = { window_width, window_height };
+
+		camera_dirty = true;
+
+		vk_render_extent = scaled_render_extent();
+
+		vk_swapchain_images.resize(frames_in_flight);
+
+		vk_offscreen_images_memory.resize(frames_in_flight);
+
+		for (uint32_t i = 0; i != frames_in_flight; ++i)
+			check(allocate_image(window_width, window_height, vk_swapchain_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_swapchain_images[i], vk_offscreen_images_memory[i]));
+
+		och::print("headless width: {}; height: {}\n\n", vk_swapchain_extent.width, vk_swapchain_extent.height);
+
+		return {};
+	}
+
+	err_info get_vk_swapchain_views()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_swapchain_views.resize(vk_swapchain_images.size());
+
+		for (uint32_t i = 0; i != static_cast<uint32_t>(vk_swapchain_images.size()); ++i)
+			check(allocate_image_view(vk_swapchain_images[i], vk_swapchain_format, VK_IMAGE_ASPECT_COLOR_BIT, vk_swapchain_views[i]));
+
+		return {};
+	}
+
+	err_info create_vk_render_pass()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		check(build_vk_render_pass(vk_swapchain_format, vk_msaa_samples, depth_prepass, vk_render_pass));
+
+		return {};
+	}
+
+	// Pipeline variants are built against their own render pass created from the same arguments, which is compatible with vk_render_pass.
+	// Otherwise only reads state fixed after initialisation, so pipeline workers call it as well.
+	err_info build_vk_render_pass(VkFormat colour_format, VkSampleCountFlagBits samples, bool has_depth_prepass, VkRenderPass& out_render_pass)
+	{
+		VkAttachmentDescription color_attachment{};
+		color_attachment.format = colour_format;
+		color_attachment.samples = samples;
+		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		color_attachment.storeOp = samples != VK_SAMPLE_COUNT_1_BIT ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription depth_attachment{};
+		depth_attachment.format = VK_FORMAT_D32_SFLOAT;
+		depth_attachment.samples = samples;
+		depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depth_attachment.storeOp = depth_store_op;
+		depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-		VkAttachmentDescription color_attachment_resolve{};
-		color_attachment_resolve.format = vk_swapchain_format;
-		color_attachment_resolve.samples = VK_SAMPLE_COUNT_1_BIT;
-		color_attachment_resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		color_attachment_resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		color_attachment_resolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		VkAttachmentDescription color_attachment_resolve{};
+		color_attachment_resolve.format = colour_format;
+		color_attachment_resolve.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment_resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment_resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment_resolve.finalLayout = headless || has_dynamic_resolution() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentReference color_ref{};
+		color_ref.attachment = 0;
+		color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depth_ref{};
+		depth_ref.attachment = 1;
+		depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference color_resolve_ref{};
+		color_resolve_ref.attachment = 2;
+		color_resolve_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		// Without MSAA there is nothing to resolve, so the swapchain image is rendered to directly. Otherwise only the resolved colour is stored.
+		const bool has_resolve = samples != VK_SAMPLE_COUNT_1_BIT;
+
+		if (!has_resolve)
+			color_attachment.finalLayout = color_attachment_resolve.finalLayout;
+
+		// The optional depth pre-pass comes first and only writes depth
+		VkSubpassDescription subpasses[2]{};
+		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpasses[0].pDepthStencilAttachment = &depth_ref;
+
+		VkSubpassDescription& subpass = subpasses[has_depth_prepass];
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_ref;
+		subpass.pDepthStencilAttachment = &depth_ref;
+		subpass.pResolveAttachments = has_resolve ? &color_resolve_ref : nullptr;
+
+		VkSubpassDependency dependencies[3]{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		// Transfer covers the previous frame's upscale blit reading the scene image
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// The colour attachments are first used by the main subpass
+		dependencies[1] = dependencies[0];
+		dependencies[1].dstSubpass = 1;
+
+		// The main subpass tests against the pre-pass' depth
+		dependencies[2].srcSubpass = 0;
+		dependencies[2].dstSubpass = 1;
+		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[2].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[2].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkAttachmentDescription attachment_descs[]{ color_attachment, depth_attachment, color_attachment_resolve };
+
+		VkRenderPassCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		create_info.attachmentCount = has_resolve ? 3 : 2;
+		create_info.pAttachments = attachment_descs;
+		create_info.subpassCount = has_depth_prepass ? 2 : 1;
+		create_info.pSubpasses = subpasses;
+		create_info.dependencyCount = has_depth_prepass ? 3 : 1;
+		create_info.pDependencies = dependencies;
+
+		check(vkCreateRenderPass(vk_device, &create_info, nullptr, &out_render_pass));
+
+		return {};
+	}
+
+	err_info create_vk_descriptor_set_layout()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkDescriptorSetLayoutBinding ubo_layout_binding{};
+		ubo_layout_binding.binding = 0;
+		ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		ubo_layout_binding.descriptorCount = 1;
+		ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		ubo_layout_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding sampler_layout_binding{};
+		sampler_layout_binding.binding = 1;
+		sampler_layout_binding.descriptorCount = 1;
+		sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		sampler_layout_binding.pImmutableSamplers = nullptr;
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		VkDescriptorSetLayoutBinding page_table_layout_binding{};
+		page_table_layout_binding.binding = 2;
+		page_table_layout_binding.descriptorCount = 1;
+		page_table_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		page_table_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		page_table_layout_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding feedback_layout_binding{};
+		feedback_layout_binding.binding = 3;
+		feedback_layout_binding.descriptorCount = 1;
+		feedback_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		feedback_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		feedback_layout_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding bindings[]{ ubo_layout_binding, sampler_layout_binding, page_table_layout_binding, feedback_layout_binding };
+#elif defined(OCH_BINDLESS)
+		VkPhysicalDeviceVulkan12Properties props_12{};
+		props_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 props_2{};
+		props_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		props_2.pNext = &props_12;
+
+		vkGetPhysicalDeviceProperties2(vk_physical_device, &props_2);
+
+		bindless_texture_capacity = bindless_max_textures;
+
+		if (bindless_texture_capacity > props_12.maxDescriptorSetUpdateAfterBindSampledImages)
+			bindless_texture_capacity = props_12.maxDescriptorSetUpdateAfterBindSampledImages;
+
+		if (bindless_texture_capacity > props_12.maxPerStageDescriptorUpdateAfterBindSampledImages)
+			bindless_texture_capacity = props_12.maxPerStageDescriptorUpdateAfterBindSampledImages;
+
+		// Binding 1 only holds the sampler; the textures themselves live in the array at binding 2
+		sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+
+		VkDescriptorSetLayoutBinding texture_array_layout_binding{};
+		texture_array_layout_binding.binding = 2;
+		texture_array_layout_binding.descriptorCount = bindless_texture_capacity;
+		texture_array_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		texture_array_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		texture_array_layout_binding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding bindings[]{ ubo_layout_binding, sampler_layout_binding, texture_array_layout_binding };
+
+		VkDescriptorBindingFlags binding_flags[]{ 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+		binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		binding_flags_info.bindingCount = static_cast<uint32_t>(sizeof(binding_flags) / sizeof(*binding_flags));
+		binding_flags_info.pBindingFlags = binding_flags;
+#else
+		VkDescriptorSetLayoutBinding bindings[]{ ubo_layout_binding, sampler_layout_binding };
+#endif // OCH_VIRTUAL_TEXTURE
+
+		VkDescriptorSetLayoutCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		create_info.bindingCount = static_cast<uint32_t>(sizeof(bindings) / sizeof(*bindings));
+		create_info.pBindings = bindings;
+#ifdef OCH_BINDLESS
+		create_info.pNext = &binding_flags_info;
+		create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+#endif // OCH_BINDLESS
+
+		check(vkCreateDescriptorSetLayout(vk_device, &create_info, nullptr, &vk_descriptor_set_layout));
+
+		return {};
+	}
+
+	err_info create_vk_graphics_pipeline()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkPipelineLayoutCreateInfo layout_info{};
+		layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_info.setLayoutCount = 1;
+		layout_info.pSetLayouts = &vk_descriptor_set_layout;
+		layout_info.pushConstantRangeCount = 0;
+		layout_info.pPushConstantRanges = nullptr;
+
+		check(vkCreatePipelineLayout(vk_device, &layout_info, nullptr, &vk_pipeline_layout));
+
+		// Leaves a core to the main thread and the texture stream
+		const uint32_t worker_cnt = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+
+		pipeline_cache.start(vk_device, worker_cnt, [this](const och::pipeline_variant& variant, och::pipeline_pair& out)
+			{
+				if (!build_vk_graphics_pipelines(variant, out))
+					return true;
+
+				print_error_stack();
+
+				return false;
+			});
+
+		check(select_pipeline_variant());
+
+		// Would compete with the measured frames
+		if (!headless && !benchmark)
+			precompile_pipeline_variants();
+
+		return {};
+	}
+
+	// Builds a scene pipeline variant from the embedded SPIR-V, or from shaders/ for shaders that were hot reloaded. Runs on pipeline worker threads, so it reads nothing but variant and state fixed after initialisation.
+	err_info build_vk_graphics_pipelines(const och::pipeline_variant& variant, och::pipeline_pair& out)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkRenderPass render_pass;
+
+		check(build_vk_render_pass(variant.colour_format, variant.msaa_samples, variant.depth_prepass, render_pass));
+
+		VkShaderModule vert_shader_module;
+
+		check(create_shader_module("vert.spv", vert_shader_module));
+
+		VkShaderModule frag_shader_module;
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		check(create_shader_module("frag_vt.spv", frag_shader_module));
+
+		// Constant ids 0 to 7 configure virtual texturing
+		uint32_t spec_data[8 + och::shader_feature_cnt]{ vt_header.width, vt_header.height, vt_header.level_cnt, vt_header.page_dim, vt_header.border_dim, vt_atlas_tiles * vt_header.tile_dim(), vt_feedback_scale, variant.feedback_width };
+#elif defined(OCH_BINDLESS)
+		check(create_shader_module("frag_bindless.spv", frag_shader_module));
+
+		uint32_t spec_data[8 + och::shader_feature_cnt]{};
+#else
+		check(create_shader_module("frag.spv", frag_shader_module));
+
+		uint32_t spec_data[8 + och::shader_feature_cnt]{};
+#endif // OCH_VIRTUAL_TEXTURE
+
+		// Feature toggles are VkBool32 constants from id 8 on
+		for (uint32_t i = 0; i != och::shader_feature_cnt; ++i)
+			spec_data[8 + i] = (variant.shader_features >> i) & 1;
+
+		VkSpecializationMapEntry spec_entries[sizeof(spec_data) / sizeof(*spec_data)];
+
+		for (uint32_t i = 0; i != sizeof(spec_entries) / sizeof(*spec_entries); ++i)
+			spec_entries[i] = { i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+
+		VkSpecializationInfo spec_info{};
+		spec_info.mapEntryCount = static_cast<uint32_t>(sizeof(spec_entries) / sizeof(*spec_entries));
+		spec_info.pMapEntries = spec_entries;
+		spec_info.dataSize = sizeof(spec_data);
+		spec_info.pData = spec_data;
+
+		VkPipelineShaderStageCreateInfo shader_info[2]{};
+		shader_info[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shader_info[0].module = vert_shader_module;
+		shader_info[0].pName = "main";
+
+		shader_info[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shader_info[1].module = frag_shader_module;
+		shader_info[1].pName = "main";
+		shader_info[1].pSpecializationInfo = &spec_info;
+		
+		VkPipelineVertexInputStateCreateInfo vert_input_info{};
+		vert_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vert_input_info.vertexBindingDescriptionCount = 1;
+		vert_input_info.pVertexBindingDescriptions = &vertex::binding_desc;
+		vert_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(sizeof(vertex::attribute_descs) / sizeof(*vertex::attribute_descs));
+		vert_input_info.pVertexAttributeDescriptions = vertex::attribute_descs;
+
+		VkPipelineInputAssemblyStateCreateInfo input_asm_info{};
+		input_asm_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		input_asm_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		input_asm_info.primitiveRestartEnable = VK_FALSE;
+
+		// Both are dynamic, so variants do not depend on the extent
+		VkPipelineViewportStateCreateInfo view_info{};
+		view_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		view_info.viewportCount = 1;
+		view_info.pViewports = nullptr;
+		view_info.scissorCount = 1;
+		view_info.pScissors = nullptr;
+
+		VkPipelineRasterizationStateCreateInfo raster_info{};
+		raster_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		raster_info.depthClampEnable = VK_FALSE;
+		raster_info.rasterizerDiscardEnable = VK_FALSE;
+		raster_info.polygonMode = variant.polygon_mode;
+		raster_info.lineWidth = 1.0F;
+		raster_info.cullMode = variant.cull_mode;
+		raster_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		raster_info.depthBiasEnable = VK_FALSE;
+		raster_info.depthBiasConstantFactor = 0.0F;
+		raster_info.depthBiasClamp = 0.0F;
+		raster_info.depthBiasSlopeFactor = 0.0F;
+
+		VkPipelineMultisampleStateCreateInfo multisample_info{};
+		multisample_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisample_info.sampleShadingEnable = variant.sample_shading;
+		multisample_info.rasterizationSamples = variant.msaa_samples;
+		multisample_info.minSampleShading = 1.0F;
+		multisample_info.pSampleMask = nullptr;
+		multisample_info.alphaToCoverageEnable = VK_FALSE;
+		multisample_info.alphaToOneEnable = VK_FALSE;
+
+		VkPipelineColorBlendAttachmentState blend_attachment{};
+		blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		blend_attachment.blendEnable = VK_FALSE;
+		blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+		blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+		VkPipelineColorBlendStateCreateInfo blend_info{};
+		blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blend_info.logicOpEnable = VK_FALSE;
+		blend_info.logicOp = VK_LOGIC_OP_COPY;
+		blend_info.attachmentCount = 1;
+		blend_info.pAttachments = &blend_attachment;
+		blend_info.blendConstants[0] = 0.0F;
+		blend_info.blendConstants[1] = 0.0F;
+		blend_info.blendConstants[2] = 0.0F;
+		blend_info.blendConstants[3] = 0.0F;
+
+		// Viewport and scissor follow vk_render_extent without a pipeline rebuild
+		VkDynamicState dynamic_states[]{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamic_info{};
+		dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic_info.dynamicStateCount = sizeof(dynamic_states) / sizeof(*dynamic_states);
+		dynamic_info.pDynamicStates = dynamic_states;
+
+		VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
+		depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depth_stencil_info.depthTestEnable = variant.depth_test;
+		depth_stencil_info.depthWriteEnable = !variant.depth_prepass;
+		depth_stencil_info.depthCompareOp = variant.depth_prepass ? VK_COMPARE_OP_EQUAL : variant.depth_compare_op;
+		depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+		depth_stencil_info.minDepthBounds = 0.0F;
+		depth_stencil_info.maxDepthBounds = 1.0F;
+		depth_stencil_info.stencilTestEnable = VK_FALSE;
+		depth_stencil_info.front = {};
+		depth_stencil_info.back = {};
+
+		VkGraphicsPipelineCreateInfo pipeline_info{};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipeline_info.stageCount = 2;
+		pipeline_info.pStages = shader_info;
+		pipeline_info.pVertexInputState = &vert_input_info;
+		pipeline_info.pInputAssemblyState = &input_asm_info;
+		pipeline_info.pTessellationState = nullptr;
+		pipeline_info.pViewportState = &view_info;
+		pipeline_info.pRasterizationState = &raster_info;
+		pipeline_info.pMultisampleState = &multisample_info;
+		pipeline_info.pDepthStencilState = &depth_stencil_info;
+		pipeline_info.pColorBlendState = &blend_info;
+		pipeline_info.pDynamicState = &dynamic_info;
+		pipeline_info.layout = vk_pipeline_layout;
+		pipeline_info.renderPass = render_pass;
+		pipeline_info.subpass = variant.depth_prepass;
+		pipeline_info.basePipelineHandle = nullptr;
+		pipeline_info.basePipelineIndex = -1;
+
+		check(vkCreateGraphicsPipelines(vk_device, nullptr, 1, &pipeline_info, nullptr, &out.pipeline));
+
+		vkDestroyShaderModule(vk_device, vert_shader_module, nullptr);
+
+		vkDestroyShaderModule(vk_device, frag_shader_module, nullptr);
+
+		if (!variant.depth_prepass)
+		{
+			vkDestroyRenderPass(vk_device, render_pass, nullptr);
+
+			return {};
+		}
+
+		// Position-only and without a fragment shader, sharing the layout and remaining state with the main pipeline
+		VkShaderModule depth_vert_shader_module;
+
+		check(create_shader_module("depth_vert.spv", depth_vert_shader_module));
+
+		shader_info[0].module = depth_vert_shader_module;
+
+		vert_input_info.vertexAttributeDescriptionCount = 1;
+
+		multisample_info.sampleShadingEnable = VK_FALSE;
+
+		depth_stencil_info.depthTestEnable = VK_TRUE;
+		depth_stencil_info.depthWriteEnable = VK_TRUE;
+		depth_stencil_info.depthCompareOp = variant.depth_compare_op;
+
+		pipeline_info.stageCount = 1;
+		pipeline_info.pColorBlendState = nullptr;
+		pipeline_info.subpass = 0;
+
+		check(vkCreateGraphicsPipelines(vk_device, nullptr, 1, &pipeline_info, nullptr, &out.depth_prepass_pipeline));
+
+		vkDestroyShaderModule(vk_device, depth_vert_shader_module, nullptr);
+
+		vkDestroyRenderPass(vk_device, render_pass, nullptr);
+
+		return {};
+	}
+
+	VkCompareOp depth_compare_op() const
+	{
+		return reversed_z ? VK_COMPARE_OP_GREATER : VK_COMPARE_OP_LESS;
+	}
+	
+	err_info create_vk_command_pool()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		queue_family_indices family_indices;
+
+		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+
+		VkCommandPoolCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		create_info.queueFamilyIndex = family_indices.graphics_idx;
+		create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		check(vkCreateCommandPool(vk_device, &create_info, nullptr, &vk_command_pool));
+
+		return {};
+	}
+
+	// Command pool, pipeline, counter and timeline for generating mips on the compute queue, see submit_mip_generation
+	err_info create_vk_mip_generator()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		queue_family_indices family_indices;
+
+		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+
+		VkCommandPoolCreateInfo pool_info{};
+		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_info.queueFamilyIndex = family_indices.compute_idx;
+		pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		check(vkCreateCommandPool(vk_device, &pool_info, nullptr, &vk_compute_command_pool));
+
+		VkDescriptorSetLayoutBinding bindings[2]{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[0].descriptorCount = downsample_max_levels + 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo set_layout_info{};
+		set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		set_layout_info.bindingCount = 2;
+		set_layout_info.pBindings = bindings;
+
+		check(vkCreateDescriptorSetLayout(vk_device, &set_layout_info, nullptr, &vk_downsample_set_layout));
+
+		// Source extent, level count and workgroup count
+		VkPushConstantRange push_range{};
+		push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_range.offset = 0;
+		push_range.size = 4 * sizeof(uint32_t);
+
+		VkPipelineLayoutCreateInfo layout_info{};
+		layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_info.setLayoutCount = 1;
+		layout_info.pSetLayouts = &vk_downsample_set_layout;
+		layout_info.pushConstantRangeCount = 1;
+		layout_info.pPushConstantRanges = &push_range;
+
+		check(vkCreatePipelineLayout(vk_device, &layout_info, nullptr, &vk_downsample_pipeline_layout));
+
+		VkShaderModule comp_shader_module;
+
+		check(create_shader_module("downsample_comp.spv", comp_shader_module));
+
+		VkComputePipelineCreateInfo pipeline_info{};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_info.stage.module = comp_shader_module;
+		pipeline_info.stage.pName = "main";
+		pipeline_info.layout = vk_downsample_pipeline_layout;
+
+		check(vkCreateComputePipelines(vk_device, nullptr, 1, &pipeline_info, nullptr, &vk_downsample_pipeline));
+
+		vkDestroyShaderModule(vk_device, comp_shader_module, nullptr);
+
+		check(allocate_buffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_downsample_counter, vk_downsample_counter_memory));
+
+		resource_states.track_buffer(vk_downsample_counter);
+
+		VkSemaphoreTypeCreateInfo timeline_info{};
+		timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timeline_info.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphore_info{};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphore_info.pNext = &timeline_info;
+
+		check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_mip_timeline));
+
+		return {};
+	}
+
+	// Creates the render target images, lets the frame graph plan which of them can share memory and binds them accordingly
+	err_info create_vk_render_targets()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		if (has_dynamic_resolution())
+		{
+			check(create_image(vk_swapchain_extent.width, vk_swapchain_extent.height, vk_swapchain_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, vk_scene_image));
+
+			VkFormatProperties format_props;
+
+			vkGetPhysicalDeviceFormatProperties(vk_physical_device, vk_swapchain_format, &format_props);
+
+			vk_upscale_filter = format_props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+		}
+		else
+		{
+			vk_scene_image = nullptr;
+
+			vk_scene_image_view = nullptr;
+		}
+
+		if (vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			check(create_image(vk_swapchain_extent.width, vk_swapchain_extent.height, vk_swapchain_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, vk_colour_image, vk_msaa_samples));
+		}
+		else
+		{
+			vk_colour_image = nullptr;
+
+			vk_colour_image_view = nullptr;
+		}
+
+		constexpr bool is_depth_transient = depth_store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		const VkImageUsageFlags depth_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (is_depth_transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+
+		check(create_image(vk_swapchain_extent.width, vk_swapchain_extent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, depth_usage, vk_depth_image, vk_msaa_samples));
+
+		// Every swapchain image gets the same graph, so planning with the first one holds for all of them
+		och::render_graph graph;
+
+		build_frame_graph(graph, 0);
+
+		graph.compile();
+
+		std::vector<VkMemoryRequirements> mem_reqs(graph.resources.size());
+
+		for (size_t i = 0; i != graph.resources.size(); ++i)
+			if (graph.resources[i].is_transient)
+				vkGetImageMemoryRequirements(vk_device, graph.resources[i].image, &mem_reqs[i]);
+
+		graph.plan_aliasing(mem_reqs.data(), render_target_blocks, render_target_block_idxs);
+
+		vk_render_target_memory.resize(render_target_blocks.size());
+
+		for (size_t i = 0; i != render_target_blocks.size(); ++i)
+		{
+			const och::rg_memory_block& block = render_target_blocks[i];
+
+			// Lazily allocated memory only takes transient attachments, everything else stays in plain device memory
+			const VkMemoryPropertyFlags property_flags = block.alias_class == alias_class_lazy ? transient_attachment_memory_flags() : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+			uint32_t mem_type_idx;
+
+			check(query_memory_type_index(block.memory_type_bits, property_flags, mem_type_idx));
+
+			VkMemoryAllocateInfo alloc_info{};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = block.size;
+			alloc_info.memoryTypeIndex = mem_type_idx;
+
+			check(vkAllocateMemory(vk_device, &alloc_info, nullptr, &vk_render_target_memory[i]));
+		}
+
+		for (size_t i = 0; i != graph.resources.size(); ++i)
+		{
+			if (!graph.resources[i].is_transient)
+				continue;
+
+			// A render target no live pass uses would be left without memory
+			if (render_target_block_idxs[i] == och::render_graph::no_block)
+				return ERROR(1);
+
+			check(vkBindImageMemory(vk_device, graph.resources[i].image, vk_render_target_memory[render_target_block_idxs[i]], 0));
+		}
+
+		if (vk_scene_image)
+			check(allocate_image_view(vk_scene_image, vk_swapchain_format, VK_IMAGE_ASPECT_COLOR_BIT, vk_scene_image_view));
+
+		if (vk_colour_image)
+			check(allocate_image_view(vk_colour_image, vk_swapchain_format, VK_IMAGE_ASPECT_COLOR_BIT, vk_colour_image_view));
+
+		check(allocate_image_view(vk_depth_image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, vk_depth_image_view));
+
+		// The render pass transitions depth from UNDEFINED on every begin, so touching lazily allocated memory up front is not needed
+
+		return {};
+	}
+
+	VkMemoryPropertyFlags transient_attachment_memory_flags() const
+	{
+		return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | (has_lazily_allocated_memory ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0);
+	}
+
+	// Requested is what the render targets would take with memory of their own, allocated what the aliased blocks take.
+	// Lazily allocated blocks only count what the driver actually committed, which is nothing if they stay in tile memory.
+	void print_attachment_memory_stats() const
+	{
+		VkDeviceSize requested_bytes = 0;
+
+		for (VkImage image : { vk_colour_image, vk_depth_image, vk_scene_image })
+		{
+			if (!image)
+				continue;
+
+			VkMemoryRequirements mem_reqs;
+
+			vkGetImageMemoryRequirements(vk_device, image, &mem_reqs);
+
+			requested_bytes += mem_reqs.size;
+		}
+
+		VkDeviceSize allocated_bytes = 0;
+
+		VkDeviceSize committed_bytes = 0;
+
+		for (size_t i = 0; i != render_target_blocks.size(); ++i)
+		{
+			allocated_bytes += render_target_blocks[i].size;
+
+			VkDeviceSize block_committed_bytes = render_target_blocks[i].size;
+
+			if (has_lazily_allocated_memory && render_target_blocks[i].alias_class == alias_class_lazy)
+				vkGetDeviceMemoryCommitment(vk_device, vk_render_target_memory[i], &block_committed_bytes);
+
+			committed_bytes += block_committed_bytes;
+		}
+
+		och::print("Render target memory: {} KiB requested, {} KiB allocated in {} blocks, {} KiB committed ({} KiB saved by aliasing, {} KiB by lazy allocation)\n\n",
+			requested_bytes >> 10, allocated_bytes >> 10, render_target_blocks.size(), committed_bytes >> 10, (requested_bytes - allocated_bytes) >> 10, (allocated_bytes - committed_bytes) >> 10);
+	}
+
+	void finish_startup_report()
+	{
+		startup_report.first_present_ms = (och::trace_now_ns() - startup_report.beg_ns) / 1'000'000.0F;
+
+		startup_report.peak_resident_bytes = och::trace_peak_resident_bytes();
+
+		benchmark_stats.first_present_ms = startup_report.first_present_ms;
+
+		print_startup_report();
+
+		if (startup_report_path && !och::write_startup_report_json(startup_report_path, startup_report))
+			och::print("Could not write startup report to {}\n", startup_report_path);
+	}
+
+	void print_startup_report() const
+	{
+		och::print("First frame after {} ms, with a peak resident set of {} KiB. The task graph took {} ms, {} ms with one task after another.\n",
+			startup_report.first_present_ms, startup_report.peak_resident_bytes / 1024, startup_report.graph_wall_ms, startup_report.graph_sequential_ms);
+
+		och::print("Startup stages by wall time (wall / CPU ms, peak resident growth, * on the critical path):\n");
+
+		for (const och::startup_stage* stage : startup_report.sorted_stages())
+			och::print("\t{}{} / {} ms, +{} KiB: {}\n", stage->is_critical ? "* " : "  ", stage->wall_ms, stage->cpu_ms, stage->peak_resident_growth / 1024, stage->name.c_str());
+
+		och::print("\n");
+	}
+
+	void print_pipeline_cache_stats() const
+	{
+		och::print("Pipeline variants: {} built, {} lookups fell back to a compatible variant\n\n", pipeline_cache.built_cnt, pipeline_cache.fallback_cnt);
+	}
+
+	void print_barrier_stats() const
+	{
+		och::print("Upload barriers: {} in {} {} calls, {} subresource accesses needed none\n\n", resource_states.recorded_barrier_cnt, resource_states.flush_cnt,
+			has_synchronization2 ? "vkCmdPipelineBarrier2KHR" : "vkCmdPipelineBarrier", resource_states.skipped_access_cnt);
+	}
+
+	err_info create_vk_swapchain_framebuffers()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_swapchain_framebuffers.resize(vk_swapchain_views.size());
+
+		for (size_t i = 0; i != vk_swapchain_views.size(); ++i)
+		{
+			const bool has_resolve = vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+			const VkImageView output_view = has_dynamic_resolution() ? vk_scene_image_view : vk_swapchain_views[i];
+
+			VkImageView attachments[]{ has_resolve ? vk_colour_image_view : output_view, vk_depth_image_view, output_view };
+
+			VkFramebufferCreateInfo create_info{};
+			create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			create_info.renderPass = vk_render_pass;
+			create_info.attachmentCount = has_resolve ? 3 : 2;
+			create_info.pAttachments = attachments;
+			create_info.width = vk_swapchain_extent.width;
+			create_info.height = vk_swapchain_extent.height;
+			create_info.layers = 1;
+
+			check(vkCreateFramebuffer(vk_device, &create_info, nullptr, &vk_swapchain_framebuffers[i]));
+		}
+
+		return {};
+	}
+
+	err_info create_vk_texture_image()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		och::mapped_file<bitmap_header> texture_file(scene_texture_paths[0].c_str(), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+
+		if (!texture_file)
+			return ERROR(1);
+
+		const bitmap_header& header = texture_file[0];
+
+		if (header.bits_per_pixel != 24 && header.bits_per_pixel != 32)
+			return ERROR(1);
+
+		vk_texture_width = static_cast<uint32_t>(header.width);
+
+		vk_texture_height = static_cast<uint32_t>(header.height);
+
+		const uint32_t mip_levels = mip_level_cnt(vk_texture_width, vk_texture_height);
+
+		vk_texture_image_mipmap_levels = mip_levels;
+
+		compute_mip_offsets(vk_texture_width, vk_texture_height, mip_levels, texture_mip_offsets);
+
+		// Everything from the tail level down is resident before the first frame; finer levels are streamed in afterwards.
+		uint32_t tail_level = 0;
+
+		while (tail_level + 1 != mip_levels && (mip_extent(vk_texture_width, tail_level) > texture_stream_tail_dim || mip_extent(vk_texture_height, tail_level) > texture_stream_tail_dim))
+			++tail_level;
+
+		texture_stream_tail_level = tail_level;
+
+		check(allocate_buffer(texture_mip_offsets[mip_levels], VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, texture_stream_staging_buf, texture_stream_staging_buf_mem));
+
+		check(vkMapMemory(vk_device, texture_stream_staging_buf_mem, 0, texture_mip_offsets[mip_levels], 0, reinterpret_cast<void**>(&texture_stream_staging_data)));
+
+		sample_bitmap_sparse(header, tail_level, reinterpret_cast<uint32_t*>(texture_stream_staging_data + texture_mip_offsets[tail_level]));
+
+		for (uint32_t i = tail_level; i + 1 < mip_levels; ++i)
+			downsample_texels(reinterpret_cast<const uint32_t*>(texture_stream_staging_data + texture_mip_offsets[i]), mip_extent(vk_texture_width, i), mip_extent(vk_texture_height, i), reinterpret_cast<uint32_t*>(texture_stream_staging_data + texture_mip_offsets[i + 1]));
+
+		check(allocate_image(vk_texture_width, vk_texture_height, VK_FORMAT_B8G8R8A8_SRGB, 
+			                 VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+			                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_texture_image, vk_texture_image_memory, VK_SAMPLE_COUNT_1_BIT, mip_levels));
+
+		resource_states.track_image(vk_texture_image, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+
+		VkCommandBuffer cmd_buffer;
+
+		check(beg_single_command(cmd_buffer));
+
+		record_texture_level_upload(cmd_buffer, vk_texture_image, texture_stream_staging_buf, texture_mip_offsets.data(), vk_texture_width, vk_texture_height, tail_level, mip_levels - tail_level);
+
+		check(end_single_command(cmd_buffer));
+
+		vk_texture_resident_level = tail_level;
+
+		if (tail_level == 0)
+		{
+			// The whole texture fit into the tail, so there is nothing left to stream.
+			finish_texture_stream();
+
+			return {};
+		}
+
+		VkCommandBufferAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = 1;
+		alloc_info.commandPool = vk_command_pool;
+
+		check(vkAllocateCommandBuffers(vk_device, &alloc_info, &texture_stream_command_buffer));
+
+		texture_stream_next_level = mip_levels - 1;
+
+		texture_stream_thread = std::thread(&hello_vulkan::texture_stream_worker, this);
+
+		return {};
+	}
+
+	void texture_stream_worker()
+	{
+		och::trace_set_thread_name("texture stream");
+
+		if (decode_texture_mips())
+			texture_stream_failed.store(true, std::memory_order_relaxed);
+
+		texture_stream_ready.store(true, std::memory_order_release);
+	}
+
+	err_info decode_texture_mips()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		och::mapped_file<bitmap_header> texture_file(scene_texture_paths[0].c_str(), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+
+		if (!texture_file)
+			return ERROR(1);
+
+		sample_bitmap_sparse(texture_file[0], 0, reinterpret_cast<uint32_t*>(texture_stream_staging_data));
+
+		for (uint32_t i = 0; i + 1 < vk_texture_image_mipmap_levels; ++i)
+			downsample_texels(reinterpret_cast<const uint32_t*>(texture_stream_staging_data + texture_mip_offsets[i]), mip_extent(vk_texture_width, i), mip_extent(vk_texture_height, i), reinterpret_cast<uint32_t*>(texture_stream_staging_data + texture_mip_offsets[i + 1]));
+
+		return {};
+	}
+
+	err_info update_texture_stream()
+	{
+		if (!texture_stream_command_buffer)
+			return {};
+
+		if (texture_stream_pending_level != ~0u)
+		{
+			uint64_t completed_value;
+
+			check(vkGetSemaphoreCounterValue(vk_device, vk_frame_timeline, &completed_value));
+
+			if (completed_value < texture_stream_pending_value)
+				return {};
+
+			check(collect_gpu_timestamps(texture_stream_gpu_scope_group()));
+
+			if (texture_stream_pending_level < vk_texture_resident_level)
+			{
+				vk_texture_resident_level = texture_stream_pending_level;
+
+				check(select_vk_texture_image_view(vk_texture_resident_level));
+			}
+
+			texture_stream_pending_level = ~0u;
+
+			if (texture_stream_next_level == ~0u)
+			{
+				finish_texture_stream();
+
+				return {};
+			}
+		}
+
+		if (!texture_stream_ready.load(std::memory_order_acquire))
+			return {};
+
+		if (texture_stream_failed.load(std::memory_order_relaxed))
+			return ERROR(1);
+
+		// One level per frame, coarsest first. The tail is uploaded again with properly filtered contents.
+		const uint32_t level = texture_stream_next_level;
+
+		VkCommandBufferBeginInfo beg_info{};
+		beg_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beg_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		check(vkBeginCommandBuffer(texture_stream_command_buffer, &beg_info));
+
+		record_gpu_scope_beg(texture_stream_command_buffer, texture_stream_gpu_scope_group(), gpu_scope_texture_stream);
+
+		record_texture_level_upload(texture_stream_command_buffer, vk_texture_image, texture_stream_staging_buf, texture_mip_offsets.data(), vk_texture_width, vk_texture_height, level, 1);
+
+		record_gpu_scope_end(texture_stream_command_buffer, texture_stream_gpu_scope_group(), gpu_scope_texture_stream);
+
+		check(vkEndCommandBuffer(texture_stream_command_buffer));
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &texture_stream_command_buffer;
+
+		check(vkQueueSubmit(vk_graphics_queue, 1, &submit_info, nullptr));
+
+		// The next frame's signal also covers this earlier submission
+		texture_stream_pending_value = frame_timeline_value + 1;
+
+		if (vk_timestamp_query_pool)
+			gpu_scope_written_masks[texture_stream_gpu_scope_group()] = 1 << gpu_scope_texture_stream;
+
+		texture_stream_pending_level = level;
+
+		texture_stream_next_level = level == 0 ? ~0u : level - 1;
+
+		return {};
+	}
+
+	void finish_texture_stream()
+	{
+		if (texture_stream_thread.joinable())
+			texture_stream_thread.join();
+
+		if (texture_stream_pending_level != ~0u)
+			wait_frame_timeline(texture_stream_pending_value);
+
+		texture_stream_next_level = ~0u;
+
+		texture_stream_pending_level = ~0u;
+
+		if (texture_stream_staging_buf_mem)
+			vkUnmapMemory(vk_device, texture_stream_staging_buf_mem);
+
+		vkDestroyBuffer(vk_device, texture_stream_staging_buf, nullptr);
+
+		vkFreeMemory(vk_device, texture_stream_staging_buf_mem, nullptr);
+
+		if (texture_stream_command_buffer)
+			vkFreeCommandBuffers(vk_device, vk_command_pool, 1, &texture_stream_command_buffer);
+
+		texture_stream_staging_buf = nullptr;
+
+		texture_stream_staging_buf_mem = nullptr;
+
+		texture_stream_staging_data = nullptr;
+
+		texture_stream_command_buffer = nullptr;
+	}
+
+	void start_shader_reload()
+	{
+		shader_reload_stop.store(false, std::memory_order_relaxed);
+
+		shader_reload_thread = std::thread(&hello_vulkan::shader_reload_worker, this);
+	}
+
+	void stop_shader_reload()
+	{
+		shader_reload_stop.store(true, std::memory_order_relaxed);
+
+		if (shader_reload_thread.joinable())
+			shader_reload_thread.join();
+	}
+
+	// Recompiles GLSL sources as they change and has the pipeline cache rebuild every variant from them, leaving the swap to select_pipeline_variant
+	void shader_reload_worker()
+	{
+		och::trace_set_thread_name("shader reload");
+
+		och::file_watcher watcher;
+
+		if (!watcher.open("shaders"))
+		{
+			och::print("Could not watch shaders, hot reload is disabled\n");
+
+			return;
+		}
+
+		while (!shader_reload_stop.load(std::memory_order_relaxed))
+		{
+			// Short enough for stop_shader_reload not to wait noticeably
+			const std::vector<std::string> changed = watcher.wait(100);
+
+			bool needs_rebuild = false;
+
+			for (const shader_target& target : shader_targets)
+			{
+				if (std::find(changed.begin(), changed.end(), target.source) == changed.end())
+					continue;
+
+				const std::string source_path = std::string("shaders/") + target.source;
+
+				const std::string output_path = std::string("shaders/") + target.output;
+
+				// A failed compile leaves the previous SPIR-V in place
+				if (!och::compile_glsl(source_path.c_str(), target.defines, output_path.c_str()))
+				{
+					och::print("Could not compile {}, keeping the previous {}\n", source_path.c_str(), target.output);
+
+					continue;
+				}
+
+				reloaded_shader_mask.fetch_or(1u << static_cast<uint32_t>(&target - shader_targets), std::memory_order_release);
+
+				if (target.is_scene_shader)
+					needs_rebuild = true;
+			}
+
+			if (needs_rebuild)
+				pipeline_cache.invalidate();
+		}
+	}
+
+	och::pipeline_variant current_pipeline_variant() const
+	{
+		och::pipeline_variant variant;
+		variant.colour_format = vk_swapchain_format;
+		variant.msaa_samples = vk_msaa_samples;
+		variant.cull_mode = cull_mode;
+		variant.polygon_mode = wireframe && has_fill_mode_non_solid ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+		variant.depth_compare_op = depth_compare_op();
+		variant.shader_features = shader_features;
+#ifdef OCH_VIRTUAL_TEXTURE
+		variant.feedback_width = (vk_swapchain_extent.width + vt_feedback_scale - 1) / vt_feedback_scale;
+#endif // OCH_VIRTUAL_TEXTURE
+		variant.sample_shading = sample_shading && has_sample_rate_shading && vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+		variant.depth_prepass = depth_prepass;
+		variant.depth_test = depth_test;
+
+		return variant;
+	}
+
+	// Queues the variants one key press or AA tier away from the current settings, so switching rarely has to fall back
+	void precompile_pipeline_variants()
+	{
+		const och::pipeline_variant current = current_pipeline_variant();
+
+		och::pipeline_variant variant = current;
+		variant.cull_mode = current.cull_mode == VK_CULL_MODE_NONE ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+		pipeline_cache.request(variant);
+
+		if (has_fill_mode_non_solid)
+		{
+			variant = current;
+			variant.polygon_mode = current.polygon_mode == VK_POLYGON_MODE_FILL ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+			pipeline_cache.request(variant);
+		}
+
+		variant = current;
+		variant.depth_test = !current.depth_test;
+		pipeline_cache.request(variant);
+
+		for (uint32_t i = 0; i != och::shader_feature_cnt; ++i)
+		{
+			variant = current;
+			variant.shader_features ^= 1u << i;
+			pipeline_cache.request(variant);
+		}
+
+		VkPhysicalDeviceProperties props;
+
+		vkGetPhysicalDeviceProperties(vk_physical_device, &props);
+
+		const VkSampleCountFlags compat = props.limits.framebufferDepthSampleCounts & props.limits.framebufferColorSampleCounts;
+
+		// Every tier M cycles through, with and without sample shading and the depth pre-pass
+		for (uint32_t samples = 1; samples <= 8; samples *= 2)
+		{
+			if (!(compat & samples))
+				continue;
+
+			for (uint32_t i = 0; i != 4; ++i)
+			{
+				const bool is_shaded = (i & 1) != 0;
+
+				if (is_shaded && (!has_sample_rate_shading || samples == 1))
+					continue;
+
+				variant = current;
+				variant.msaa_samples = static_cast<VkSampleCountFlagBits>(samples);
+				variant.sample_shading = is_shaded;
+				variant.depth_prepass = (i & 2) != 0;
+				pipeline_cache.request(variant);
+			}
+		}
+	}
+
+	// Binds the pipelines for the current settings, or the closest compatible ready ones while those are still being built.
+	// Only blocks if nothing compatible with vk_render_pass is ready. Swapped out and rebuilt pipelines are destroyed once their frames retired.
+	err_info select_pipeline_variant()
+	{
+		std::vector<VkPipeline> replaced;
+
+		pipeline_cache.collect_retired(replaced);
+
+		for (VkPipeline pipeline : replaced)
+			retired_pipelines.emplace_back(pipeline, frame_timeline_value);
+
+		if (!retired_pipelines.empty())
+		{
+			uint64_t completed_value;
+
+			check(vkGetSemaphoreCounterValue(vk_device, vk_frame_timeline, &completed_value));
+
+			auto retired_end = std::remove_if(retired_pipelines.begin(), retired_pipelines.end(), [&](const std::pair<VkPipeline, uint64_t>& retired)
+				{
+					if (retired.second > completed_value)
+						return false;
+
+					vkDestroyPipeline(vk_device, retired.first, nullptr);
+
+					return true;
+				});
+
+			retired_pipelines.erase(retired_end, retired_pipelines.end());
+		}
+
+		const och::pipeline_variant variant = current_pipeline_variant();
+
+		och::pipeline_pair pipelines;
+
+		if (pipeline_cache.lookup(variant, pipelines) == och::pipeline_variant_cache::lookup_result::missing && !pipeline_cache.wait(variant, pipelines))
+			return ERROR(1);
+
+		if (pipelines.pipeline == vk_graphics_pipeline && pipelines.depth_prepass_pipeline == vk_depth_prepass_pipeline)
+			return {};
+
+		vk_graphics_pipeline = pipelines.pipeline;
+
+		vk_depth_prepass_pipeline = pipelines.depth_prepass_pipeline;
+
+		// Each is re-recorded once its image comes up next, so frames in flight keep the previous pipelines
+		vk_command_buffers_stale.assign(vk_command_buffers.size(), true);
+
+		return {};
+	}
+
+	// Every uploaded level is overwritten in full, so its previous contents are discarded
+	void record_texture_level_upload(VkCommandBuffer cmd_buffer, VkImage image, VkBuffer staging_buf, const VkDeviceSize* level_offsets, uint32_t width, uint32_t height, uint32_t base_level, uint32_t level_cnt)
+	{
+		resource_states.access_image(image, och::access_transfer_dst, base_level, level_cnt, true);
+
+		resource_states.flush(cmd_buffer);
+
+		for (uint32_t i = base_level; i != base_level + level_cnt; ++i)
+		{
+			VkBufferImageCopy copy_region{};
+			copy_region.bufferOffset = level_offsets[i];
+			copy_region.bufferRowLength = 0;
+			copy_region.bufferImageHeight = 0;
+			copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_region.imageSubresource.mipLevel = i;
+			copy_region.imageSubresource.baseArrayLayer = 0;
+			copy_region.imageSubresource.layerCount = 1;
+			copy_region.imageOffset = { 0, 0, 0 };
+			copy_region.imageExtent = { mip_extent(width, i), mip_extent(height, i), 1 };
+
+			vkCmdCopyBufferToImage(cmd_buffer, staging_buf, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+		}
+
+		resource_states.access_image(image, och::access_fragment_sampled, base_level, level_cnt);
+
+		resource_states.flush(cmd_buffer);
+	}
+
+	err_info create_vk_texture_image_view()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_texture_image_level_views.resize(vk_texture_image_mipmap_levels, nullptr);
+
+#ifdef OCH_BINDLESS
+		bindless_texture_views.assign(1, nullptr);
+#endif // OCH_BINDLESS
+
+		check(select_vk_texture_image_view(vk_texture_resident_level));
+
+		return {};
+	}
+
+	err_info select_vk_texture_image_view(uint32_t base_level)
+	{
+		// Views are kept per base level until cleanup, as stale descriptor sets may still reference older ones.
+		if (!vk_texture_image_level_views[base_level])
+			check(allocate_image_view(vk_texture_image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, vk_texture_image_level_views[base_level], vk_texture_image_mipmap_levels - base_level, base_level));
+
+		vk_texture_image_view = vk_texture_image_level_views[base_level];
+
+#ifdef OCH_BINDLESS
+		bindless_texture_views[0] = vk_texture_image_view;
+#endif // OCH_BINDLESS
+
+		for (size_t i = 0; i != vk_descriptor_sets_stale.size(); ++i)
+			vk_descriptor_sets_stale[i] = true;
+
+		return {};
+	}
+
+#ifdef OCH_VIRTUAL_TEXTURE
+	err_info open_virtual_texture_file()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		// Only the scene's first texture is virtualised; every mesh samples it.
+		const std::string& bitmap_path = scene_texture_paths[0];
+
+		const std::string vt_path = bitmap_path.substr(0, bitmap_path.find_last_of('.')) + ".vt";
+
+		vt_file = std::make_unique<och::mapped_file<uint8_t>>(vt_path.c_str(), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+
+		// Tile the source bitmap once if there is no pre-tiled file yet
+		if (!*vt_file)
+		{
+			check(write_virtual_texture_file(bitmap_path.c_str(), vt_path.c_str()));
+
+			vt_file = std::make_unique<och::mapped_file<uint8_t>>(vt_path.c_str(), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+		}
+
+		if (!*vt_file || vt_file->bytes < sizeof(vt_header))
+			return ERROR(1);
+
+		memcpy(&vt_header, vt_file->get_data().beg, sizeof(vt_header));
+
+		if (memcmp(vt_header.magic, "OCVT", 4) || vt_header.page_dim != vt_page_dim || vt_header.border_dim != vt_border_dim)
+			return ERROR(1);
+
+		return {};
+	}
+
+	err_info create_vk_virtual_texture()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		const uint32_t atlas_dim = vt_atlas_tiles * vt_header.tile_dim();
+
+		check(allocate_image(atlas_dim, atlas_dim, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vt_atlas_image, vt_atlas_image_memory));
+
+		resource_states.track_image(vt_atlas_image, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+		check(allocate_image_view(vt_atlas_image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, vt_atlas_image_view));
+
+		// Page table dimensions are rounded up to powers of two, so that a page's parent is always found at half its coordinates one mip down
+		vt_page_table_width = 1;
+
+		while (vt_page_table_width < vt_header.pages_x(0))
+			vt_page_table_width <<= 1;
+
+		vt_page_table_height = 1;
+
+		while (vt_page_table_height < vt_header.pages_y(0))
+			vt_page_table_height <<= 1;
+
+		vt_page_table_offsets.resize(vt_header.level_cnt + 1);
+
+		vt_page_table_offsets[0] = 0;
+
+		for (uint32_t i = 0; i != vt_header.level_cnt; ++i)
+			vt_page_table_offsets[i + 1] = vt_page_table_offsets[i] + mip_extent(vt_page_table_width, i) * mip_extent(vt_page_table_height, i);
+
+		vt_page_table.resize(vt_page_table_offsets[vt_header.level_cnt]);
+
+		check(allocate_image(vt_page_table_width, vt_page_table_height, VK_FORMAT_R32_UINT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vt_page_table_image, vt_page_table_image_memory, VK_SAMPLE_COUNT_1_BIT, vt_header.level_cnt));
+
+		resource_states.track_image(vt_page_table_image, VK_IMAGE_ASPECT_COLOR_BIT, vt_header.level_cnt);
+
+		check(allocate_image_view(vt_page_table_image, VK_FORMAT_R32_UINT, VK_IMAGE_ASPECT_COLOR_BIT, vt_page_table_image_view, vt_header.level_cnt));
+
+		VkSamplerCreateInfo sampler_info{};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_LINEAR;
+		sampler_info.minFilter = VK_FILTER_LINEAR;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.anisotropyEnable = VK_FALSE;
+		sampler_info.maxAnisotropy = 1.0F;
+		sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		sampler_info.unnormalizedCoordinates = VK_FALSE;
+		sampler_info.compareEnable = VK_FALSE;
+		sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sampler_info.mipLodBias = 0.0F;
+		sampler_info.minLod = 0.0F;
+		sampler_info.maxLod = 0.0F;
+
+		check(vkCreateSampler(vk_device, &sampler_info, nullptr, &vt_atlas_sampler));
+
+		sampler_info.magFilter = VK_FILTER_NEAREST;
+		sampler_info.minFilter = VK_FILTER_NEAREST;
+		sampler_info.maxLod = static_cast<float>(vt_header.level_cnt);
+
+		check(vkCreateSampler(vk_device, &sampler_info, nullptr, &vt_page_table_sampler));
+
+		const VkDeviceSize staging_bytes = vt_max_uploads_per_frame * vt_header.tile_bytes() + vt_page_table.size() * sizeof(uint32_t);
+
+		for (uint32_t i = 0; i != max_frames_in_flight; ++i)
+			check(allocate_buffer(staging_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vt_staging_bufs[i], vt_staging_bufs_memory[i]));
+
+		VkCommandBufferAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = max_frames_in_flight;
+		alloc_info.commandPool = vk_command_pool;
+
+		check(vkAllocateCommandBuffers(vk_device, &alloc_info, vt_upload_command_buffers));
+
+		vt_tile_pages.assign(vt_atlas_tiles * vt_atlas_tiles, ~0u);
+
+		vt_tile_last_use.assign(vt_atlas_tiles * vt_atlas_tiles, 0);
+
+		// The single page of the coarsest level is pinned in tile 0 and serves as the fallback for everything else
+		void* staging_data;
+
+		check(vkMapMemory(vk_device, vt_staging_bufs_memory[0], 0, staging_bytes, 0, &staging_data));
+
+		check(read_vt_tile(vt_header.level_cnt - 1, 0, 0, static_cast<uint8_t*>(staging_data)));
+
+		vt_resident_pages[vt_page_key(vt_header.level_cnt - 1, 0, 0)] = 0;
+
+		vt_tile_pages[0] = vt_page_key(vt_header.level_cnt - 1, 0, 0);
+
+		vt_tile_last_use[0] = UINT64_MAX;
+
+		rebuild_vt_page_table(static_cast<uint8_t*>(staging_data) + vt_header.tile_bytes());
+
+		vkUnmapMemory(vk_device, vt_staging_bufs_memory[0]);
+
+		VkCommandBuffer cmd_buffer;
+
+		check(beg_single_command(cmd_buffer));
+
+		record_vt_uploads(cmd_buffer, vt_staging_bufs[0], 1);
+
+		check(end_single_command(cmd_buffer));
+
+		vt_stream_thread = std::thread(&hello_vulkan::vt_stream_worker, this);
+
+		return {};
+	}
+
+	err_info write_virtual_texture_file(const char* bitmap_filename, const char* filename)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		och::mapped_file<bitmap_header> texture_file(bitmap_filename, och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+
+		if (!texture_file)
+			return ERROR(1);
+
+		const bitmap_header& bmp = texture_file[0];
+
+		if (bmp.bits_per_pixel != 24 && bmp.bits_per_pixel != 32)
+			return ERROR(1);
+
+		virtual_texture_header header{};
+		memcpy(header.magic, "OCVT", 4);
+		header.width = static_cast<uint32_t>(bmp.width);
+		header.height = static_cast<uint32_t>(bmp.height);
+		header.page_dim = vt_page_dim;
+		header.border_dim = vt_border_dim;
+		header.level_cnt = 1;
+
+		while (header.pages_x(header.level_cnt - 1) != 1 || header.pages_y(header.level_cnt - 1) != 1)
+			++header.level_cnt;
+
+		std::vector<size_t> level_offsets(header.level_cnt + 1);
+
+		level_offsets[0] = 0;
+
+		for (uint32_t i = 0; i != header.level_cnt; ++i)
+			level_offsets[i + 1] = level_offsets[i] + static_cast<size_t>(mip_extent(header.width, i)) * mip_extent(header.height, i);
+
+		std::vector<uint32_t> levels(level_offsets[header.level_cnt]);
+
+		sample_bitmap_sparse(bmp, 0, levels.data());
+
+		for (uint32_t i = 0; i + 1 < header.level_cnt; ++i)
+			downsample_texels(levels.data() + level_offsets[i], mip_extent(header.width, i), mip_extent(header.height, i), levels.data() + level_offsets[i + 1]);
+
+		std::ofstream out(filename, std::ios::binary);
+
+		if (!out.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+			return ERROR(1);
+
+		const uint32_t tile_dim = header.tile_dim();
+
+		std::vector<uint32_t> tile(static_cast<size_t>(tile_dim) * tile_dim);
+
+		for (uint32_t level = 0; level != header.level_cnt; ++level)
+		{
+			const uint32_t level_w = mip_extent(header.width, level);
+			const uint32_t level_h = mip_extent(header.height, level);
+
+			const uint32_t* level_texels = levels.data() + level_offsets[level];
+
+			for (uint32_t page_y = 0; page_y != header.pages_y(level); ++page_y)
+				for (uint32_t page_x = 0; page_x != header.pages_x(level); ++page_x)
+				{
+					// Borders repeat the neighbouring pages' texels, clamped at the texture's edges
+					for (uint32_t y = 0; y != tile_dim; ++y)
+						for (uint32_t x = 0; x != tile_dim; ++x)
+						{
+							int64_t src_x = static_cast<int64_t>(page_x) * header.page_dim + x - header.border_dim;
+							int64_t src_y = static_cast<int64_t>(page_y) * header.page_dim + y - header.border_dim;
+
+							src_x = src_x < 0 ? 0 : src_x >= level_w ? level_w - 1 : src_x;
+							src_y = src_y < 0 ? 0 : src_y >= level_h ? level_h - 1 : src_y;
+
+							tile[y * tile_dim + x] = level_texels[src_y * level_w + src_x];
+						}
+
+					if (!out.write(reinterpret_cast<const char*>(tile.data()), tile.size() * sizeof(uint32_t)))
+						return ERROR(1);
+				}
+		}
+
+		return {};
+	}
+
+	err_info create_vt_feedback_buffers()
+	{
+		vt_feedback_width = (vk_swapchain_extent.width + vt_feedback_scale - 1) / vt_feedback_scale;
+
+		vt_feedback_height = (vk_swapchain_extent.height + vt_feedback_scale - 1) / vt_feedback_scale;
+
+		const VkDeviceSize feedback_bytes = static_cast<VkDeviceSize>(vt_feedback_width) * vt_feedback_height * sizeof(uint32_t);
+
+		// Feedback is read back on the CPU every frame, so prefer cached memory when there is some
+		uint32_t unused_type_idx;
+
+		VkMemoryPropertyFlags feedback_mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		if (!query_memory_type_index(~0u, feedback_mem_flags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, unused_type_idx))
+			feedback_mem_flags |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+		vt_feedback_buffers.resize(vk_swapchain_images.size());
+		vt_feedback_buffers_memory.resize(vk_swapchain_images.size());
+
+		for (size_t i = 0; i != vk_swapchain_images.size(); ++i)
+		{
+			check(allocate_buffer(feedback_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, feedback_mem_flags, vt_feedback_buffers[i], vt_feedback_buffers_memory[i]));
+
+			void* feedback_data;
+
+			check(vkMapMemory(vk_device, vt_feedback_buffers_memory[i], 0, feedback_bytes, 0, &feedback_data));
+
+			memset(feedback_data, 0, feedback_bytes);
+
+			vkUnmapMemory(vk_device, vt_feedback_buffers_memory[i]);
+		}
+
+		return {};
+	}
+
+	err_info stream_vt_pages(uint32_t image_idx)
+	{
+		++vt_frame_idx;
+
+		vt_has_uploads = false;
+
+		const VkDeviceSize feedback_bytes = static_cast<VkDeviceSize>(vt_feedback_width) * vt_feedback_height * sizeof(uint32_t);
+
+		uint32_t* feedback;
+
+		check(vkMapMemory(vk_device, vt_feedback_buffers_memory[image_idx], 0, feedback_bytes, 0, reinterpret_cast<void**>(&feedback)));
+
+		std::vector<uint32_t> requests;
+
+		for (uint32_t i = 0; i != vt_feedback_width * vt_feedback_height; ++i)
+			if (feedback[i] & 0x8000'0000)
+			{
+				const uint32_t level = (feedback[i] >> 24) & 0x7F;
+
+				// The page table is padded to powers of two, so requests past the texture's edge are dropped here
+				if (level < vt_header.level_cnt && (feedback[i] & 0xFFF) < vt_header.pages_x(level) && ((feedback[i] >> 12) & 0xFFF) < vt_header.pages_y(level))
+					requests.push_back(feedback[i] & 0x7FFF'FFFF);
+			}
+
+		memset(feedback, 0, feedback_bytes);
+
+		vkUnmapMemory(vk_device, vt_feedback_buffers_memory[image_idx]);
+
+		std::sort(requests.begin(), requests.end());
+
+		requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+		std::vector<uint32_t> missing;
+
+		for (const uint32_t key : requests)
+			if (auto it = vt_resident_pages.find(key); it != vt_resident_pages.end())
+			{
+				if (vt_tile_last_use[it->second] != UINT64_MAX)
+					vt_tile_last_use[it->second] = vt_frame_idx;
+			}
+			else
+				missing.push_back(key);
+
+		// Tiles are only taken while there are atlas tiles this frame does not use; the rest wait for a later frame
+		uint32_t free_tile_cnt = 0;
+
+		for (const uint64_t last_use : vt_tile_last_use)
+			if (last_use < vt_frame_idx)
+				++free_tile_cnt;
+
+		std::vector<vt_loaded_tile> loaded;
+
+		bool has_failed;
+
+		{
+			std::lock_guard lock(vt_stream_mutex);
+
+			has_failed = vt_stream_failed;
+
+			const size_t take_cnt = std::min<size_t>({ vt_stream_loaded.size(), vt_max_uploads_per_frame, free_tile_cnt });
+
+			loaded.assign(std::make_move_iterator(vt_stream_loaded.begin()), std::make_move_iterator(vt_stream_loaded.begin() + take_cnt));
+
+			vt_stream_loaded.erase(vt_stream_loaded.begin(), vt_stream_loaded.begin() + take_cnt);
+
+			// Replaces whatever was still queued, as only this frame's feedback matters. Pages already read or being read are skipped.
+			vt_stream_requests.clear();
+
+			for (const uint32_t key : missing)
+			{
+				const auto has_key = [key](const vt_loaded_tile& tile) { return tile.key == key; };
+
+				if (key != vt_stream_reading_key && std::none_of(loaded.begin(), loaded.end(), has_key) && std::none_of(vt_stream_loaded.begin(), vt_stream_loaded.end(), has_key))
+					vt_stream_requests.push_back(key);
+			}
+		}
+
+		vt_stream_cv.notify_one();
+
+		if (has_failed)
+			return ERROR(1);
+
+		if (loaded.empty())
+			return {};
+
+		uint8_t* staging_data;
+
+		check(vkMapMemory(vk_device, vt_staging_bufs_memory[curr_frame], 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&staging_data)));
+
+		std::vector<VkBufferImageCopy> tile_copies;
+
+		for (const vt_loaded_tile& tile : loaded)
+		{
+			const uint32_t key = tile.key;
+
+			uint32_t tile_idx = 0;
+
+			for (uint32_t i = 1; i != vt_tile_last_use.size(); ++i)
+				if (vt_tile_last_use[i] < vt_tile_last_use[tile_idx])
+					tile_idx = i;
+
+			if (vt_tile_pages[tile_idx] != ~0u)
+				vt_resident_pages.erase(vt_tile_pages[tile_idx]);
+
+			const VkDeviceSize staging_offset = tile_copies.size() * vt_header.tile_bytes();
+
+			memcpy(staging_data + staging_offset, tile.texels.data(), vt_header.tile_bytes());
+
+			vt_tile_pages[tile_idx] = key;
+
+			vt_tile_last_use[tile_idx] = vt_frame_idx;
+
+			vt_resident_pages[key] = tile_idx;
+
+			VkBufferImageCopy copy_region{};
+			copy_region.bufferOffset = staging_offset;
+			copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_region.imageSubresource.mipLevel = 0;
+			copy_region.imageSubresource.baseArrayLayer = 0;
+			copy_region.imageSubresource.layerCount = 1;
+			copy_region.imageOffset = { static_cast<int32_t>((tile_idx % vt_atlas_tiles) * vt_header.tile_dim()), static_cast<int32_t>((tile_idx / vt_atlas_tiles) * vt_header.tile_dim()), 0 };
+			copy_region.imageExtent = { vt_header.tile_dim(), vt_header.tile_dim(), 1 };
+
+			tile_copies.push_back(copy_region);
+		}
+
+		rebuild_vt_page_table(staging_data + vt_max_uploads_per_frame * vt_header.tile_bytes());
+
+		vkUnmapMemory(vk_device, vt_staging_bufs_memory[curr_frame]);
+
+		VkCommandBuffer cmd_buffer = vt_upload_command_buffers[curr_frame];
+
+		VkCommandBufferBeginInfo beg_info{};
+		beg_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beg_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		check(vkBeginCommandBuffer(cmd_buffer, &beg_info));
+
+		record_gpu_scope_beg(cmd_buffer, image_idx, gpu_scope_vt_upload);
+
+		record_vt_uploads(cmd_buffer, vt_staging_bufs[curr_frame], static_cast<uint32_t>(tile_copies.size()), tile_copies.data());
+
+		record_gpu_scope_end(cmd_buffer, image_idx, gpu_scope_vt_upload);
+
+		check(vkEndCommandBuffer(cmd_buffer));
+
+		vt_has_uploads = true;
+
+		return {};
+	}
+
+	// The atlas only gets some of its tiles replaced, so it keeps its contents
+	void record_vt_uploads(VkCommandBuffer cmd_buffer, VkBuffer staging_buf, uint32_t tile_cnt, const VkBufferImageCopy* tile_copies = nullptr)
+	{
+		resource_states.access_image(vt_atlas_image, och::access_transfer_dst);
+
+		resource_states.access_image(vt_page_table_image, och::access_transfer_dst);
+
+		resource_states.flush(cmd_buffer);
+
+		if (tile_copies)
+			vkCmdCopyBufferToImage(cmd_buffer, staging_buf, vt_atlas_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, tile_cnt, tile_copies);
+		else
+		{
+			VkBufferImageCopy copy_region{};
+			copy_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copy_region.imageExtent = { vt_header.tile_dim(), vt_header.tile_dim(), 1 };
+
+			vkCmdCopyBufferToImage(cmd_buffer, staging_buf, vt_atlas_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+		}
+
+		const VkDeviceSize page_table_offset = (tile_copies ? vt_max_uploads_per_frame : tile_cnt) * vt_header.tile_bytes();
+
+		for (uint32_t level = 0; level != vt_header.level_cnt; ++level)
+		{
+			VkBufferImageCopy copy_region{};
+			copy_region.bufferOffset = page_table_offset + vt_page_table_offsets[level] * sizeof(uint32_t);
+			copy_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			copy_region.imageExtent = { mip_extent(vt_page_table_width, level), mip_extent(vt_page_table_height, level), 1 };
+
+			vkCmdCopyBufferToImage(cmd_buffer, staging_buf, vt_page_table_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+		}
+
+		resource_states.access_image(vt_atlas_image, och::access_fragment_sampled);
+
+		resource_states.access_image(vt_page_table_image, och::access_fragment_sampled);
+
+		resource_states.flush(cmd_buffer);
+	}
+
+	// Fills the CPU page table coarsest level first. Pages without a resident tile inherit their parent's entry,
+	// so lookups always resolve to the finest resident ancestor.
+	void rebuild_vt_page_table(uint8_t* out_staging)
+	{
+		for (uint32_t level = vt_header.level_cnt; level-- != 0;)
+		{
+			const uint32_t level_w = mip_extent(vt_page_table_width, level);
+			const uint32_t level_h = mip_extent(vt_page_table_height, level);
+
+			for (uint32_t y = 0; y != level_h; ++y)
+				for (uint32_t x = 0; x != level_w; ++x)
+				{
+					uint32_t entry;
+
+					if (auto it = vt_resident_pages.find(vt_page_key(level, x, y)); it != vt_resident_pages.end())
+						entry = (it->second % vt_atlas_tiles) | ((it->second / vt_atlas_tiles) << 8) | (level << 16);
+					else if (level + 1 == vt_header.level_cnt)
+						entry = (vt_header.level_cnt - 1) << 16;
+					else
+						entry = vt_page_table[vt_page_table_offsets[level + 1] + (y >> 1) * mip_extent(vt_page_table_width, level + 1) + (x >> 1)];
+
+					vt_page_table[vt_page_table_offsets[level] + y * level_w + x] = entry;
+				}
+		}
+
+		memcpy(out_staging, vt_page_table.data(), vt_page_table.size() * sizeof(uint32_t));
+	}
+
+	// Reads the requested pages one at a time, coarsest first, and leaves them for stream_vt_pages to upload.
+	// Stops reading while a frame's worth of tiles is waiting, so pages it no longer requests are not read.
+	void vt_stream_worker()
+	{
+		och::trace_set_thread_name("vt stream");
+
+		std::unique_lock lock(vt_stream_mutex);
+
+		while (true)
+		{
+			vt_stream_cv.wait(lock, [this]() { return vt_stream_stop || (!vt_stream_requests.empty() && vt_stream_loaded.size() < vt_max_uploads_per_frame); });
+
+			if (vt_stream_stop)
+				return;
+
+			vt_loaded_tile tile{ vt_stream_requests.back(), std::vector<uint8_t>(vt_header.tile_bytes()) };
+
+			vt_stream_requests.pop_back();
+
+			vt_stream_reading_key = tile.key;
+
+			lock.unlock();
+
+			const bool has_failed = static_cast<bool>(read_vt_tile(tile.key >> 24, tile.key & 0xFFF, (tile.key >> 12) & 0xFFF, tile.texels.data()));
+
+			lock.lock();
+
+			vt_stream_reading_key = ~0u;
+
+			if (has_failed)
+			{
+				vt_stream_failed = true;
+
+				return;
+			}
+
+			vt_stream_loaded.push_back(std::move(tile));
+		}
+	}
+
+	void stop_vt_stream()
+	{
+		{
+			std::lock_guard lock(vt_stream_mutex);
+
+			vt_stream_stop = true;
+		}
+
+		vt_stream_cv.notify_one();
+
+		if (vt_stream_thread.joinable())
+			vt_stream_thread.join();
+	}
+
+	err_info read_vt_tile(uint32_t level, uint32_t page_x, uint32_t page_y, uint8_t* out_texels)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		const uint64_t tile_offset = vt_header.tile_offset(level, page_x, page_y);
+
+		if (tile_offset + vt_header.tile_bytes() > vt_file->bytes)
+			return ERROR(1);
+
+		memcpy(out_texels, vt_file->get_data().beg + tile_offset, vt_header.tile_bytes());
+
+		return {};
+	}
+
+	static uint32_t vt_page_key(uint32_t level, uint32_t page_x, uint32_t page_y)
+	{
+		return (level << 24) | (page_y << 12) | page_x;
+	}
+#endif // OCH_VIRTUAL_TEXTURE
+
+	err_info create_vk_texture_sampler()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkPhysicalDeviceProperties dev_props{};
+
+		vkGetPhysicalDeviceProperties(vk_physical_device, &dev_props);
+
+		VkSamplerCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		create_info.magFilter = VK_FILTER_LINEAR;
+		create_info.minFilter = VK_FILTER_LINEAR;
+		create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		create_info.anisotropyEnable = VK_TRUE;
+		create_info.maxAnisotropy = dev_props.limits.maxSamplerAnisotropy;
+		create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		create_info.unnormalizedCoordinates = VK_FALSE;
+		create_info.compareEnable = VK_FALSE;
+		create_info.compareOp = VK_COMPARE_OP_ALWAYS;
+		create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		create_info.mipLodBias = 0.0F;
+		create_info.minLod = 0.0F;
+		create_info.maxLod = VK_LOD_CLAMP_NONE;
+
+		check(vkCreateSampler(vk_device, &create_info, nullptr, &vk_texture_sampler));
+
+		return {};
+	}
+
+	err_info create_vk_scene_textures()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		scene_textures.resize(scene_texture_paths.size());
+
+		queue_family_indices family_indices;
+
+		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
+
+		const uint32_t queue_family_idxs[]{ family_indices.graphics_idx, family_indices.compute_idx };
+
+		// Mips generated on a separate compute family are sampled by graphics without an ownership transfer
+		const VkSharingMode share_mode = family_indices.compute_idx != family_indices.graphics_idx ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+
+		// Everything past the first texture is uploaded in full before the first frame, from what decode_scene_texture left in decoded_textures
+		for (size_t i = 1; i < scene_texture_paths.size(); ++i)
+		{
+			const decoded_texture& decoded = decoded_textures[i];
+
+			const uint32_t width = decoded.width;
+
+			const uint32_t height = decoded.height;
+
+			const uint32_t mip_levels = decoded.mip_levels;
+
+			const std::vector<VkDeviceSize>& mip_offsets = decoded.mip_offsets;
+
+			// Only level 0 is staged if the GPU generates the rest
+			const VkDeviceSize staging_bytes = has_compute_mip_generation ? mip_offsets[1] : mip_offsets[mip_levels];
+
+			VkBuffer staging_buf = nullptr;
+
+			VkDeviceMemory staging_buf_mem = nullptr;
+
+			check(allocate_buffer(staging_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_mem));
+
+			uint8_t* staging_data = nullptr;
+
+			check(vkMapMemory(vk_device, staging_buf_mem, 0, staging_bytes, 0, reinterpret_cast<void**>(&staging_data)));
+
+			memcpy(staging_data, decoded.texels.data(), staging_bytes);
+
+			vkUnmapMemory(vk_device, staging_buf_mem);
+
+			scene_texture& texture = scene_textures[i];
+
+			if (has_compute_mip_generation)
+			{
+				// SRGB formats cannot be stored to, so downsample.comp goes through UNORM views of the same bits and converts itself
+				check(allocate_image(width, height, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory,
+					VK_SAMPLE_COUNT_1_BIT, mip_levels, share_mode, 2, queue_family_idxs, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT));
+
+				resource_states.track_image(texture.image, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+
+				check(submit_mip_generation(texture.image, width, height, mip_levels, staging_buf, staging_buf_mem));
+
+				check(allocate_image_view(texture.image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, texture.view, mip_levels, 0, VK_IMAGE_USAGE_SAMPLED_BIT));
+			}
+			else
+			{
+				check(allocate_image(width, height, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory, VK_SAMPLE_COUNT_1_BIT, mip_levels));
+
+				resource_states.track_image(texture.image, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+
+				VkCommandBuffer cmd_buffer;
+
+				check(beg_single_command(cmd_buffer));
+
+				record_texture_level_upload(cmd_buffer, texture.image, staging_buf, mip_offsets.data(), width, height, 0, mip_levels);
+
+				check(end_single_command(cmd_buffer));
+
+				vkDestroyBuffer(vk_device, staging_buf, nullptr);
+
+				vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+
+				check(allocate_image_view(texture.image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, texture.view, mip_levels));
+			}
+
+#ifdef OCH_BINDLESS
+			uint32_t slot;
+
+			check(register_bindless_texture(texture.view, slot));
+
+			if (slot != i)
+				return ERROR(1);
+#endif // OCH_BINDLESS
+		}
+
+		decoded_textures.clear();
+
+		return {};
+	}
+
+	// Runs as an initialisation task, so it touches nothing but decoded_textures[idx]
+	err_info decode_scene_texture(size_t idx)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		och::mapped_file<bitmap_header> texture_file(scene_texture_paths[idx].c_str(), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+
+		if (!texture_file)
+			return ERROR(1);
+
+		const bitmap_header& header = texture_file[0];
+
+		if (header.bits_per_pixel != 24 && header.bits_per_pixel != 32)
+			return ERROR(1);
+
+		decoded_texture& decoded = decoded_textures[idx];
+
+		decoded.width = static_cast<uint32_t>(header.width);
+
+		decoded.height = static_cast<uint32_t>(header.height);
+
+		decoded.mip_levels = mip_level_cnt(decoded.width, decoded.height);
+
+		compute_mip_offsets(decoded.width, decoded.height, decoded.mip_levels, decoded.mip_offsets);
+
+		decoded.texels.resize(decoded.mip_offsets[decoded.mip_levels] / sizeof(uint32_t));
+
+		sample_bitmap_sparse(header, 0, decoded.texels.data());
+
+		return {};
+	}
+
+	// Fills in the mip chain of a decoded texture, for devices without compute mip generation
+	void downsample_scene_texture(size_t idx)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		decoded_texture& decoded = decoded_textures[idx];
+
+		for (uint32_t i = 0; i + 1 < decoded.mip_levels; ++i)
+			downsample_texels(decoded.texels.data() + decoded.mip_offsets[i] / sizeof(uint32_t), mip_extent(decoded.width, i), mip_extent(decoded.height, i), decoded.texels.data() + decoded.mip_offsets[i + 1] / sizeof(uint32_t));
+	}
+
+	err_info load_obj_model(const char* filename, std::vector<vertex>& out_vertices, std::vector<uint32_t>& out_indices)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename))
+		{
+			och::print("Failed to load .obj File:\n\tWarning: {}\n\tError: {}\n", warn.c_str(), err.c_str());
+
+			return ERROR(1);
+		}
+
+		std::unordered_map<vertex, uint32_t> uniqueVertices{};
+
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				vertex vert{};
+
+				vert.pos = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2],
+				};
+
+				vert.tex_pos = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1],
+				};
+
+				vert.col = { 1.0f, 1.0f, 1.0f };
+
+				if (uniqueVertices.count(vert) == 0)
+				{
+					uniqueVertices[vert] = static_cast<uint32_t>(out_vertices.size());
+
+					out_vertices.push_back(vert);
+				}
+				
+				out_indices.push_back(uniqueVertices[vert]);
+			}
+		}
+
+		och::print("{}:\n\tTotal number of vertices loaded: {}\n\tTotal number of indices loaded: {}\n\n", filename, out_vertices.size(), out_indices.size());
+
+		return {};
+	}
+
+	err_info create_vk_scene_geometry()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkDeviceSize vertex_bytes = 0, index_bytes = 0;
+
+		for (const decoded_mesh& decoded : decoded_meshes)
+		{
+			vertex_bytes += decoded.vertices.size() * sizeof(vertex);
+
+			index_bytes += decoded.indices.size() * sizeof(uint32_t);
+		}
+
+		// All meshes share one staging buffer, vertices first, and one submission
+		VkBuffer staging_buf = nullptr;
+
+		VkDeviceMemory staging_buf_mem = nullptr;
+
+		check(allocate_buffer(vertex_bytes + index_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_mem));
+
+		uint8_t* staging_data = nullptr;
+
+		check(vkMapMemory(vk_device, staging_buf_mem, 0, vertex_bytes + index_bytes, 0, reinterpret_cast<void**>(&staging_data)));
+
+		VkDeviceSize vertex_bytes_offset = 0, index_bytes_offset = 0;
+
+		for (size_t i = 0; i != scene_meshes.size(); ++i)
+		{
+			scene_mesh& mesh = scene_meshes[i];
+
+			const std::vector<vertex>& mesh_vertices = decoded_meshes[i].vertices;
+
+			const std::vector<uint32_t>& mesh_indices = decoded_meshes[i].indices;
+
+			memcpy(staging_data + vertex_bytes_offset, mesh_vertices.data(), mesh_vertices.size() * sizeof(vertex));
+
+			memcpy(staging_data + vertex_bytes + index_bytes_offset, mesh_indices.data(), mesh_indices.size() * sizeof(uint32_t));
+
+			mesh.vertex_offset = static_cast<int32_t>((vk_vertex_mega_buffer.used + vertex_bytes_offset) / sizeof(vertex));
+
+			mesh.first_index = static_cast<uint32_t>((vk_index_mega_buffer.used + index_bytes_offset) / sizeof(uint32_t));
+
+			mesh.index_cnt = static_cast<uint32_t>(mesh_indices.size());
+
+			vertex_bytes_offset += mesh_vertices.size() * sizeof(vertex);
+
+			index_bytes_offset += mesh_indices.size() * sizeof(uint32_t);
+		}
+
+		vkUnmapMemory(vk_device, staging_buf_mem);
+
+		mega_buffer replaced_vertex_buffer, replaced_index_buffer;
+
+		VkCommandBuffer cmd_buffer;
+
+		check(beg_single_command(cmd_buffer));
+
+		check(append_to_mega_buffer(cmd_buffer, vk_vertex_mega_buffer, staging_buf, 0, vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, replaced_vertex_buffer));
+
+		check(append_to_mega_buffer(cmd_buffer, vk_index_mega_buffer, staging_buf, vertex_bytes, index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, replaced_index_buffer));
+
+		check(end_single_command(cmd_buffer));
+
+		vkDestroyBuffer(vk_device, staging_buf, nullptr);
+
+		vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+
+		vkDestroyBuffer(vk_device, replaced_vertex_buffer.buffer, nullptr);
+
+		vkFreeMemory(vk_device, replaced_vertex_buffer.memory, nullptr);
+
+		vkDestroyBuffer(vk_device, replaced_index_buffer.buffer, nullptr);
+
+		vkFreeMemory(vk_device, replaced_index_buffer.memory, nullptr);
+
+		// Already recorded command buffers still bind the replaced buffers
+		if (replaced_vertex_buffer.buffer || replaced_index_buffer.buffer)
+			for (size_t i = 0; i != vk_command_buffers.size(); ++i)
+				check(record_vk_command_buffer(i));
+
+		decoded_meshes.clear();
+
+		return {};
+	}
+
+	// Runs as an initialisation task, so it touches nothing but decoded_meshes[idx]
+	err_info load_scene_mesh(size_t idx)
+	{
+		decoded_mesh& decoded = decoded_meshes[idx];
+
+		check(load_obj_model(scene_meshes[idx].model_path.c_str(), decoded.vertices, decoded.indices));
+
+		normalize_model(decoded.vertices, scene_meshes[idx].offset, scene_meshes[idx].scale);
+
+		return {};
+	}
+
+	// Records copying bytes at src_offset in src to the end of buf, first moving buf's contents to a larger buffer if they would not fit.
+	// The buffer that was moved from is returned in out_replaced, to be released once cmd_buffer has completed.
+	err_info append_to_mega_buffer(VkCommandBuffer cmd_buffer, mega_buffer& buf, VkBuffer src, VkDeviceSize src_offset, VkDeviceSize bytes, VkBufferUsageFlags usage_flags, mega_buffer& out_replaced)
+	{
+		if (!bytes)
+			return {};
+
+		if (buf.used + bytes > buf.capacity)
+		{
+			VkDeviceSize new_capacity = buf.capacity ? buf.capacity : mega_buffer_min_bytes;
+
+			while (new_capacity < buf.used + bytes)
+				new_capacity *= 2;
+
+			VkBuffer new_buffer = nullptr;
+
+			VkDeviceMemory new_memory = nullptr;
+
+			check(allocate_buffer(new_capacity, usage_flags | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, new_buffer, new_memory));
+
+			// Writes a disjoint range of new_buffer from the append below, so the two copies need no barrier in between
+			if (buf.used)
+			{
+				VkBufferCopy copy_region{};
+				copy_region.size = buf.used;
+
+				vkCmdCopyBuffer(cmd_buffer, buf.buffer, new_buffer, 1, &copy_region);
+			}
+
+			out_replaced = buf;
+
+			buf.buffer = new_buffer;
+
+			buf.memory = new_memory;
+
+			buf.capacity = new_capacity;
+		}
+
+		VkBufferCopy copy_region{};
+		copy_region.size = bytes;
+		copy_region.dstOffset = buf.used;
+		copy_region.srcOffset = src_offset;
+
+		vkCmdCopyBuffer(cmd_buffer, src, buf.buffer, 1, &copy_region);
+
+		buf.used += bytes;
+
+		return {};
+	}
+
+#ifdef OCH_BINDLESS
+	err_info create_vk_indirect_buffer()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		// gl_InstanceIndex selects the texture, so instances are separate draw commands
+		vk_draw_commands.resize(scene_meshes.size() * instance_cnt);
+
+		for (size_t i = 0; i != vk_draw_commands.size(); ++i)
+		{
+			const scene_mesh& mesh = scene_meshes[i / instance_cnt];
+
+			vk_draw_commands[i].indexCount = mesh.index_cnt;
+			vk_draw_commands[i].instanceCount = 1;
+			vk_draw_commands[i].firstIndex = mesh.first_index;
+			vk_draw_commands[i].vertexOffset = mesh.vertex_offset;
+			vk_draw_commands[i].firstInstance = mesh.texture_idx;
+		}
+
+		const VkDeviceSize draw_bytes = vk_draw_commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+		VkBuffer staging_buf = nullptr;
+
+		VkDeviceMemory staging_buf_mem = nullptr;
+
+		check(allocate_buffer(draw_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, staging_buf, staging_buf_mem));
+
+		void* data = nullptr;
+
+		check(vkMapMemory(vk_device, staging_buf_mem, 0, draw_bytes, 0, &data));
+
+		memcpy(data, vk_draw_commands.data(), draw_bytes);
+
+		vkUnmapMemory(vk_device, staging_buf_mem);
+
+		check(allocate_buffer(draw_bytes, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_indirect_buffer, vk_indirect_buffer_memory));
+
+		check(copy_buffer_to_buffer(vk_indirect_buffer, staging_buf, draw_bytes));
+
+		vkDestroyBuffer(vk_device, staging_buf, nullptr);
+
+		vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+
+		return {};
+	}
+
+	err_info register_bindless_texture(VkImageView view, uint32_t& out_slot)
+	{
+		if (bindless_texture_views.size() >= bindless_texture_capacity)
+			return ERROR(1);
+
+		out_slot = static_cast<uint32_t>(bindless_texture_views.size());
+
+		bindless_texture_views.push_back(view);
+
+		for (size_t i = 0; i != vk_descriptor_sets_stale.size(); ++i)
+			vk_descriptor_sets_stale[i] = true;
+
+		return {};
+	}
+#endif // OCH_BINDLESS
+
+	err_info create_vk_uniform_buffers()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_uniform_buffers.resize(vk_swapchain_images.size());
+		vk_uniform_buffers_memory.resize(vk_swapchain_images.size());
+
+		for (size_t i = 0; i != vk_swapchain_images.size(); ++i)
+			check(allocate_buffer(sizeof(uniform_buffer_obj), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk_uniform_buffers[i], vk_uniform_buffers_memory[i]));
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		check(create_vt_feedback_buffers());
+#endif // OCH_VIRTUAL_TEXTURE
+
+		return {};
+	}
+
+	err_info create_vk_descriptor_pool()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		VkDescriptorPoolSize pool_sizes[]{
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(vk_swapchain_images.size())},
+#ifdef OCH_VIRTUAL_TEXTURE
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(vk_swapchain_images.size() * 2)},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(vk_swapchain_images.size())},
+#elif defined(OCH_BINDLESS)
+			{VK_DESCRIPTOR_TYPE_SAMPLER, static_cast<uint32_t>(vk_swapchain_images.size())},
+			{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, static_cast<uint32_t>(vk_swapchain_images.size() * bindless_texture_capacity)},
+#else
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(vk_swapchain_images.size() * descriptor_texture_cnt())},
+#endif // OCH_VIRTUAL_TEXTURE
+		};
+
+		VkDescriptorPoolCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		create_info.poolSizeCount = static_cast<uint32_t>(sizeof(pool_sizes) / sizeof(*pool_sizes));
+		create_info.pPoolSizes = pool_sizes;
+		create_info.maxSets = static_cast<uint32_t>(vk_swapchain_images.size() * descriptor_texture_cnt());
+#ifdef OCH_BINDLESS
+		create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+#endif // OCH_BINDLESS
+
+		check(vkCreateDescriptorPool(vk_device, &create_info, nullptr, &vk_descriptor_pool));
+
+		return {};
+	}
+
+	err_info create_vk_descriptor_sets()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		std::vector<VkDescriptorSetLayout> desc_set_layouts(vk_swapchain_images.size() * descriptor_texture_cnt(), vk_descriptor_set_layout);
+
+		VkDescriptorSetAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = vk_descriptor_pool;
+		alloc_info.descriptorSetCount = static_cast<uint32_t>(desc_set_layouts.size());
+		alloc_info.pSetLayouts = desc_set_layouts.data();
+
+		vk_descriptor_sets.resize(desc_set_layouts.size());
+
+		check(vkAllocateDescriptorSets(vk_device, &alloc_info, vk_descriptor_sets.data()));
+
+		vk_descriptor_sets_stale.assign(vk_swapchain_images.size(), false);
+
+#ifdef OCH_BINDLESS
+		bindless_written_views.assign(vk_descriptor_sets.size(), {});
+#endif // OCH_BINDLESS
+
+		for (size_t i = 0; i != vk_descriptor_sets.size(); ++i)
+			write_vk_descriptor_set(i);
+
+		return{};
+	}
+
+	// Without descriptor indexing every texture needs its own set; the other modes get by with one set per image.
+	uint32_t descriptor_texture_cnt() const
+	{
+#if defined(OCH_VIRTUAL_TEXTURE) || defined(OCH_BINDLESS)
+		return 1;
+#else
+		return static_cast<uint32_t>(scene_texture_paths.size());
+#endif // OCH_VIRTUAL_TEXTURE || OCH_BINDLESS
+	}
+
+	size_t descriptor_set_idx(size_t image_idx, uint32_t texture_idx) const
+	{
+		return image_idx * descriptor_texture_cnt() + texture_idx % descriptor_texture_cnt();
+	}
+
+	void write_vk_descriptor_set(size_t set_idx)
+	{
+		const size_t image_idx = set_idx / descriptor_texture_cnt();
+
+		VkDescriptorBufferInfo buf_info{};
+		buf_info.buffer = vk_uniform_buffers[image_idx];
+		buf_info.offset = 0;
+		buf_info.range = sizeof(uniform_buffer_obj);
+
+		VkDescriptorImageInfo img_info{};
+		img_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+#ifdef OCH_VIRTUAL_TEXTURE
+		img_info.imageView = vt_atlas_image_view;
+		img_info.sampler = vt_atlas_sampler;
+#else
+		const size_t texture_idx = set_idx % descriptor_texture_cnt();
+
+		img_info.imageView = texture_idx == 0 ? vk_texture_image_view : scene_textures[texture_idx].view;
+		img_info.sampler = vk_texture_sampler;
+#endif // OCH_VIRTUAL_TEXTURE
+
+		VkWriteDescriptorSet ubo_write{};
+		ubo_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		ubo_write.dstSet = vk_descriptor_sets[set_idx];
+		ubo_write.dstBinding = 0;
+		ubo_write.dstArrayElement = 0;
+		ubo_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		ubo_write.descriptorCount = 1;
+		ubo_write.pBufferInfo = &buf_info;
+		ubo_write.pImageInfo = nullptr;
+		ubo_write.pTexelBufferView = nullptr;
+
+		VkWriteDescriptorSet sampler_write{};
+		sampler_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		sampler_write.dstSet = vk_descriptor_sets[set_idx];
+		sampler_write.dstBinding = 1;
+		sampler_write.dstArrayElement = 0;
+		sampler_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		sampler_write.descriptorCount = 1;
+		sampler_write.pBufferInfo = nullptr;
+		sampler_write.pImageInfo = &img_info;
+		sampler_write.pTexelBufferView = nullptr;
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		VkDescriptorImageInfo page_table_info{};
+		page_table_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		page_table_info.imageView = vt_page_table_image_view;
+		page_table_info.sampler = vt_page_table_sampler;
+
+		VkDescriptorBufferInfo feedback_info{};
+		feedback_info.buffer = vt_feedback_buffers[image_idx];
+		feedback_info.offset = 0;
+		feedback_info.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet page_table_write = sampler_write;
+		page_table_write.dstBinding = 2;
+		page_table_write.pImageInfo = &page_table_info;
+
+		VkWriteDescriptorSet feedback_write = ubo_write;
+		feedback_write.dstBinding = 3;
+		feedback_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		feedback_write.pBufferInfo = &feedback_info;
+
+		VkWriteDescriptorSet writes[]{ ubo_write, sampler_write, page_table_write, feedback_write };
+#elif defined(OCH_BINDLESS)
+		sampler_write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+
+		std::vector<VkDescriptorImageInfo> texture_infos(bindless_texture_views.size());
+
+		for (size_t i = 0; i != texture_infos.size(); ++i)
+		{
+			texture_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			texture_infos[i].imageView = bindless_texture_views[i];
+			texture_infos[i].sampler = nullptr;
+		}
+
+		VkWriteDescriptorSet texture_array_write = sampler_write;
+		texture_array_write.dstBinding = 2;
+		texture_array_write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		texture_array_write.descriptorCount = static_cast<uint32_t>(texture_infos.size());
+		texture_array_write.pImageInfo = texture_infos.data();
+
+		bindless_written_views[set_idx] = bindless_texture_views;
+
+		VkWriteDescriptorSet writes[]{ ubo_write, sampler_write, texture_array_write };
+#else
+		VkWriteDescriptorSet writes[]{ ubo_write, sampler_write };
+#endif // OCH_VIRTUAL_TEXTURE
+
+		vkUpdateDescriptorSets(vk_device, static_cast<uint32_t>(sizeof(writes) / sizeof(*writes)), writes, 0, nullptr);
+	}
+
+#ifdef OCH_BINDLESS
+	// Only binding 2 is update-after-bind, so a stale set rewrites nothing but its changed texture slots.
+	// Writing the other bindings would invalidate the command buffers the set is recorded into.
+	void write_bindless_texture_slots(size_t set_idx)
+	{
+		std::vector<VkImageView>& written = bindless_written_views[set_idx];
+
+		written.resize(bindless_texture_views.size(), nullptr);
+
+		std::vector<VkDescriptorImageInfo> texture_infos;
+
+		std::vector<VkWriteDescriptorSet> writes;
+
+		// Writes point into texture_infos, which must not reallocate
+		texture_infos.reserve(bindless_texture_views.size());
+
+		for (size_t i = 0; i != bindless_texture_views.size(); ++i)
+		{
+			if (written[i] == bindless_texture_views[i])
+				continue;
+
+			texture_infos.push_back({ nullptr, bindless_texture_views[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+
+			VkWriteDescriptorSet texture_write{};
+			texture_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			texture_write.dstSet = vk_descriptor_sets[set_idx];
+			texture_write.dstBinding = 2;
+			texture_write.dstArrayElement = static_cast<uint32_t>(i);
+			texture_write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			texture_write.descriptorCount = 1;
+			texture_write.pImageInfo = &texture_infos.back();
+
+			writes.push_back(texture_write);
+
+			written[i] = bindless_texture_views[i];
+		}
+
+		if (!writes.empty())
+			vkUpdateDescriptorSets(vk_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+#endif // OCH_BINDLESS
+
+	err_info create_vk_command_buffers()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		vk_command_buffers.resize(vk_swapchain_views.size());
+
+		vk_recorded_render_extents.resize(vk_swapchain_views.size());
+
+		vk_command_buffers_stale.assign(vk_swapchain_views.size(), false);
+
+		VkCommandBufferAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = vk_command_pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = static_cast<uint32_t>(vk_command_buffers.size());
+
+		check(vkAllocateCommandBuffers(vk_device, &alloc_info, vk_command_buffers.data()));
+
+		for (size_t i = 0; i != vk_command_buffers.size(); ++i)
+			check(record_vk_command_buffer(i));
+
+		return {};
+	}
+
+	err_info record_vk_command_buffer(size_t buffer_idx)
+	{
+		VkCommandBufferBeginInfo buffer_beg_info{};
+		buffer_beg_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		buffer_beg_info.flags = 0;
+		buffer_beg_info.pInheritanceInfo = nullptr;
+		
+		check(vkBeginCommandBuffer(vk_command_buffers[buffer_idx], &buffer_beg_info));
+
+		och::render_graph graph;
+
+		build_frame_graph(graph, buffer_idx);
+
+		graph.compile();
+
+		graph.set_aliasing(render_target_block_idxs);
+
+		graph.record(vk_command_buffers[buffer_idx]);
+
+		vk_recorded_render_extents[buffer_idx] = vk_render_extent;
+
+		vk_command_buffers_stale[buffer_idx] = false;
+
+		check(vkEndCommandBuffer(vk_command_buffers[buffer_idx]));
+
+		return {};
+	}
+
+	// Declares the frame's passes and what they touch; the graph derives every barrier between them, including the final hand-off to presentation
+	void build_frame_graph(och::render_graph& graph, size_t buffer_idx)
+	{
+		const VkImageLayout output_layout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		const uint32_t output = graph.import_image("swapchain", vk_swapchain_images[buffer_idx], VK_IMAGE_ASPECT_COLOR_BIT, och::rg_acquired);
+
+		graph.set_output(output, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, output_layout, output_layout, false });
+
+		const uint32_t scene_target = has_dynamic_resolution() ? graph.create_transient_image("scene", vk_scene_image, VK_IMAGE_ASPECT_COLOR_BIT, alias_class_device) : output;
+
+		const uint32_t scene_pass = graph.add_pass("scene", [this, buffer_idx](VkCommandBuffer cmd) { record_scene_pass(cmd, buffer_idx); });
+
+		if (vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			const uint32_t colour = graph.create_transient_image("msaa colour", vk_colour_image, VK_IMAGE_ASPECT_COLOR_BIT, alias_class_lazy);
+
+			graph.use(scene_pass, colour, och::rg_colour_attachment(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+		}
+
+		graph.use(scene_pass, scene_target, och::rg_colour_attachment(has_dynamic_resolution() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : output_layout));
+
+		const uint32_t depth = graph.create_transient_image("depth", vk_depth_image, VK_IMAGE_ASPECT_DEPTH_BIT, depth_store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE ? alias_class_lazy : alias_class_device);
+
+		graph.use(scene_pass, depth, och::rg_depth_attachment(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		// Host accesses before the submission are ordered by the submission itself
+		const uint32_t feedback = graph.import_buffer("vt feedback", {});
+
+		graph.use(scene_pass, feedback, och::rg_fragment_shader_write);
+
+		// Read once the frame's timeline value was reached
+		graph.set_output(feedback, och::rg_host_read);
+#endif // OCH_VIRTUAL_TEXTURE
+
+		if (has_dynamic_resolution())
+		{
+			const uint32_t upscale_pass = graph.add_pass("upscale", [this, buffer_idx](VkCommandBuffer cmd) { record_upscale_blit(cmd, vk_swapchain_images[buffer_idx]); });
+
+			graph.use(upscale_pass, scene_target, och::rg_transfer_src);
+
+			graph.use(upscale_pass, output, och::rg_transfer_dst);
+		}
+	}
+
+	void record_scene_pass(VkCommandBuffer cmd, size_t buffer_idx)
+	{
+		record_gpu_scope_beg(cmd, static_cast<uint32_t>(buffer_idx), gpu_scope_render_pass);
+
+		VkClearValue clear_values[]{ {0.0F, 0.0F, 0.0F, 1.0F}, {reversed_z ? 0.0F : 1.0F, 0.0F, 0.0F, 0.0F} };
 
-		VkAttachmentReference color_ref{};
-		color_ref.attachment = 0;
-		color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkRenderPassBeginInfo pass_beg_info{};
+		pass_beg_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		pass_beg_info.renderPass = vk_render_pass;
+		pass_beg_info.framebuffer = vk_swapchain_framebuffers[buffer_idx];
+		pass_beg_info.renderArea.offset = { 0, 0 };
+		pass_beg_info.renderArea.extent = vk_render_extent;
+		pass_beg_info.clearValueCount = static_cast<uint32_t>(sizeof(clear_values) / sizeof(*clear_values));
+		pass_beg_info.pClearValues = clear_values;
 
-		VkAttachmentReference depth_ref{};
-		depth_ref.attachment = 1;
-		depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		vkCmdBeginRenderPass(cmd, &pass_beg_info, VK_SUBPASS_CONTENTS_INLINE);
 
-		VkAttachmentReference color_resolve_ref{};
-		color_resolve_ref.attachment = 2;
-		color_resolve_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			VkViewport viewport{ 0.0F, 0.0F, static_cast<float>(vk_render_extent.width), static_cast<float>(vk_render_extent.height), 0.0F, 1.0F };
 
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &color_ref;
-		subpass.pDepthStencilAttachment = &depth_ref;
-		subpass.pResolveAttachments = &color_resolve_ref;
+			vkCmdSetViewport(cmd, 0, 1, &viewport);
 
-		VkSubpassDependency dependency{};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			VkRect2D scissor{ { 0, 0 }, vk_render_extent };
 
-		VkAttachmentDescription attachment_descs[]{ color_attachment, depth_attachment, color_attachment_resolve };
+			vkCmdSetScissor(cmd, 0, 1, &scissor);
+			
+			VkDeviceSize offsets[]{ 0 };
+			vkCmdBindVertexBuffers(cmd, 0, 1, &vk_vertex_mega_buffer.buffer, offsets);
 
-		VkRenderPassCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		create_info.attachmentCount = static_cast<uint32_t>(sizeof(attachment_descs) / sizeof(*attachment_descs));
-		create_info.pAttachments = attachment_descs;
-		create_info.subpassCount = 1;
-		create_info.pSubpasses = &subpass;
-		create_info.dependencyCount = 1;
-		create_info.pDependencies = &dependency;
+			vkCmdBindIndexBuffer(cmd, vk_index_mega_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+			if (depth_prepass)
+			{
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_depth_prepass_pipeline);
 
-		check(vkCreateRenderPass(vk_device, &create_info, nullptr, &vk_render_pass));
+				record_scene_draws(cmd, buffer_idx);
 
-		return {};
+				vkCmdNextSubpass(cmd, VK_SUBPASS_CONTENTS_INLINE);
+			}
+
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_graphics_pipeline);
+
+			record_scene_draws(cmd, buffer_idx);
+
+		vkCmdEndRenderPass(cmd);
+
+		record_gpu_scope_end(cmd, static_cast<uint32_t>(buffer_idx), gpu_scope_render_pass);
 	}
 
-	err_info create_vk_descriptor_set_layout()
+	// Draws every scene mesh with whichever pipeline is bound. Viewport, scissor, vertex and index buffers are expected to be set.
+	void record_scene_draws(VkCommandBuffer cmd, size_t buffer_idx)
 	{
-		VkDescriptorSetLayoutBinding ubo_layout_binding{};
-		ubo_layout_binding.binding = 0;
-		ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		ubo_layout_binding.descriptorCount = 1;
-		ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		ubo_layout_binding.pImmutableSamplers = nullptr;
+#ifdef OCH_BINDLESS
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets[buffer_idx], 0, nullptr);
 
-		VkDescriptorSetLayoutBinding sampler_layout_binding{};
-		sampler_layout_binding.binding = 1;
-		sampler_layout_binding.descriptorCount = 1;
-		sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-		sampler_layout_binding.pImmutableSamplers = nullptr;
+		// Every draw command carries its texture's slot in firstInstance
+		vkCmdDrawIndexedIndirect(cmd, vk_indirect_buffer, 0, static_cast<uint32_t>(vk_draw_commands.size()), sizeof(VkDrawIndexedIndirectCommand));
+#else
+		size_t bound_set_idx = ~size_t{};
 
-		VkDescriptorSetLayoutBinding bindings[]{ ubo_layout_binding, sampler_layout_binding };
+		for (const scene_mesh& mesh : scene_meshes)
+		{
+			if (const size_t set_idx = descriptor_set_idx(buffer_idx, mesh.texture_idx); set_idx != bound_set_idx)
+			{
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets[set_idx], 0, nullptr);
 
-		VkDescriptorSetLayoutCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		create_info.bindingCount = static_cast<uint32_t>(sizeof(bindings) / sizeof(*bindings));
-		create_info.pBindings = bindings;
+				bound_set_idx = set_idx;
+			}
 
-		check(vkCreateDescriptorSetLayout(vk_device, &create_info, nullptr, &vk_descriptor_set_layout));
+			vkCmdDrawIndexed(cmd, mesh.index_cnt, instance_cnt, mesh.first_index, mesh.vertex_offset, 0);
+		}
+#endif // OCH_BINDLESS
+	}
 
-		return {};
+	// Stretches the rendered part of vk_scene_image over the whole swapchain image. The frame graph provides the layouts.
+	void record_upscale_blit(VkCommandBuffer cmd, VkImage swapchain_image)
+	{
+		VkImageBlit region{};
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.srcOffsets[1] = { static_cast<int32_t>(vk_render_extent.width), static_cast<int32_t>(vk_render_extent.height), 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.dstOffsets[1] = { static_cast<int32_t>(vk_swapchain_extent.width), static_cast<int32_t>(vk_swapchain_extent.height), 1 };
+
+		vkCmdBlitImage(cmd, vk_scene_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, vk_upscale_filter);
 	}
 
-	err_info create_vk_graphics_pipeline()
+	bool has_dynamic_resolution() const
 	{
-		VkShaderModule vert_shader_module;
+		return gpu_frame_budget_ms != 0.0F;
+	}
 
-		check(create_shader_module_from_file("shaders/vert.spv", vert_shader_module));
+	// Rounded down to multiples of 8, so small corrections do not force a re-record of every command buffer
+	VkExtent2D scaled_render_extent() const
+	{
+		if (render_scale >= 1.0F)
+			return vk_swapchain_extent;
 
-		VkShaderModule frag_shader_module;
+		const uint32_t width = static_cast<uint32_t>(vk_swapchain_extent.width * render_scale) & ~7u;
 
-		check(create_shader_module_from_file("shaders/frag.spv", frag_shader_module));
+		const uint32_t height = static_cast<uint32_t>(vk_swapchain_extent.height * render_scale) & ~7u;
 
-		VkPipelineShaderStageCreateInfo shader_info[2]{};
-		shader_info[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shader_info[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shader_info[0].module = vert_shader_module;
-		shader_info[0].pName = "main";
+		return { width ? width : 1, height ? height : 1 };
+	}
 
-		shader_info[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shader_info[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shader_info[1].module = frag_shader_module;
-		shader_info[1].pName = "main";
-		
-		VkPipelineVertexInputStateCreateInfo vert_input_info{};
-		vert_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vert_input_info.vertexBindingDescriptionCount = 1;
-		vert_input_info.pVertexBindingDescriptions = &vertex::binding_desc;
-		vert_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(sizeof(vertex::attribute_descs) / sizeof(*vertex::attribute_descs));
-		vert_input_info.pVertexAttributeDescriptions = vertex::attribute_descs;
+	// Adjusts render_scale towards gpu_frame_budget_ms, given the render pass time averaged over the last render_scale_interval frames
+	void update_render_scale(float avg_gpu_ms)
+	{
+		// Render pass time grows roughly with the pixel count, which is the square of the scale
+		float new_scale = render_scale * sqrtf(gpu_frame_budget_ms / avg_gpu_ms);
 
-		VkPipelineInputAssemblyStateCreateInfo input_asm_info{};
-		input_asm_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		input_asm_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		input_asm_info.primitiveRestartEnable = VK_FALSE;
+		// Drops are taken at once to protect the frame rate, while increases are gradual so a single light frame does not cause oscillation
+		if (new_scale > render_scale * 1.05F)
+			new_scale = fminf(new_scale, render_scale + 0.05F);
+		else if (new_scale > render_scale * 0.95F)
+			return;
 
-		VkViewport viewport{};
-		viewport.x = 0.0F;
-		viewport.y = 0.0F;
-		viewport.width = static_cast<float>(vk_swapchain_extent.width);
-		viewport.height = static_cast<float>(vk_swapchain_extent.height);
-		viewport.minDepth = 0.0F;
-		viewport.maxDepth = 1.0F;
+		render_scale = fminf(fmaxf(new_scale, render_scale_min), 1.0F);
 
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = vk_swapchain_extent;
+		vk_render_extent = scaled_render_extent();
+	}
 
-		VkPipelineViewportStateCreateInfo view_info{};
-		view_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		view_info.viewportCount = 1;
-		view_info.pViewports = &viewport;
-		view_info.scissorCount = 1;
-		view_info.pScissors = &scissor;
+	err_info create_vk_sync_objects()
+	{
+		OCH_ZONE(__FUNCTION__);
 
-		VkPipelineRasterizationStateCreateInfo raster_info{};
-		raster_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		raster_info.depthClampEnable = VK_FALSE;
-		raster_info.rasterizerDiscardEnable = VK_FALSE;
-		raster_info.polygonMode = VK_POLYGON_MODE_FILL;
-		raster_info.lineWidth = 1.0F;
-		raster_info.cullMode = VK_CULL_MODE_BACK_BIT;
-		raster_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		raster_info.depthBiasEnable = VK_FALSE;
-		raster_info.depthBiasConstantFactor = 0.0F;
-		raster_info.depthBiasClamp = 0.0F;
-		raster_info.depthBiasSlopeFactor = 0.0F;
+		vk_image_timeline_values.resize(vk_swapchain_images.size(), 0);
 
-		VkPipelineMultisampleStateCreateInfo multisample_info{};
-		multisample_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisample_info.sampleShadingEnable = VK_FALSE;
-		multisample_info.rasterizationSamples = vk_msaa_samples;
-		multisample_info.minSampleShading = 1.0F;
-		multisample_info.pSampleMask = nullptr;
-		multisample_info.alphaToCoverageEnable = VK_FALSE;
-		multisample_info.alphaToOneEnable = VK_FALSE;
+		VkSemaphoreCreateInfo semaphore_info{};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkPipelineColorBlendAttachmentState blend_attachment{};
-		blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		blend_attachment.blendEnable = VK_FALSE;
-		blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-		blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
-		blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		for (uint32_t i = 0; i != max_frames_in_flight; ++i)
+		{
+			check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_image_available_semaphores[i]));
 
-		VkPipelineColorBlendStateCreateInfo blend_info{};
-		blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blend_info.logicOpEnable = VK_FALSE;
-		blend_info.logicOp = VK_LOGIC_OP_COPY;
-		blend_info.attachmentCount = 1;
-		blend_info.pAttachments = &blend_attachment;
-		blend_info.blendConstants[0] = 0.0F;
-		blend_info.blendConstants[1] = 0.0F;
-		blend_info.blendConstants[2] = 0.0F;
-		blend_info.blendConstants[3] = 0.0F;
+			check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_render_complete_semaphores[i]));
+		}
 
-		VkDynamicState dynamic_states[]{ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_LINE_WIDTH };
-		VkPipelineDynamicStateCreateInfo dynamic_info{};
-		dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamic_info.dynamicStateCount = sizeof(dynamic_states) / sizeof(*dynamic_states);
-		dynamic_info.pDynamicStates = dynamic_states;
+		VkSemaphoreTypeCreateInfo timeline_info{};
+		timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timeline_info.initialValue = 0;
 
-		VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
-		depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depth_stencil_info.depthTestEnable = VK_TRUE;
-		depth_stencil_info.depthWriteEnable = VK_TRUE;
-		depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
-		depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
-		depth_stencil_info.minDepthBounds = 0.0F;
-		depth_stencil_info.maxDepthBounds = 1.0F;
-		depth_stencil_info.stencilTestEnable = VK_FALSE;
-		depth_stencil_info.front = {};
-		depth_stencil_info.back = {};
+		semaphore_info.pNext = &timeline_info;
 
-		VkPipelineLayoutCreateInfo layout_info{};
-		layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		layout_info.setLayoutCount = 1;
-		layout_info.pSetLayouts = &vk_descriptor_set_layout;
-		layout_info.pushConstantRangeCount = 0;
-		layout_info.pPushConstantRanges = nullptr;
+		check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_frame_timeline));
 
-		check(vkCreatePipelineLayout(vk_device, &layout_info, nullptr, &vk_pipeline_layout));
+		return {};
+	}
 
-		VkGraphicsPipelineCreateInfo pipeline_info{};
-		pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipeline_info.stageCount = 2;
-		pipeline_info.pStages = shader_info;
-		pipeline_info.pVertexInputState = &vert_input_info;
-		pipeline_info.pInputAssemblyState = &input_asm_info;
-		pipeline_info.pTessellationState = nullptr;
-		pipeline_info.pViewportState = &view_info;
-		pipeline_info.pRasterizationState = &raster_info;
-		pipeline_info.pMultisampleState = &multisample_info;
-		pipeline_info.pDepthStencilState = &depth_stencil_info;
-		pipeline_info.pColorBlendState = &blend_info;
-		pipeline_info.pDynamicState = nullptr;
-		pipeline_info.layout = vk_pipeline_layout;
-		pipeline_info.renderPass = vk_render_pass;
-		pipeline_info.subpass = 0;
-		pipeline_info.basePipelineHandle = nullptr;
-		pipeline_info.basePipelineIndex = -1;
+	// Blocks until the frame with the given value has completed on the GPU
+	err_info wait_frame_timeline(uint64_t value)
+	{
+		// Nothing can signal a frame that was not submitted yet, but work ahead of it is done once the queue drained
+		if (value > frame_timeline_value)
+		{
+			check(vkQueueWaitIdle(vk_graphics_queue));
 
-		check(vkCreateGraphicsPipelines(vk_device, nullptr, 1, &pipeline_info, nullptr, &vk_graphics_pipeline));
+			return {};
+		}
 
-		vkDestroyShaderModule(vk_device, vert_shader_module, nullptr);
+		VkSemaphoreWaitInfo wait_info{};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &vk_frame_timeline;
+		wait_info.pValues = &value;
 
-		vkDestroyShaderModule(vk_device, frag_shader_module, nullptr);
+		check(vkWaitSemaphores(vk_device, &wait_info, UINT64_MAX));
 
 		return {};
 	}
-	
-	err_info create_vk_command_pool()
+
+	err_info create_vk_timestamp_query_pool()
 	{
+		OCH_ZONE(__FUNCTION__);
+
+		gpu_scope_written_masks.assign(vk_swapchain_images.size() + 1, 0);
+
 		queue_family_indices family_indices;
 
 		check(query_queue_families(vk_physical_device, vk_surface, family_indices));
 
-		VkCommandPoolCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		create_info.queueFamilyIndex = family_indices.graphics_idx;
-		
-		check(vkCreateCommandPool(vk_device, &create_info, nullptr, &vk_command_pool));
+		uint32_t queue_family_cnt;
+
+		vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_cnt, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queue_families(queue_family_cnt);
+
+		vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_cnt, queue_families.data());
+
+		const uint32_t valid_bits = queue_families[family_indices.graphics_idx].timestampValidBits;
+
+		// Profiling is simply skipped on queues without timestamp support
+		if (!valid_bits)
+			return {};
+
+		gpu_timestamp_valid_mask = valid_bits == 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+		VkPhysicalDeviceProperties props;
+
+		vkGetPhysicalDeviceProperties(vk_physical_device, &props);
+
+		gpu_timestamp_period_ms = props.limits.timestampPeriod / 1'000'000.0F;
+
+		VkQueryPoolCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		create_info.queryCount = static_cast<uint32_t>(gpu_scope_written_masks.size()) * gpu_scope_cnt * 2;
+
+		check(vkCreateQueryPool(vk_device, &create_info, nullptr, &vk_timestamp_query_pool));
+
+		check(calibrate_gpu_clock());
+
+		return {};
+	}
+
+	err_info calibrate_gpu_clock()
+	{
+		if (!has_calibrated_timestamps)
+			return {};
+
+		VkCalibratedTimestampInfoEXT infos[2]{};
+		infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+		infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+		infos[1].timeDomain = host_time_domain;
+
+		uint64_t timestamps[2];
+
+		uint64_t max_deviation;
+
+		check(vk_get_calibrated_timestamps(vk_device, 2, infos, timestamps, &max_deviation));
+
+		gpu_calibration_ticks = timestamps[0] & gpu_timestamp_valid_mask;
+
+		gpu_calibration_host_ns = och::trace_host_ticks_to_ns(timestamps[1]);
 
 		return {};
 	}
 
-	err_info create_vk_colour_resources()
+	uint64_t gpu_ticks_to_host_ns(uint64_t ticks) const
+	{
+		const int64_t delta_ticks = static_cast<int64_t>(ticks - gpu_calibration_ticks);
+
+		return gpu_calibration_host_ns + static_cast<int64_t>(delta_ticks * (gpu_timestamp_period_ms * 1'000'000.0));
+	}
+
+	uint32_t texture_stream_gpu_scope_group() const
+	{
+		return static_cast<uint32_t>(vk_swapchain_images.size());
+	}
+
+	void record_gpu_scope_beg(VkCommandBuffer cmd_buffer, uint32_t group, gpu_scope scope)
+	{
+		if (!vk_timestamp_query_pool)
+			return;
+
+		const uint32_t first_query = (group * gpu_scope_cnt + scope) * 2;
+
+		vkCmdResetQueryPool(cmd_buffer, vk_timestamp_query_pool, first_query, 2);
+
+		vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, vk_timestamp_query_pool, first_query);
+	}
+
+	void record_gpu_scope_end(VkCommandBuffer cmd_buffer, uint32_t group, gpu_scope scope)
+	{
+		if (!vk_timestamp_query_pool)
+			return;
+
+		vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk_timestamp_query_pool, (group * gpu_scope_cnt + scope) * 2 + 1);
+	}
+
+	// Must only be called once the group's last submission has completed
+	err_info collect_gpu_timestamps(uint32_t group)
 	{
-		VkFormat colour_format = vk_swapchain_format;
+		if (!vk_timestamp_query_pool)
+			return {};
+
+		for (uint32_t scope = 0; scope != gpu_scope_cnt; ++scope)
+		{
+			if (!(gpu_scope_written_masks[group] & (1 << scope)))
+				continue;
+
+			uint64_t timestamps[2];
+
+			check(vkGetQueryPoolResults(vk_device, vk_timestamp_query_pool, (group * gpu_scope_cnt + scope) * 2, 2, sizeof(timestamps), timestamps, sizeof(*timestamps), VK_QUERY_RESULT_64_BIT));
+
+			const uint64_t ticks = ((timestamps[1] & gpu_timestamp_valid_mask) - (timestamps[0] & gpu_timestamp_valid_mask)) & gpu_timestamp_valid_mask;
+
+			gpu_scope_stats[scope].add(ticks * gpu_timestamp_period_ms);
+
+			if (scope == gpu_scope_render_pass)
+			{
+				msaa_tier_stats[msaa_tier_idx()].add(ticks * gpu_timestamp_period_ms);
 
-		check(allocate_image(vk_swapchain_extent.width, vk_swapchain_extent.height, colour_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_colour_image, vk_colour_image_memory, vk_msaa_samples));
+				if (has_dynamic_resolution())
+				{
+					render_scale_gpu_ms_sum += ticks * gpu_timestamp_period_ms;
+
+					if (++render_scale_sample_cnt == render_scale_interval)
+					{
+						update_render_scale(render_scale_gpu_ms_sum / render_scale_interval);
+
+						render_scale_gpu_ms_sum = 0.0F;
+
+						render_scale_sample_cnt = 0;
+					}
+				}
+			}
+
+			if (has_calibrated_timestamps)
+				och::trace_gpu_zone_emit(gpu_scope_names[scope], gpu_ticks_to_host_ns(timestamps[0] & gpu_timestamp_valid_mask), gpu_ticks_to_host_ns(timestamps[1] & gpu_timestamp_valid_mask));
+		}
 
-		check(allocate_image_view(vk_colour_image, colour_format, VK_IMAGE_ASPECT_COLOR_BIT, vk_colour_image_view));
+		gpu_scope_written_masks[group] = 0;
 
 		return {};
 	}
 
-	err_info create_vk_depth_resources()
+	void print_gpu_profile() const
 	{
-		check(allocate_image(vk_swapchain_extent.width, vk_swapchain_extent.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_depth_image, vk_depth_image_memory, vk_msaa_samples));
+		if (!vk_timestamp_query_pool)
+			return;
 
-		check(allocate_image_view(vk_depth_image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, vk_depth_image_view));
+		och::print("GPU timings over the last {} samples (min / avg / p99 ms):\n", rolling_stats::window);
 
-		check(transition_image_layout(vk_depth_image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+		for (uint32_t scope = 0; scope != gpu_scope_cnt; ++scope)
+		{
+			if (!gpu_scope_stats[scope].sample_cnt)
+				continue;
 
-		return {};
-	}
+			float min, avg, p99;
 
-	err_info create_vk_swapchain_framebuffers()
-	{
-		vk_swapchain_framebuffers.resize(vk_swapchain_views.size());
+			gpu_scope_stats[scope].summarize(min, avg, p99);
 
-		for (size_t i = 0; i != vk_swapchain_views.size(); ++i)
+			och::print("\t{}: {} / {} / {}\n", gpu_scope_names[scope], min, avg, p99);
+		}
+
+		for (uint32_t i = 0; i != msaa_tier_cnt * 2; ++i)
 		{
-			VkImageView attachments[]{ vk_colour_image_view, vk_depth_image_view, vk_swapchain_views[i] };
+			if (!msaa_tier_stats[i].sample_cnt)
+				continue;
 
-			VkFramebufferCreateInfo create_info{};
-			create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			create_info.renderPass = vk_render_pass;
-			create_info.attachmentCount = static_cast<uint32_t>(sizeof(attachments) / sizeof(*attachments));
-			create_info.pAttachments = attachments;
-			create_info.width = vk_swapchain_extent.width;
-			create_info.height = vk_swapchain_extent.height;
-			create_info.layers = 1;
+			float min, avg, p99;
 
-			check(vkCreateFramebuffer(vk_device, &create_info, nullptr, &vk_swapchain_framebuffers[i]));
+			msaa_tier_stats[i].summarize(min, avg, p99);
+
+			och::print("\trender pass at AA {}{}: {} / {} / {}\n", msaa_tier_names[i / 2], i & 1 ? " with sample shading" : "", min, avg, p99);
 		}
 
-		return {};
+		if (has_dynamic_resolution())
+			och::print("\trender scale: {} ({}x{} for a budget of {} ms)\n", render_scale, vk_render_extent.width, vk_render_extent.height, gpu_frame_budget_ms);
+
+		och::print("\n");
 	}
 
-	err_info create_vk_texture_image()
+	err_info main_loop()
 	{
-		och::mapped_file<bitmap_header> texture_file(och::stringview("textures/" OCH_ASSET_NAME ".bmp"), och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
+		if (headless || benchmark)
+			return run_fixed_frames();
 
-		if (!texture_file)
-			return ERROR(1);
+		reset_latency_stats();
 
-		const bitmap_header& header = texture_file[0];
+		start_shader_reload();
 
-		const uint8_t* pixels = header.pixel_data();
+		// The reload thread is joined on failure as well, before its owner starts tearing down
+		const err_info err = run_interactive_frames();
 
-		const size_t pixel_cnt = static_cast<size_t>(header.width * header.height);
+		stop_shader_reload();
 
-		if (header.bits_per_pixel == 24)
-		{
-			uint8_t* with_alpha = new uint8_t[pixel_cnt * 4];
+		return err;
+	}
 
-			for (size_t i = 0; i != pixel_cnt; ++i)
-			{
-				for (size_t j = 0; j != 3; ++j)
-					with_alpha[i * 4 + j] = pixels[i * 3 + j];
+	err_info run_interactive_frames()
+	{
+		while (!glfwWindowShouldClose(window))
+		{
+			check(draw_frame());
 
-				with_alpha[i * 4 + 3] = 0xFF;
-			}
+			glfwPollEvents();
 
-			pixels = with_alpha;
-		}
-		else if (header.bits_per_pixel != 32)
-			return ERROR(1);
+			och::trace_collect();
 
-		VkBuffer staging_buf;
-		VkDeviceMemory staging_buf_mem;
+			check(select_pipeline_variant());
 
-		uint32_t img_sz = static_cast<uint32_t>(header.height > header.width ? header.height : header.width);
+			if (msaa_change_requested)
+			{
+				check(apply_msaa_settings());
 
-		uint32_t mip_levels = 0;
+				msaa_change_requested = false;
+			}
 
-		while (img_sz)
-		{
-			img_sz >>= 1;
-			++mip_levels;
-		}
+			if (next_frames_in_flight || present_mode_change_requested)
+				check(apply_present_policy());
 
-		vk_texture_image_mipmap_levels = mip_levels;
+			if (profile_dump_requested)
+			{
+				print_cpu_profile();
 
-		check(allocate_buffer(pixel_cnt * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_mem));
+				print_gpu_profile();
 
-		void* data;
+				print_latency_profile();
 
-		check(vkMapMemory(vk_device, staging_buf_mem, 0, pixel_cnt * 4, 0, &data));
+				print_attachment_memory_stats();
 
-		memcpy(data, pixels, pixel_cnt * 4);
+				print_barrier_stats();
 
-		vkUnmapMemory(vk_device, staging_buf_mem);
+				print_pipeline_cache_stats();
 
-		if (header.bits_per_pixel == 24)
-			delete[] pixels;
+				profile_dump_requested = false;
+			}
+		}
 
-		check(allocate_image(header.width, header.height, VK_FORMAT_B8G8R8A8_SRGB, 
-			                 VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-			                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_texture_image, vk_texture_image_memory, VK_SAMPLE_COUNT_1_BIT, mip_levels));
+		check(vkDeviceWaitIdle(vk_device));
 
+		print_cpu_profile();
 
-		check(transition_image_layout(vk_texture_image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mip_levels));
+		print_gpu_profile();
 
-		check(copy_buffer_to_image(vk_texture_image, staging_buf, header.width, header.height));
+		print_latency_profile();
 
-		check(generate_mipmap(vk_texture_image, VK_FORMAT_B8G8R8A8_SRGB, header.width, header.height, mip_levels));
+		print_attachment_memory_stats();
 
-		vkDestroyBuffer(vk_device, staging_buf, nullptr);
+		print_barrier_stats();
 
-		vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+		print_pipeline_cache_stats();
 
 		return {};
 	}
 
-	err_info create_vk_texture_image_view()
+	err_info run_fixed_frames()
 	{
-		check(allocate_image_view(vk_texture_image, VK_FORMAT_B8G8R8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, vk_texture_image_view, vk_texture_image_mipmap_levels));
+		for (uint32_t i = 0; i != warmup_frame_cnt; ++i)
+			check(draw_fixed_frame());
 
-		return {};
-	}
+		check(vkDeviceWaitIdle(vk_device));
 
-	err_info create_vk_texture_sampler()
-	{
-		VkPhysicalDeviceProperties dev_props{};
+		check(drain_gpu_timestamps());
 
-		vkGetPhysicalDeviceProperties(vk_physical_device, &dev_props);
+		reset_profile();
 
-		VkSamplerCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		create_info.magFilter = VK_FILTER_LINEAR;
-		create_info.minFilter = VK_FILTER_LINEAR;
-		create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-		create_info.anisotropyEnable = VK_TRUE;
-		create_info.maxAnisotropy = dev_props.limits.maxSamplerAnisotropy;
-		create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-		create_info.unnormalizedCoordinates = VK_FALSE;
-		create_info.compareEnable = VK_FALSE;
-		create_info.compareOp = VK_COMPARE_OP_ALWAYS;
-		create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		create_info.mipLodBias = 0.0F;
-		create_info.minLod = 0.0F;
-		create_info.maxLod = static_cast<float>(vk_texture_image_mipmap_levels);
+		const och::time beg_t = och::time::now();
 
-		check(vkCreateSampler(vk_device, &create_info, nullptr, &vk_texture_sampler));
+		for (uint32_t i = 0; i != headless_frame_cnt; ++i)
+			check(draw_fixed_frame());
 
-		return {};
-	}
+		check(vkDeviceWaitIdle(vk_device));
 
-	err_info load_obj_model()
-	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+		check(drain_gpu_timestamps());
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, "models/" OCH_ASSET_NAME ".obj"))
-		{
-			och::print("Failed to load .obj File:\n\tWarning: {}\n\tError: {}\n", warn.c_str(), err.c_str());
+		const float milliseconds = (och::time::now() - beg_t).microseconds() / 1'000.0F;
 
-			return ERROR(1);
-		}
+		och::print("Rendered {} frames at {}x{} in {} ms ({} ms per frame)\n\n", headless_frame_cnt, vk_swapchain_extent.width, vk_swapchain_extent.height, milliseconds, milliseconds / headless_frame_cnt);
 
-		std::unordered_map<vertex, uint32_t> uniqueVertices{};
+		print_cpu_profile();
 
-		for (const auto& shape : shapes)
-		{
-			for (const auto& index : shape.mesh.indices)
-			{
-				vertex vert{};
+		print_gpu_profile();
 
-				vert.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2],
-				};
+		print_latency_profile();
 
-				vert.tex_pos = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1],
-				};
+		const latency_histogram& frame_histogram = cpu_phase_histograms[cpu_phase_frame];
 
-				vert.col = { 1.0f, 1.0f, 1.0f };
+		benchmark_stats.frame_cnt = headless_frame_cnt;
+		benchmark_stats.wall_ms = milliseconds;
+		benchmark_stats.cpu_frame_p50_us = frame_histogram.percentile(50.0);
+		benchmark_stats.cpu_frame_p95_us = frame_histogram.percentile(95.0);
+		benchmark_stats.cpu_frame_p99_us = frame_histogram.percentile(99.0);
+		benchmark_stats.cpu_frame_max_us = frame_histogram.max_value.load(std::memory_order_relaxed);
 
-				if (uniqueVertices.count(vert) == 0)
-				{
-					uniqueVertices[vert] = static_cast<uint32_t>(vertices.size());
+		if (gpu_scope_stats[gpu_scope_render_pass].sample_cnt)
+			gpu_scope_stats[gpu_scope_render_pass].summarize(benchmark_stats.gpu_frame_min_ms, benchmark_stats.gpu_frame_avg_ms, benchmark_stats.gpu_frame_p99_ms);
 
-					vertices.push_back(vert);
-				}
-				
-				indices.push_back(uniqueVertices[vert]);
-			}
+		if (!headless)
+		{
+			benchmark_stats.present_latency_p50_us = present_latency_histogram.percentile(50.0);
+			benchmark_stats.present_latency_p99_us = present_latency_histogram.percentile(99.0);
 		}
 
-		och::print("\tTotal number of vertices loaded: {}\n\tTotal number of indices loaded: {}\n\n", vertices.size(), indices.size());
+		return {};
+	}
+
+	err_info draw_fixed_frame()
+	{
+		check(draw_frame());
+
+		if (!headless)
+			glfwPollEvents();
 
-		normalize_model(vertices, OCH_ASSET_OFFSET, OCH_ASSET_SCALE);
+		och::trace_collect();
 
 		return {};
 	}
 
-	err_info create_vk_vertex_buffer()
+	// Timestamps of an image's last frame are only read on the image's next use, so this fetches them once the device is idle
+	err_info drain_gpu_timestamps()
 	{
-		VkBuffer staging_buf = nullptr;
-
-		VkDeviceMemory staging_buf_mem = nullptr;
+		for (uint32_t i = 0; vk_timestamp_query_pool && i != vk_swapchain_images.size(); ++i)
+			check(collect_gpu_timestamps(i));
 
-		check(allocate_buffer(vertices.size() * sizeof(vertices[0]), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_mem));
+		return {};
+	}
 
-		void* staging_data = nullptr;
+	void reset_profile()
+	{
+		for (latency_histogram& histogram : cpu_phase_histograms)
+			histogram.reset();
 
-		check(vkMapMemory(vk_device, staging_buf_mem, 0, vertices.size() * sizeof(vertices[0]), 0, &staging_data));
+		for (rolling_stats& stats : gpu_scope_stats)
+			stats = rolling_stats{};
 
-		memcpy(staging_data, vertices.data(), vertices.size() * sizeof(vertices[0]));
+		for (rolling_stats& stats : msaa_tier_stats)
+			stats = rolling_stats{};
 
-		vkUnmapMemory(vk_device, staging_buf_mem);
+		reset_latency_stats();
+	}
 
-		check(allocate_buffer(vertices.size() * sizeof(vertices[0]), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_vertex_buffer, vk_vertex_buffer_memory));
+	void print_cpu_profile() const
+	{
+		och::print("CPU frame phases (p50 / p95 / p99 / max us):\n");
 
-		copy_buffer_to_buffer(vk_vertex_buffer, staging_buf, vertices.size() * sizeof(vertices[0]));
+		for (uint32_t phase = 0; phase != cpu_phase_cnt; ++phase)
+		{
+			const latency_histogram& histogram = cpu_phase_histograms[phase];
 
-		vkDestroyBuffer(vk_device, staging_buf, nullptr);
+			if (!histogram.total_cnt.load(std::memory_order_relaxed))
+				continue;
 
-		vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+			och::print("\t{}: {} / {} / {} / {}\n", cpu_phase_names[phase], histogram.percentile(50.0), histogram.percentile(95.0), histogram.percentile(99.0), histogram.max_value.load(std::memory_order_relaxed));
+		}
 
-		return {};
+		och::print("\n");
 	}
 
-	err_info create_vk_index_buffer()
+	err_info draw_frame()
 	{
-		VkBuffer staging_buf = nullptr;
+		scoped_phase_timer frame_timer(cpu_phase_histograms[cpu_phase_frame], cpu_phase_names[cpu_phase_frame]);
 
-		VkDeviceMemory staging_buf_mem = nullptr;
+		{
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_streaming], cpu_phase_names[cpu_phase_streaming]);
 
-		check(allocate_buffer(indices.size() * sizeof(indices[0]), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, staging_buf, staging_buf_mem));
+			check(update_texture_stream());
 
-		void* data = nullptr;
+			check(retire_mip_gen_jobs());
+		}
 
-		check(vkMapMemory(vk_device, staging_buf_mem, 0, indices.size() * sizeof(indices[0]), 0, &data));
+		{
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_frame_wait], cpu_phase_names[cpu_phase_frame_wait]);
 
-		memcpy(data, indices.data(), indices.size() * sizeof(indices[0]));
+			// The previous user of this frame's semaphores and upload buffers
+			if (frame_timeline_value >= frames_in_flight)
+				check(wait_frame_timeline(frame_timeline_value + 1 - frames_in_flight));
+		}
 
-		vkUnmapMemory(vk_device, staging_buf_mem);
+		uint32_t image_idx;
 
-		check(allocate_buffer(indices.size() * sizeof(indices[0]), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk_index_buffer, vk_index_buffer_memory));
+		{
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_acquire], cpu_phase_names[cpu_phase_acquire]);
 
-		check(copy_buffer_to_buffer(vk_index_buffer, staging_buf, indices.size() * sizeof(indices[0])));
+			if (headless)
+				image_idx = static_cast<uint32_t>(curr_frame);
+			else if (VkResult acquire_rst = vkAcquireNextImageKHR(vk_device, vk_swapchain, UINT64_MAX, vk_image_available_semaphores[curr_frame], nullptr, &image_idx); acquire_rst == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				recreate_swapchain();
+				return {};
+			}
+			else if(acquire_rst != VK_SUBOPTIMAL_KHR)
+				check(acquire_rst);
+		}
 
-		vkDestroyBuffer(vk_device, staging_buf, nullptr);
+		if (vk_image_timeline_values[image_idx])
+		{
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_frame_wait], cpu_phase_names[cpu_phase_frame_wait]);
 
-		vkFreeMemory(vk_device, staging_buf_mem, nullptr);
+			check(wait_frame_timeline(vk_image_timeline_values[image_idx]));
+		}
 
-		return {};
-	}
+		const uint64_t signal_value = frame_timeline_value + 1;
 
-	err_info create_vk_uniform_buffers()
-	{
-		vk_uniform_buffers.resize(vk_swapchain_images.size());
-		vk_uniform_buffers_memory.resize(vk_swapchain_images.size());
+		vk_image_timeline_values[image_idx] = signal_value;
 
-		for (size_t i = 0; i != vk_swapchain_images.size(); ++i)
-			check(allocate_buffer(sizeof(uniform_buffer_obj), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk_uniform_buffers[i], vk_uniform_buffers_memory[i]));
+		// Timestamps from this image's previous frame are complete now, one frame after they were written
+		check(collect_gpu_timestamps(image_idx));
 
-		return {};
-	}
+		// The image's previous submission has retired, so its descriptor set and command buffer may be rewritten.
+		bool needs_record = vk_command_buffers_stale[image_idx] || vk_recorded_render_extents[image_idx].width != vk_render_extent.width || vk_recorded_render_extents[image_idx].height != vk_render_extent.height;
 
-	err_info create_vk_descriptor_pool()
-	{
-		VkDescriptorPoolSize pool_sizes[]{
-			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(vk_swapchain_images.size())},
-			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(vk_swapchain_images.size())},
-		};
+		if (vk_descriptor_sets_stale[image_idx])
+		{
+#ifdef OCH_BINDLESS
+			// Update-after-bind descriptors stay valid in recorded command buffers
+			write_bindless_texture_slots(descriptor_set_idx(image_idx, 0));
+#else
+			for (uint32_t i = 0; i != descriptor_texture_cnt(); ++i)
+				write_vk_descriptor_set(descriptor_set_idx(image_idx, i));
 
-		VkDescriptorPoolCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		create_info.poolSizeCount = static_cast<uint32_t>(sizeof(pool_sizes) / sizeof(*pool_sizes));
-		create_info.pPoolSizes = pool_sizes;
-		create_info.maxSets = static_cast<uint32_t>(vk_swapchain_images.size());
+			// Rewritten descriptors invalidate the command buffers they are recorded into
+			needs_record = true;
+#endif // OCH_BINDLESS
 
-		check(vkCreateDescriptorPool(vk_device, &create_info, nullptr, &vk_descriptor_pool));
+			vk_descriptor_sets_stale[image_idx] = false;
+		}
 
-		return {};
-	}
+		if (needs_record)
+			check(record_vk_command_buffer(image_idx));
 
-	err_info create_vk_descriptor_sets()
-	{
-		std::vector<VkDescriptorSetLayout> desc_set_layouts(vk_swapchain_images.size(), vk_descriptor_set_layout);
+		// Textures whose mips are still being generated on the compute queue are only waited for where they are sampled
+		VkSemaphore wait_semaphores[]{ vk_image_available_semaphores[curr_frame], vk_mip_timeline };
 
-		VkDescriptorSetAllocateInfo alloc_info{};
-		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		alloc_info.descriptorPool = vk_descriptor_pool;
-		alloc_info.descriptorSetCount = static_cast<uint32_t>(desc_set_layouts.size());
-		alloc_info.pSetLayouts = desc_set_layouts.data();
+		VkSemaphore signal_semaphores[]{ vk_frame_timeline, vk_render_complete_semaphores[curr_frame] };
 
-		vk_descriptor_sets.resize(desc_set_layouts.size());
+		// The binary semaphores ignore their values
+		const uint64_t wait_values[]{ 0, mip_timeline_value };
 
-		check(vkAllocateDescriptorSets(vk_device, &alloc_info, vk_descriptor_sets.data()));
+		const uint64_t signal_values[]{ signal_value, 0 };
+
+		VkPipelineStageFlags wait_stages[]{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+
+		const uint32_t wait_semaphore_beg = headless ? 1 : 0;
+
+		const uint32_t wait_semaphore_cnt = (headless ? 0 : 1) + !mip_gen_jobs.empty();
 
-		for (size_t i = 0; i != vk_descriptor_sets.size(); ++i)
 		{
-			VkDescriptorBufferInfo buf_info{};
-			buf_info.buffer = vk_uniform_buffers[i];
-			buf_info.offset = 0;
-			buf_info.range = sizeof(uniform_buffer_obj);
-
-			VkDescriptorImageInfo img_info{};
-			img_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			img_info.imageView = vk_texture_image_view;
-			img_info.sampler = vk_texture_sampler;
-
-			VkWriteDescriptorSet ubo_write{};
-			ubo_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			ubo_write.dstSet = vk_descriptor_sets[i];
-			ubo_write.dstBinding = 0;
-			ubo_write.dstArrayElement = 0;
-			ubo_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			ubo_write.descriptorCount = 1;
-			ubo_write.pBufferInfo = &buf_info;
-			ubo_write.pImageInfo = nullptr;
-			ubo_write.pTexelBufferView = nullptr;
-
-			VkWriteDescriptorSet sampler_write{};
-			sampler_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			sampler_write.dstSet = vk_descriptor_sets[i];
-			sampler_write.dstBinding = 1;
-			sampler_write.dstArrayElement = 0;
-			sampler_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			sampler_write.descriptorCount = 1;
-			sampler_write.pBufferInfo = nullptr;
-			sampler_write.pImageInfo = &img_info;
-			sampler_write.pTexelBufferView = nullptr;
-
-			VkWriteDescriptorSet writes[]{ ubo_write, sampler_write };
-
-			vkUpdateDescriptorSets(vk_device, static_cast<uint32_t>(sizeof(writes) / sizeof(*writes)), writes, 0, nullptr);
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_uniforms], cpu_phase_names[cpu_phase_uniforms]);
+
+			frame_input_t = och::time::now();
+
+			update_uniforms(image_idx);
 		}
 
-		return{};
-	}
+#ifdef OCH_VIRTUAL_TEXTURE
+		{
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_streaming], cpu_phase_names[cpu_phase_streaming]);
 
-	err_info create_vk_command_buffers()
-	{
-		vk_command_buffers.resize(vk_swapchain_views.size());
+			check(stream_vt_pages(image_idx));
+		}
 
-		VkCommandBufferAllocateInfo alloc_info{};
-		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		alloc_info.commandPool = vk_command_pool;
-		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		alloc_info.commandBufferCount = static_cast<uint32_t>(vk_command_buffers.size());
+		// Page uploads go first, so the draw sees the updated atlas and page table
+		VkCommandBuffer submit_command_buffers[]{ vt_upload_command_buffers[curr_frame], vk_command_buffers[image_idx] };
 
-		check(vkAllocateCommandBuffers(vk_device, &alloc_info, vk_command_buffers.data()));
+		const uint32_t submit_command_buffer_cnt = vt_has_uploads ? 2 : 1;
+
+		const VkCommandBuffer* submit_command_buffer_ptr = vt_has_uploads ? submit_command_buffers : submit_command_buffers + 1;
+#else
+		const uint32_t submit_command_buffer_cnt = 1;
+
+		const VkCommandBuffer* submit_command_buffer_ptr = &vk_command_buffers[image_idx];
+#endif // OCH_VIRTUAL_TEXTURE
+
+		VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+		timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_submit_info.waitSemaphoreValueCount = wait_semaphore_cnt;
+		timeline_submit_info.pWaitSemaphoreValues = wait_values + wait_semaphore_beg;
+		timeline_submit_info.signalSemaphoreValueCount = headless ? 1 : 2;
+		timeline_submit_info.pSignalSemaphoreValues = signal_values;
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_submit_info;
+		submit_info.waitSemaphoreCount = wait_semaphore_cnt;
+		submit_info.pWaitSemaphores = wait_semaphores + wait_semaphore_beg;
+		submit_info.pWaitDstStageMask = wait_stages + wait_semaphore_beg;
+		submit_info.commandBufferCount = submit_command_buffer_cnt;
+		submit_info.pCommandBuffers = submit_command_buffer_ptr;
+		submit_info.signalSemaphoreCount = headless ? 1 : 2;
+		submit_info.pSignalSemaphores = signal_semaphores;
 
-		for (size_t i = 0; i != vk_command_buffers.size(); ++i)
 		{
-			VkCommandBufferBeginInfo buffer_beg_info{};
-			buffer_beg_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			buffer_beg_info.flags = 0;
-			buffer_beg_info.pInheritanceInfo = nullptr;
-			
-			check(vkBeginCommandBuffer(vk_command_buffers[i], &buffer_beg_info));
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_submit], cpu_phase_names[cpu_phase_submit]);
 
-			VkClearValue clear_values[]{ {0.0F, 0.0F, 0.0F, 1.0F}, {1.0F, 0.0F, 0.0F, 0.0F} };
+			check(vkQueueSubmit(vk_graphics_queue, 1, &submit_info, nullptr));
+		}
 
-			VkRenderPassBeginInfo pass_beg_info{};
-			pass_beg_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			pass_beg_info.renderPass = vk_render_pass;
-			pass_beg_info.framebuffer = vk_swapchain_framebuffers[i];
-			pass_beg_info.renderArea.offset = { 0, 0 };
-			pass_beg_info.renderArea.extent = vk_swapchain_extent;
-			pass_beg_info.clearValueCount = static_cast<uint32_t>(sizeof(clear_values) / sizeof(*clear_values));
-			pass_beg_info.pClearValues = clear_values;
+		frame_timeline_value = signal_value;
 
-			vkCmdBeginRenderPass(vk_command_buffers[i], &pass_beg_info, VK_SUBPASS_CONTENTS_INLINE);
+		if (vk_timestamp_query_pool)
+		{
+			gpu_scope_written_masks[image_idx] = 1 << gpu_scope_render_pass;
 
-				vkCmdBindPipeline(vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vk_graphics_pipeline);
-				
-				VkDeviceSize offsets[]{ 0 };
-				vkCmdBindVertexBuffers(vk_command_buffers[i], 0, 1, &vk_vertex_buffer, offsets);
+#ifdef OCH_VIRTUAL_TEXTURE
+			if (vt_has_uploads)
+				gpu_scope_written_masks[image_idx] |= 1 << gpu_scope_vt_upload;
+#endif // OCH_VIRTUAL_TEXTURE
 
-				vkCmdBindIndexBuffer(vk_command_buffers[i], vk_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+			// Recalibrating along with the report keeps clock drift out of long traces
+			if (++gpu_profiled_frame_cnt % gpu_profile_report_interval == 0)
+			{
+				print_gpu_profile();
 
-				vkCmdBindDescriptorSets(vk_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline_layout, 0, 1, &vk_descriptor_sets[i], 0, nullptr);
+				check(calibrate_gpu_clock());
+			}
+		}
 
-				vkCmdDrawIndexed(vk_command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		if (headless)
+		{
+			if (startup_report.first_present_ms == 0.0F)
+				finish_startup_report();
 
-			vkCmdEndRenderPass(vk_command_buffers[i]);
+			curr_frame = (curr_frame + 1) % frames_in_flight;
 
-			check(vkEndCommandBuffer(vk_command_buffers[i]));
+			return {};
 		}
 
-		return {};
-	}
+		VkSwapchainKHR present_swapchains[]{ vk_swapchain };
 
-	err_info create_vk_sync_objects()
-	{
-		vk_images_inflight_fences.resize(vk_swapchain_images.size(), nullptr);
+		VkPresentInfoKHR present_info{};
+		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		present_info.waitSemaphoreCount = 1;
+		present_info.pWaitSemaphores = signal_semaphores + 1;
+		present_info.swapchainCount = 1;
+		present_info.pSwapchains = present_swapchains;
+		present_info.pImageIndices = &image_idx;
+		present_info.pResults = nullptr;
 
-		VkSemaphoreCreateInfo semaphore_info{};
-		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+#ifdef OCH_PRESENT_WAIT
+		VkPresentIdKHR present_id_info{};
+		present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		present_id_info.swapchainCount = 1;
+		present_id_info.pPresentIds = &next_present_id;
 
-		VkFenceCreateInfo fence_info{};
-		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		if (has_present_wait)
+			present_info.pNext = &present_id_info;
+#endif // OCH_PRESENT_WAIT
+
+		VkResult present_rst;
 
-		for (uint32_t i = 0; i != max_frames_in_flight; ++i)
 		{
-			check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_image_available_semaphores[i]));
+			scoped_phase_timer timer(cpu_phase_histograms[cpu_phase_present], cpu_phase_names[cpu_phase_present]);
 
-			check(vkCreateSemaphore(vk_device, &semaphore_info, nullptr, &vk_render_complete_semaphores[i]));
+			present_rst = vkQueuePresentKHR(vk_present_queue, &present_info);
+		}
+
+		if (present_rst == VK_SUCCESS || present_rst == VK_SUBOPTIMAL_KHR)
+		{
+			record_present_latency();
+
+			if (startup_report.first_present_ms == 0.0F)
+				finish_startup_report();
+		}
+
+		if (present_rst == VK_ERROR_OUT_OF_DATE_KHR || present_rst == VK_SUBOPTIMAL_KHR || framebuffer_resized)
+		{
+			framebuffer_resized = false;
+			recreate_swapchain();
+		}
+		else
+			check(present_rst);
 
-			check(vkCreateFence(vk_device, &fence_info, nullptr, &vk_inflight_fences[i]));
-		}
+		curr_frame = (curr_frame + 1) % frames_in_flight;
 
 		return {};
 	}
 
-	err_info main_loop()
+	// Without present wait the latency is taken right away. Otherwise presents are polled once per frame so the loop never blocks,
+	// which overestimates the latency by up to a frame.
+	void record_present_latency()
 	{
-		while (!glfwWindowShouldClose(window))
+		++latency_window_frame_cnt;
+
+#ifdef OCH_PRESENT_WAIT
+		if (has_present_wait)
 		{
-			check(draw_frame());
+			pending_presents.push_back({ next_present_id++, frame_input_t });
 
-			glfwPollEvents();
-		}
+			// Waiting for an id returns once it or any later one is displayed, so presents MAILBOX replaced still complete
+			VkResult wait_rst;
 
-		check(vkDeviceWaitIdle(vk_device));
+			while (!pending_presents.empty() && (wait_rst = vk_wait_for_present(vk_device, vk_swapchain, pending_presents.front().id, 0)) != VK_TIMEOUT)
+			{
+				if (wait_rst == VK_SUCCESS)
+					present_latency_histogram.record(static_cast<uint64_t>((och::time::now() - pending_presents.front().input_t).microseconds()));
 
-		return {};
+				pending_presents.erase(pending_presents.begin());
+			}
+
+			return;
+		}
+#endif // OCH_PRESENT_WAIT
+
+		present_latency_histogram.record(static_cast<uint64_t>((och::time::now() - frame_input_t).microseconds()));
 	}
 
-	err_info draw_frame()
+	void reset_latency_stats()
 	{
-		check(vkWaitForFences(vk_device, 1, &vk_inflight_fences[curr_frame], VK_FALSE, UINT64_MAX));
+		present_latency_histogram.reset();
 
-		uint32_t image_idx;
+		latency_window_beg_t = och::time::now();
 
-		if (VkResult acquire_rst = vkAcquireNextImageKHR(vk_device, vk_swapchain, UINT64_MAX, vk_image_available_semaphores[curr_frame], nullptr, &image_idx); acquire_rst == VK_ERROR_OUT_OF_DATE_KHR)
-		{
-			recreate_swapchain();
-			return {};
-		}
-		else if(acquire_rst != VK_SUBOPTIMAL_KHR)
-			check(acquire_rst);
+		latency_window_frame_cnt = 0;
+	}
+
+	void print_latency_profile() const
+	{
+		if (headless || !latency_window_frame_cnt)
+			return;
 
-		if (vk_images_inflight_fences[image_idx])
-			check(vkWaitForFences(vk_device, 1, &vk_images_inflight_fences[image_idx], VK_FALSE, UINT64_MAX));
+		const float seconds = (och::time::now() - latency_window_beg_t).microseconds() / 1'000'000.0F;
 
-		vk_images_inflight_fences[image_idx] = vk_inflight_fences[curr_frame];
+		och::print("Present policy: {}, {} images, {} frames in flight\n", present_mode_name(vk_present_mode), vk_swapchain_images.size(), frames_in_flight);
 
-		VkSemaphore wait_semaphores[]{ vk_image_available_semaphores[curr_frame] };
+		och::print("\t{} frames per second\n", latency_window_frame_cnt / seconds);
 
-		VkSemaphore signal_semaphores[]{ vk_render_complete_semaphores[curr_frame] };
+		och::print("\t{} latency (p50 / p95 / p99 / max us): {} / {} / {} / {}\n\n", has_present_wait ? "input to display" : "input to present call",
+			present_latency_histogram.percentile(50.0), present_latency_histogram.percentile(95.0), present_latency_histogram.percentile(99.0), present_latency_histogram.max_value.load(std::memory_order_relaxed));
+	}
 
-		VkPipelineStageFlags wait_stages[]{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	static const char* present_mode_name(VkPresentModeKHR mode)
+	{
+		for (uint32_t i = 0; i != sizeof(policy_present_modes) / sizeof(*policy_present_modes); ++i)
+			if (policy_present_modes[i] == mode)
+				return och::benchmark_present_mode_names[i];
 
-		update_uniforms(image_idx);
+		return "other";
+	}
 
-		VkSubmitInfo submit_info{};
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = wait_semaphores;
-		submit_info.pWaitDstStageMask = wait_stages;
-		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &vk_command_buffers[image_idx];
-		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = signal_semaphores;
+	// Applies frames in flight and present mode changes requested through the keyboard, reporting on the policy being left first
+	err_info apply_present_policy()
+	{
+		OCH_ZONE(__FUNCTION__);
 
-		check(vkResetFences(vk_device, 1, &vk_inflight_fences[curr_frame]));
+		check(vkDeviceWaitIdle(vk_device));
 
-		check(vkQueueSubmit(vk_graphics_queue, 1, &submit_info, vk_inflight_fences[curr_frame]));
+		print_latency_profile();
 
-		VkSwapchainKHR present_swapchains[]{ vk_swapchain };
+		// All frames have retired, so every binary semaphore is unsignalled again and the timeline covers every slot
+		if (next_frames_in_flight)
+		{
+			frames_in_flight = next_frames_in_flight;
 
-		VkPresentInfoKHR present_info{};
-		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		present_info.waitSemaphoreCount = 1;
-		present_info.pWaitSemaphores = signal_semaphores;
-		present_info.swapchainCount = 1;
-		present_info.pSwapchains = present_swapchains;
-		present_info.pImageIndices = &image_idx;
-		present_info.pResults = nullptr;
+			curr_frame = 0;
+
+			next_frames_in_flight = 0;
+		}
 
-		if (VkResult present_rst = vkQueuePresentKHR(vk_present_queue, &present_info); present_rst == VK_ERROR_OUT_OF_DATE_KHR || present_rst == VK_SUBOPTIMAL_KHR || framebuffer_resized)
+		if (present_mode_change_requested)
 		{
-			framebuffer_resized = false;
-			recreate_swapchain();
+			constexpr uint32_t mode_cnt = sizeof(policy_present_modes) / sizeof(*policy_present_modes);
+
+			uint32_t mode_idx = 0;
+
+			while (mode_idx != mode_cnt && policy_present_modes[mode_idx] != vk_present_mode)
+				++mode_idx;
+
+			preferred_present_mode = policy_present_modes[(mode_idx + 1) % mode_cnt];
+
+			check(recreate_swapchain());
+
+			present_mode_change_requested = false;
 		}
-		else
-			check(present_rst);
 
-		curr_frame = (curr_frame + 1) % max_frames_in_flight;
+		reset_latency_stats();
 
 		return {};
 	}
 
 	err_info recreate_swapchain()
 	{
+		OCH_ZONE(__FUNCTION__);
+
 		cleanup_swapchain();
 
 		check(vkDeviceWaitIdle(vk_device));
 
+		// Present ids belong to the old swapchain
+		pending_presents.clear();
+
 		check(create_vk_swapchain());
 
-		check(create_vk_depth_resources());
+		// The image count may differ from the old swapchain's
+		vk_image_timeline_values.assign(vk_swapchain_images.size(), 0);
 
-		check(create_vk_colour_resources());
+		check(create_vk_render_targets());
 
 		check(get_vk_swapchain_views());
 
 		check(create_vk_render_pass());
 
-		check(create_vk_graphics_pipeline());
+		check(select_pipeline_variant());
 
 		check(create_vk_swapchain_framebuffers());
 
@@ -1529,6 +5376,8 @@ struct hello_vulkan
 
 		check(create_vk_descriptor_sets());
 
+		check(create_vk_timestamp_query_pool());
+
 		check(create_vk_command_buffers());
 
 		return {};
@@ -1536,77 +5385,260 @@ struct hello_vulkan
 
 	void cleanup_swapchain()
 	{
-		int width, height;
-		
-		glfwGetFramebufferSize(window, &width, &height);
-		
-		while (!width || !height)
+		if (!headless && window)
 		{
-			glfwWaitEvents();
+			int width, height;
 
 			glfwGetFramebufferSize(window, &width, &height);
+
+			while (!width || !height)
+			{
+				glfwWaitEvents();
+
+				glfwGetFramebufferSize(window, &width, &height);
+			}
 		}
 
 		vkDeviceWaitIdle(vk_device);
 
-		vkDestroyImageView(vk_device, vk_colour_image_view, nullptr);
+		cleanup_render_targets();
 
-		vkDestroyImage(vk_device, vk_colour_image, nullptr);
+		if (!vk_command_buffers.empty())
+			vkFreeCommandBuffers(vk_device, vk_command_pool, static_cast<uint32_t>(vk_command_buffers.size()), vk_command_buffers.data());
 
-		vkFreeMemory(vk_device, vk_colour_image_memory, nullptr);
+		for (auto& view : vk_swapchain_views)
+			vkDestroyImageView(vk_device, view, nullptr);
 
-		for (auto& framebuffer : vk_swapchain_framebuffers)
-			vkDestroyFramebuffer(vk_device, framebuffer, nullptr);
+		if (headless)
+		{
+			for (auto& image : vk_swapchain_images)
+				vkDestroyImage(vk_device, image, nullptr);
 
-		vkFreeCommandBuffers(vk_device, vk_command_pool, static_cast<uint32_t>(vk_command_buffers.size()), vk_command_buffers.data());
+			for (auto& memory : vk_offscreen_images_memory)
+				vkFreeMemory(vk_device, memory, nullptr);
+		}
+		else
+			vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
 
-		vkDestroyPipeline(vk_device, vk_graphics_pipeline, nullptr);
+		for (auto& buffer : vk_uniform_buffers)
+			vkDestroyBuffer(vk_device, buffer, nullptr);
 
-		vkDestroyPipelineLayout(vk_device, vk_pipeline_layout, nullptr);
+		for (auto& memory : vk_uniform_buffers_memory)
+			vkFreeMemory(vk_device, memory, nullptr);
 
-		vkDestroyRenderPass(vk_device, vk_render_pass, nullptr);
+		vkDestroyDescriptorPool(vk_device, vk_descriptor_pool, nullptr);
 
-		for (auto& view : vk_swapchain_views)
-			vkDestroyImageView(vk_device, view, nullptr);
+		vkDestroyQueryPool(vk_device, vk_timestamp_query_pool, nullptr);
 
-		vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
+		vk_timestamp_query_pool = nullptr;
 
-		for (auto& buffer : vk_uniform_buffers)
+#ifdef OCH_VIRTUAL_TEXTURE
+		for (auto& buffer : vt_feedback_buffers)
 			vkDestroyBuffer(vk_device, buffer, nullptr);
 
-		for (auto& memory : vk_uniform_buffers_memory)
+		for (auto& memory : vt_feedback_buffers_memory)
 			vkFreeMemory(vk_device, memory, nullptr);
+#endif // OCH_VIRTUAL_TEXTURE
+	}
 
-		vkDestroyDescriptorPool(vk_device, vk_descriptor_pool, nullptr);
+	// Everything that depends on the sample count or depth pre-pass: attachments, framebuffers and render pass. Pipelines stay in pipeline_cache.
+	void cleanup_render_targets()
+	{
+		vkDestroyImageView(vk_device, vk_colour_image_view, nullptr);
+
+		vkDestroyImage(vk_device, vk_colour_image, nullptr);
+
+		vkDestroyImageView(vk_device, vk_scene_image_view, nullptr);
+
+		vkDestroyImage(vk_device, vk_scene_image, nullptr);
 
 		vkDestroyImageView(vk_device, vk_depth_image_view, nullptr);
 
 		vkDestroyImage(vk_device, vk_depth_image, nullptr);
 
-		vkFreeMemory(vk_device, vk_depth_image_memory, nullptr);
+		for (auto& memory : vk_render_target_memory)
+			vkFreeMemory(vk_device, memory, nullptr);
+
+		vk_render_target_memory.clear();
+
+		for (auto& framebuffer : vk_swapchain_framebuffers)
+			vkDestroyFramebuffer(vk_device, framebuffer, nullptr);
+
+		vkDestroyRenderPass(vk_device, vk_render_pass, nullptr);
+	}
+
+	// Switches to the AA tier selected by msaa_sample_limit and sample_shading and applies depth_prepass, leaving the swapchain and all resources untouched
+	err_info apply_msaa_settings()
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		check(vkDeviceWaitIdle(vk_device));
+
+		// Pending render pass timings belong to the previous tier
+		check(drain_gpu_timestamps());
+
+		cleanup_render_targets();
+
+		vk_msaa_samples = query_max_msaa_samples();
+
+		check(create_vk_render_pass());
+
+		check(select_pipeline_variant());
+
+		check(create_vk_render_targets());
+
+		check(create_vk_swapchain_framebuffers());
+
+		for (size_t i = 0; i != vk_command_buffers.size(); ++i)
+			check(record_vk_command_buffer(i));
+
+		och::print("AA tier {}{}{}\n", msaa_tier_names[msaa_tier_idx() / 2], msaa_tier_idx() & 1 ? " with sample shading" : "", depth_prepass ? ", depth pre-pass" : "");
+
+		print_attachment_memory_stats();
+
+		return {};
+	}
+
+	// Index into msaa_tier_stats: the tier in the upper bits, sample shading in the lowest one
+	uint32_t msaa_tier_idx() const
+	{
+		uint32_t tier = 0;
+
+		while ((2u << tier) <= static_cast<uint32_t>(vk_msaa_samples) && tier + 1 != msaa_tier_cnt)
+			++tier;
+
+		const bool shaded = sample_shading && has_sample_rate_shading && vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+		return tier * 2 + shaded;
 	}
 
+	// Only releases what exists, so it can follow a failure at any point of initialisation
 	void cleanup()
+	{
+		stop_shader_reload();
+
+		if (vk_device)
+			cleanup_device();
+
+		if (vk_instance)
+		{
+			if (vk_surface)
+				vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+
+			// Destroy Vulkan debug utils messenger
+			{
+#ifdef OCH_VALIDATE
+
+				auto destroy_fn = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(vk_instance, "vkDestroyDebugUtilsMessengerEXT"));
+
+				if (destroy_fn)
+					destroy_fn(vk_instance, vk_debug_messenger, nullptr);
+				else
+					och::print("\nERROR DURING CLEANUP: Could not load vkDestroyDebugUtilsMessengerEXT\n");
+
+#endif // OCH_VALIDATE
+			}
+
+			vkDestroyInstance(vk_instance, nullptr);
+		}
+
+		if (!headless)
+		{
+			if (window)
+				glfwDestroyWindow(window);
+
+			glfwTerminate();
+		}
+
+		window = nullptr;
+
+		vk_instance = nullptr;
+
+		vk_surface = nullptr;
+	}
+
+	void cleanup_device()
 	{
 		cleanup_swapchain();
 
+		pipeline_cache.stop();
+
+		for (auto& [pipeline, timeline_value] : retired_pipelines)
+			vkDestroyPipeline(vk_device, pipeline, nullptr);
+
+		retired_pipelines.clear();
+
+		vkDestroyPipelineLayout(vk_device, vk_pipeline_layout, nullptr);
+
+		finish_texture_stream();
+
 		vkDestroySampler(vk_device, vk_texture_sampler, nullptr);
 
-		vkDestroyImageView(vk_device, vk_texture_image_view, nullptr);
+		for (auto& view : vk_texture_image_level_views)
+			vkDestroyImageView(vk_device, view, nullptr);
 
 		vkDestroyImage(vk_device, vk_texture_image, nullptr);
 
 		vkFreeMemory(vk_device, vk_texture_image_memory, nullptr);
 
+		for (auto& job : mip_gen_jobs)
+			free_mip_gen_job(job);
+
+		mip_gen_jobs.clear();
+
+		for (auto& texture : scene_textures)
+		{
+			vkDestroyImageView(vk_device, texture.view, nullptr);
+
+			vkDestroyImage(vk_device, texture.image, nullptr);
+
+			vkFreeMemory(vk_device, texture.memory, nullptr);
+		}
+
+#ifdef OCH_VIRTUAL_TEXTURE
+		stop_vt_stream();
+
+		vt_file.reset();
+
+		vkDestroySampler(vk_device, vt_atlas_sampler, nullptr);
+
+		vkDestroySampler(vk_device, vt_page_table_sampler, nullptr);
+
+		vkDestroyImageView(vk_device, vt_atlas_image_view, nullptr);
+
+		vkDestroyImage(vk_device, vt_atlas_image, nullptr);
+
+		vkFreeMemory(vk_device, vt_atlas_image_memory, nullptr);
+
+		vkDestroyImageView(vk_device, vt_page_table_image_view, nullptr);
+
+		vkDestroyImage(vk_device, vt_page_table_image, nullptr);
+
+		vkFreeMemory(vk_device, vt_page_table_image_memory, nullptr);
+
+		for (uint32_t i = 0; i != max_frames_in_flight; ++i)
+		{
+			vkDestroyBuffer(vk_device, vt_staging_bufs[i], nullptr);
+
+			vkFreeMemory(vk_device, vt_staging_bufs_memory[i], nullptr);
+		}
+#endif // OCH_VIRTUAL_TEXTURE
+
 		vkDestroyDescriptorSetLayout(vk_device, vk_descriptor_set_layout, nullptr);
 
-		vkDestroyBuffer(vk_device, vk_index_buffer, nullptr);
+		vkDestroyBuffer(vk_device, vk_index_mega_buffer.buffer, nullptr);
+
+		vkFreeMemory(vk_device, vk_index_mega_buffer.memory, nullptr);
 
-		vkFreeMemory(vk_device, vk_index_buffer_memory, nullptr);
+		vkDestroyBuffer(vk_device, vk_vertex_mega_buffer.buffer, nullptr);
 
-		vkDestroyBuffer(vk_device, vk_vertex_buffer, nullptr);
+		vkFreeMemory(vk_device, vk_vertex_mega_buffer.memory, nullptr);
 
-		vkFreeMemory(vk_device, vk_vertex_buffer_memory, nullptr);
+#ifdef OCH_BINDLESS
+		vkDestroyBuffer(vk_device, vk_indirect_buffer, nullptr);
+
+		vkFreeMemory(vk_device, vk_indirect_buffer_memory, nullptr);
+#endif // OCH_BINDLESS
 
 		for(auto& sem : vk_render_complete_semaphores)
 			vkDestroySemaphore(vk_device, sem, nullptr);
@@ -1614,34 +5646,30 @@ struct hello_vulkan
 		for (auto& sem : vk_image_available_semaphores)
 			vkDestroySemaphore(vk_device, sem, nullptr);
 
-		for (auto& fence : vk_inflight_fences)
-			vkDestroyFence(vk_device, fence, nullptr);
+		vkDestroySemaphore(vk_device, vk_frame_timeline, nullptr);
 
 		vkDestroyCommandPool(vk_device, vk_command_pool, nullptr);
 
-		vkDestroyDevice(vk_device, nullptr);
+		if (has_compute_mip_generation)
+		{
+			vkDestroyPipeline(vk_device, vk_downsample_pipeline, nullptr);
 
-		vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+			vkDestroyPipelineLayout(vk_device, vk_downsample_pipeline_layout, nullptr);
 
-		// Destroy Vulkan debug utils messenger
-		{
-#ifdef OCH_VALIDATE
+			vkDestroyDescriptorSetLayout(vk_device, vk_downsample_set_layout, nullptr);
 
-			auto destroy_fn = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(vk_instance, "vkDestroyDebugUtilsMessengerEXT"));
+			vkDestroyBuffer(vk_device, vk_downsample_counter, nullptr);
 
-			if (destroy_fn)
-				destroy_fn(vk_instance, vk_debug_messenger, nullptr);
-			else
-				och::print("\nERROR DURING CLEANUP: Could not load vkDestroyDebugUtilsMessengerEXT\n");
+			vkFreeMemory(vk_device, vk_downsample_counter_memory, nullptr);
 
-#endif // OCH_VALIDATE
-		}
+			vkDestroySemaphore(vk_device, vk_mip_timeline, nullptr);
 
-		vkDestroyInstance(vk_instance, nullptr);
+			vkDestroyCommandPool(vk_device, vk_compute_command_pool, nullptr);
+		}
 
-		glfwDestroyWindow(window);
+		vkDestroyDevice(vk_device, nullptr);
 
-		glfwTerminate();
+		vk_device = nullptr;
 	}
 
 	err_info find_first_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags required_features, VkFormat& out_format)
@@ -1668,6 +5696,30 @@ struct hello_vulkan
 		return ERROR(1);
 	}
 
+	// Creates the module from the embedded SPIR-V called name, or from shaders/name once shader hot reload recompiled it
+	err_info create_shader_module(const char* name, VkShaderModule& out_shader_module)
+	{
+		const uint32_t reloaded_mask = reloaded_shader_mask.load(std::memory_order_acquire);
+
+		for (uint32_t i = 0; i != sizeof(shader_targets) / sizeof(*shader_targets); ++i)
+			if (((reloaded_mask >> i) & 1) && !strcmp(shader_targets[i].output, name))
+				return create_shader_module_from_file((std::string("shaders/") + name).c_str(), out_shader_module);
+
+		const och::shader_blob* blob = och::find_shader_blob(name);
+
+		if (!blob)
+			return ERROR(1);
+
+		VkShaderModuleCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		create_info.codeSize = blob->bytes();
+		create_info.pCode = blob->words;
+
+		check(vkCreateShaderModule(vk_device, &create_info, nullptr, &out_shader_module));
+
+		return {};
+	}
+
 	err_info create_shader_module_from_file(const char* filename, VkShaderModule& out_shader_module)
 	{
 		och::mapped_file<uint8_t> shader_file(filename, och::fio::access_read, och::fio::open_normal, och::fio::open_fail);
@@ -1701,9 +5753,11 @@ struct hello_vulkan
 		{
 			VkQueueFamilyProperties& avl = available[i];
 
-			VkBool32 supports_present;
+			// Without a surface there is nothing to present to, so the graphics family stands in
+			VkBool32 supports_present = VK_TRUE;
 
-			check(vkGetPhysicalDeviceSurfaceSupportKHR(physical_dev, i, surface, &supports_present));
+			if (surface)
+				check(vkGetPhysicalDeviceSurfaceSupportKHR(physical_dev, i, surface, &supports_present));
 
 			if (avl.queueFlags & VK_QUEUE_GRAPHICS_BIT && !has_graphics_and_present_in_one)
 			{
@@ -1717,7 +5771,8 @@ struct hello_vulkan
 				}
 			}
 
-			if (avl.queueFlags & VK_QUEUE_COMPUTE_BIT)
+			// A family without graphics is the one that can actually run alongside rendering
+			if (avl.queueFlags & VK_QUEUE_COMPUTE_BIT && (out_indices.compute_idx == ~0u || !(avl.queueFlags & VK_QUEUE_GRAPHICS_BIT)))
 				out_indices.compute_idx = i;
 
 			if (avl.queueFlags & VK_QUEUE_TRANSFER_BIT)
@@ -1778,6 +5833,9 @@ struct hello_vulkan
 
 		VkSampleCountFlags compat = props.limits.framebufferDepthSampleCounts & props.limits.framebufferColorSampleCounts;
 
+		// Sample count bits equal the number of samples they stand for
+		compat &= (msaa_sample_limit << 1) - 1;
+
 		if (compat & VK_SAMPLE_COUNT_64_BIT)
 			return VK_SAMPLE_COUNT_64_BIT;
 		if (compat & VK_SAMPLE_COUNT_32_BIT)
@@ -1826,7 +5884,8 @@ struct hello_vulkan
 		return {};
 	}
 
-	err_info allocate_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage& out_image, VkDeviceMemory& out_image_memory, VkSampleCountFlagBits sample_cnt = VK_SAMPLE_COUNT_1_BIT, uint32_t mip_levels = 1, VkSharingMode share_mode = VK_SHARING_MODE_EXCLUSIVE, uint32_t queue_family_cnt = 0, const uint32_t* queue_family_ptr = nullptr)
+	// Creates an image without binding any memory to it
+	err_info create_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkImage& out_image, VkSampleCountFlagBits sample_cnt = VK_SAMPLE_COUNT_1_BIT, uint32_t mip_levels = 1, VkSharingMode share_mode = VK_SHARING_MODE_EXCLUSIVE, uint32_t queue_family_cnt = 0, const uint32_t* queue_family_ptr = nullptr, VkImageCreateFlags create_flags = 0)
 	{
 		VkImageCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1841,13 +5900,20 @@ struct hello_vulkan
 		create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		create_info.usage = usage_flags;
 		create_info.samples = sample_cnt;
-		create_info.flags = 0;
+		create_info.flags = create_flags;
 		create_info.sharingMode = share_mode;
 		create_info.queueFamilyIndexCount = queue_family_cnt;
 		create_info.pQueueFamilyIndices = queue_family_ptr;
 
 		check(vkCreateImage(vk_device, &create_info, nullptr, &out_image));
 
+		return {};
+	}
+
+	err_info allocate_image(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkImage& out_image, VkDeviceMemory& out_image_memory, VkSampleCountFlagBits sample_cnt = VK_SAMPLE_COUNT_1_BIT, uint32_t mip_levels = 1, VkSharingMode share_mode = VK_SHARING_MODE_EXCLUSIVE, uint32_t queue_family_cnt = 0, const uint32_t* queue_family_ptr = nullptr, VkImageCreateFlags create_flags = 0)
+	{
+		check(create_image(width, height, format, tiling, usage_flags, out_image, sample_cnt, mip_levels, share_mode, queue_family_cnt, queue_family_ptr, create_flags));
+
 		VkMemoryRequirements mem_reqs;
 
 		vkGetImageMemoryRequirements(vk_device, out_image, &mem_reqs);
@@ -1868,10 +5934,16 @@ struct hello_vulkan
 		return {};
 	}
 	
-	err_info allocate_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_mask, VkImageView& out_image_view, uint32_t mip_levels = 1)
+	// view_usage restricts the view to a subset of the image's usage, which views of images with extended usage need if format does not support all of it
+	err_info allocate_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_mask, VkImageView& out_image_view, uint32_t mip_levels = 1, uint32_t base_mip_level = 0, VkImageUsageFlags view_usage = 0)
 	{
+		VkImageViewUsageCreateInfo usage_info{};
+		usage_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+		usage_info.usage = view_usage;
+
 		VkImageViewCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		create_info.pNext = view_usage ? &usage_info : nullptr;
 		create_info.image = image;
 		create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		create_info.format = format;
@@ -1880,7 +5952,7 @@ struct hello_vulkan
 		create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 		create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 		create_info.subresourceRange.aspectMask = aspect_mask;
-		create_info.subresourceRange.baseMipLevel = 0;
+		create_info.subresourceRange.baseMipLevel = base_mip_level;
 		create_info.subresourceRange.levelCount = mip_levels;
 		create_info.subresourceRange.baseArrayLayer = 0;
 		create_info.subresourceRange.layerCount = 1;
@@ -1932,141 +6004,204 @@ struct hello_vulkan
 		return {};
 	}
 
-	err_info transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels = 1)
+	// Uploads level 0 from staging_buf and generates every other level with downsample.comp on the compute queue, leaving all levels ready for sampling.
+	// Takes over the staging buffer, which is freed once the job retired. Frames wait for outstanding jobs, see draw_frame.
+	err_info submit_mip_generation(VkImage image, uint32_t width, uint32_t height, uint32_t mip_levels, VkBuffer staging_buf, VkDeviceMemory staging_buf_mem)
 	{
-		VkCommandBuffer transit_cmd_buffer;
+		OCH_ZONE(__FUNCTION__);
+
+		mip_gen_job job;
+		job.staging_buf = staging_buf;
+		job.staging_buf_mem = staging_buf_mem;
+		job.timeline_value = mip_timeline_value + 1;
 
-		check(beg_single_command(transit_cmd_buffer));
+		// Every dispatch but the last writes at least six levels
+		const uint32_t max_dispatch_cnt = (mip_levels + 4) / 6;
 
-		VkImageMemoryBarrier img_barrier{};
-		img_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		img_barrier.image = image;
-		img_barrier.subresourceRange.aspectMask = format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-		img_barrier.subresourceRange.baseMipLevel = 0;
-		img_barrier.subresourceRange.levelCount = mip_levels;
-		img_barrier.subresourceRange.baseArrayLayer = 0;
-		img_barrier.subresourceRange.layerCount = 1;
-		img_barrier.oldLayout = old_layout;
-		img_barrier.newLayout = new_layout;
-		img_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		img_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		img_barrier.srcAccessMask = 0;
-		img_barrier.dstAccessMask = 0;
+		VkDescriptorPoolSize pool_sizes[]{
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, (downsample_max_levels + 1) * (max_dispatch_cnt ? max_dispatch_cnt : 1) },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_dispatch_cnt ? max_dispatch_cnt : 1 },
+		};
 
-		VkPipelineStageFlags src_stage;
-		VkPipelineStageFlags dst_stage;
+		VkDescriptorPoolCreateInfo pool_info{};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.poolSizeCount = static_cast<uint32_t>(sizeof(pool_sizes) / sizeof(*pool_sizes));
+		pool_info.pPoolSizes = pool_sizes;
+		pool_info.maxSets = max_dispatch_cnt ? max_dispatch_cnt : 1;
 
-		if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-		{
-			img_barrier.srcAccessMask = 0;
-			img_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		check(vkCreateDescriptorPool(vk_device, &pool_info, nullptr, &job.descriptor_pool));
 
-			src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		// Storage access goes through UNORM views, which the image's extended usage allows
+		job.level_views.resize(mip_levels);
+
+		for (uint32_t i = 0; i != mip_levels; ++i)
+			check(allocate_image_view(image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, job.level_views[i], 1, i, VK_IMAGE_USAGE_STORAGE_BIT));
+
+		VkCommandBufferAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = 1;
+		alloc_info.commandPool = vk_compute_command_pool;
+
+		check(vkAllocateCommandBuffers(vk_device, &alloc_info, &job.command_buffer));
+
+		VkCommandBufferBeginInfo beg_info{};
+		beg_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beg_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		check(vkBeginCommandBuffer(job.command_buffer, &beg_info));
+
+		const VkCommandBuffer cmd = job.command_buffer;
+
+		resource_states.access_image(image, och::access_transfer_dst, 0, 1, true);
+
+		resource_states.flush(cmd);
+
+		VkBufferImageCopy copy_region{};
+		copy_region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copy_region.imageExtent = { width, height, 1 };
+
+		vkCmdCopyBufferToImage(cmd, staging_buf, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, vk_downsample_pipeline);
+
+		for (uint32_t base = 0; base + 1 < mip_levels;)
 		{
-			img_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			img_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			const uint32_t src_w = mip_extent(width, base);
+
+			const uint32_t src_h = mip_extent(height, base);
+
+			// The last workgroup reduces level 6 as one 64x64 block, so level 6 must fit in it, which sources of up to 64 * 64 texels guarantee
+			const uint32_t level_cap = (src_w > src_h ? src_w : src_h) <= 64 * 64 ? downsample_max_levels : 6;
+
+			const uint32_t level_cnt = mip_levels - 1 - base < level_cap ? mip_levels - 1 - base : level_cap;
+
+			VkDescriptorSetAllocateInfo set_info{};
+			set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			set_info.descriptorPool = job.descriptor_pool;
+			set_info.descriptorSetCount = 1;
+			set_info.pSetLayouts = &vk_downsample_set_layout;
+
+			VkDescriptorSet set;
+
+			check(vkAllocateDescriptorSets(vk_device, &set_info, &set));
+
+			// Entries past level_cnt are never accessed, but still need a valid view
+			VkDescriptorImageInfo image_infos[downsample_max_levels + 1];
+
+			for (uint32_t i = 0; i != downsample_max_levels + 1; ++i)
+				image_infos[i] = { nullptr, job.level_views[base + (i < level_cnt ? i : level_cnt)], VK_IMAGE_LAYOUT_GENERAL };
+
+			VkDescriptorBufferInfo counter_info{ vk_downsample_counter, 0, VK_WHOLE_SIZE };
+
+			VkWriteDescriptorSet writes[2]{};
+			writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[0].dstSet = set;
+			writes[0].dstBinding = 0;
+			writes[0].descriptorCount = downsample_max_levels + 1;
+			writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[0].pImageInfo = image_infos;
+			writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[1].dstSet = set;
+			writes[1].dstBinding = 1;
+			writes[1].descriptorCount = 1;
+			writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[1].pBufferInfo = &counter_info;
+
+			vkUpdateDescriptorSets(vk_device, 2, writes, 0, nullptr);
+
+			resource_states.access_buffer(vk_downsample_counter, och::access_transfer_dst);
+
+			resource_states.flush(cmd);
+
+			vkCmdFillBuffer(cmd, vk_downsample_counter, 0, sizeof(uint32_t), 0);
+
+			resource_states.access_buffer(vk_downsample_counter, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED });
+
+			resource_states.access_image(image, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL }, base, 1);
+
+			// The last workgroup reads level 6 back, so the written levels are read as well
+			resource_states.access_image(image, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }, base + 1, level_cnt, true);
+
+			resource_states.flush(cmd);
+
+			const uint32_t group_cnt_x = (mip_extent(src_w, 1) + 31) / 32;
+
+			const uint32_t group_cnt_y = (mip_extent(src_h, 1) + 31) / 32;
+
+			const uint32_t push_data[]{ src_w, src_h, level_cnt, group_cnt_x * group_cnt_y };
+
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, vk_downsample_pipeline_layout, 0, 1, &set, 0, nullptr);
+
+			vkCmdPushConstants(cmd, vk_downsample_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_data), push_data);
 
-			src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-		{
-			img_barrier.srcAccessMask = 0;
-			img_barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			vkCmdDispatch(cmd, group_cnt_x, group_cnt_y, 1);
 
-			src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+			base += level_cnt;
 		}
-		else
-			return ERROR(1);
 
-		vkCmdPipelineBarrier(transit_cmd_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &img_barrier);
+		// Fragment stages do not exist on a compute queue. The timeline semaphore makes the levels visible to the frames waiting on it.
+		resource_states.access_image(image, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
 
-		check(end_single_command(transit_cmd_buffer));
+		resource_states.flush(cmd);
 
-		return {};
-	}
+		check(vkEndCommandBuffer(cmd));
 
-	err_info generate_mipmap(VkImage image, VkFormat format, int32_t width, int32_t height, uint32_t mip_levels)
-	{
-		VkFormatProperties props;
-		
-		vkGetPhysicalDeviceFormatProperties(vk_physical_device, format, &props);
+		VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+		timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_submit_info.signalSemaphoreValueCount = 1;
+		timeline_submit_info.pSignalSemaphoreValues = &job.timeline_value;
 
-		if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
-			return ERROR(1);
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_submit_info;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &cmd;
+		submit_info.signalSemaphoreCount = 1;
+		submit_info.pSignalSemaphores = &vk_mip_timeline;
 
-		VkCommandBuffer buf;
+		check(vkQueueSubmit(vk_compute_queue, 1, &submit_info, nullptr));
 
-		check(beg_single_command(buf));
+		mip_timeline_value = job.timeline_value;
 
-		VkImageMemoryBarrier barrier{};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.image = image;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-		barrier.subresourceRange.levelCount = 1;
+		mip_gen_jobs.push_back(std::move(job));
 
-		int32_t mip_width = width;
-		int32_t mip_height = height;
+		return {};
+	}
 
-		for (uint32_t i = 0; i != mip_levels - 1; ++i)
-		{
-			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			barrier.subresourceRange.baseMipLevel = i;
+	// Frees the resources of every mip generation job the compute queue has finished
+	err_info retire_mip_gen_jobs()
+	{
+		if (mip_gen_jobs.empty())
+			return {};
 
-			vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		uint64_t completed_value;
 
-			VkImageBlit blit{};
-			blit.srcOffsets[0] = { 0, 0, 0 };
-			blit.srcOffsets[1] = { mip_width, mip_height, 1 };
-			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blit.srcSubresource.baseArrayLayer = 0;
-			blit.srcSubresource.layerCount = 1;
-			blit.srcSubresource.mipLevel = i;
-			blit.dstOffsets[0] = { 0, 0, 0 };
-			blit.dstOffsets[1] = { mip_width > 1 ? mip_width >> 1 : 1, mip_height > 1 ? mip_height >> 1 : 1, 1 };
-			blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			blit.dstSubresource.baseArrayLayer = 0;
-			blit.dstSubresource.layerCount = 1;
-			blit.dstSubresource.mipLevel = i + 1;
+		check(vkGetSemaphoreCounterValue(vk_device, vk_mip_timeline, &completed_value));
 
-			vkCmdBlitImage(buf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		// Jobs complete in submission order
+		auto retired_end = std::find_if(mip_gen_jobs.begin(), mip_gen_jobs.end(), [completed_value](const mip_gen_job& job) { return job.timeline_value > completed_value; });
 
-			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		for (auto it = mip_gen_jobs.begin(); it != retired_end; ++it)
+			free_mip_gen_job(*it);
 
-			vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		mip_gen_jobs.erase(mip_gen_jobs.begin(), retired_end);
 
-			if (mip_width > 1)
-				mip_width >>= 1;
+		return {};
+	}
 
-			if (mip_height > 1)
-				mip_height >>= 1;
-		}
+	void free_mip_gen_job(mip_gen_job& job)
+	{
+		vkFreeCommandBuffers(vk_device, vk_compute_command_pool, 1, &job.command_buffer);
 
-		barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkDestroyDescriptorPool(vk_device, job.descriptor_pool, nullptr);
 
-		vkCmdPipelineBarrier(buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		for (VkImageView view : job.level_views)
+			vkDestroyImageView(vk_device, view, nullptr);
 
-		check(end_single_command(buf));
+		vkDestroyBuffer(vk_device, job.staging_buf, nullptr);
 
-		return {};
+		vkFreeMemory(vk_device, job.staging_buf_mem, nullptr);
 	}
 
 	err_info beg_single_command(VkCommandBuffer& out_command_buffer)
@@ -2090,6 +6225,8 @@ struct hello_vulkan
 
 	err_info end_single_command(VkCommandBuffer command_buffer)
 	{
+		OCH_ZONE(__FUNCTION__);
+
 		check(vkEndCommandBuffer(command_buffer));
 
 		VkSubmitInfo submit_info{};
@@ -2099,7 +6236,8 @@ struct hello_vulkan
 		
 		check(vkQueueSubmit(vk_graphics_queue, 1, &submit_info, nullptr));
 
-		check(vkDeviceWaitIdle(vk_device));
+		// Other queues may keep working
+		check(vkQueueWaitIdle(vk_graphics_queue));
 
 		vkFreeCommandBuffers(vk_device, vk_command_pool, 1, &command_buffer);
 
@@ -2110,18 +6248,29 @@ struct hello_vulkan
 	{
 		static och::time start_t = och::time::now();
 
-		float seconds = (och::time::now() - start_t).microseconds() / 1'000'000.0F;
+		float seconds = fixed_timestep != 0.0F ? animation_frame_idx * fixed_timestep : (och::time::now() - start_t).microseconds() / 1'000'000.0F;
 
-		uniform_buffer_obj ubo;
+		++animation_frame_idx;
+
+		if (camera_dirty)
+		{
+			// glm::lookAt(glm::vec3(2.0F, 2.0F, 2.0F), glm::vec3(0.0F, 0.0F, 0.0F), glm::vec3(0.0F, 0.0F, 1.0F));
+			const och::mat4 view = och::look_at(och::vec3(2.0F), och::vec3(0.0F), och::vec3(0.0F, 0.0F, 1.0F));
+
+			// glm::perspective(glm::radians(45.0F), static_cast<float>(vk_swapchain_extent.width) / vk_swapchain_extent.height, 0.1F, 10.0F); projection[1][1] *= -1;
+			const float aspect = static_cast<float>(vk_swapchain_extent.width) / vk_swapchain_extent.height;
+
+			const och::mat4 projection = reversed_z ? reversed_z_perspective(0.785398F, aspect, 0.1F) : och::perspective(0.785398F, aspect, 0.1F, 10.0F);
+
+			view_projection = projection * view;
 
-		//ubo.model = glm::rotate(glm::mat4(1.0F), seconds * glm::radians(90.0F), glm::vec3(0.0F, 0.0F, 1.0F));
-		ubo.model = och::mat4::rotate_z(seconds * 0.785398F);
+			camera_dirty = false;
+		}
 
-		// ubo.view = glm::lookAt(glm::vec3(2.0F, 2.0F, 2.0F), glm::vec3(0.0F, 0.0F, 0.0F), glm::vec3(0.0F, 0.0F, 1.0F));
-		ubo.view = och::look_at(och::vec3(2.0F), och::vec3(0.0F), och::vec3(0.0F, 0.0F, 1.0F));
+		uniform_buffer_obj ubo;
 
-		// ubo.projection = glm::perspective(glm::radians(45.0F), static_cast<float>(vk_swapchain_extent.width) / vk_swapchain_extent.height, 0.1F, 10.0F); ubo.projection[1][1] *= -1;
-		ubo.projection = och::perspective(0.785398F, static_cast<float>(vk_swapchain_extent.width) / vk_swapchain_extent.height, 0.1F, 10.0F);
+		//glm::rotate(glm::mat4(1.0F), seconds * glm::radians(90.0F), glm::vec3(0.0F, 0.0F, 1.0F));
+		ubo.model_view_projection = view_projection * och::mat4::rotate_z(seconds * 0.785398F);
 
 		void* uniform_data;
 
@@ -2134,6 +6283,165 @@ struct hello_vulkan
 		return {};
 	}
 
+	// Same conventions as och::perspective, with depth 1 at z_near and 0 at infinity. The constructor takes columns, like glm's.
+	static och::mat4 reversed_z_perspective(float fov_y, float aspect, float z_near)
+	{
+		const float f = 1.0F / tanf(fov_y * 0.5F);
+
+		return och::mat4(
+			f / aspect, 0.0F,  0.0F,    0.0F,
+			0.0F,       -f,    0.0F,    0.0F,
+			0.0F,       0.0F,  0.0F,   -1.0F,
+			0.0F,       0.0F,  z_near,  0.0F);
+	}
+
+	static uint32_t mip_extent(uint32_t extent, uint32_t level)
+	{
+		return extent >> level ? extent >> level : 1;
+	}
+
+	static uint32_t mip_level_cnt(uint32_t width, uint32_t height)
+	{
+		uint32_t img_sz = height > width ? height : width;
+
+		uint32_t mip_levels = 0;
+
+		while (img_sz)
+		{
+			img_sz >>= 1;
+			++mip_levels;
+		}
+
+		return mip_levels;
+	}
+
+	// Byte offsets of each level of a tightly packed BGRA mip chain, with the total size as the last entry
+	static void compute_mip_offsets(uint32_t width, uint32_t height, uint32_t mip_levels, std::vector<VkDeviceSize>& out_offsets)
+	{
+		out_offsets.resize(mip_levels + 1);
+
+		out_offsets[0] = 0;
+
+		for (uint32_t i = 0; i != mip_levels; ++i)
+			out_offsets[i + 1] = out_offsets[i] + static_cast<VkDeviceSize>(mip_extent(width, i)) * mip_extent(height, i) * 4;
+	}
+
+	static uint32_t load_bitmap_texel(const bitmap_header& header, uint32_t x, uint32_t y)
+	{
+		const uint32_t bytes_per_pixel = header.bits_per_pixel >> 3;
+
+		const uint8_t* texel = header.pixel_data() + (static_cast<size_t>(y) * header.width + x) * bytes_per_pixel;
+
+		const uint32_t alpha = bytes_per_pixel == 4 ? static_cast<uint32_t>(texel[3]) << 24 : 0xFF000000;
+
+		return texel[0] | (static_cast<uint32_t>(texel[1]) << 8) | (static_cast<uint32_t>(texel[2]) << 16) | alpha;
+	}
+
+	// Conversions between sRGB encoded bytes and 16-bit fixed point linear intensities
+	struct srgb_tables
+	{
+		uint16_t to_linear[256];
+
+		uint8_t to_srgb[65536];
+
+		srgb_tables()
+		{
+			for (uint32_t i = 0; i != 256; ++i)
+			{
+				const double c = i / 255.0;
+
+				const double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+
+				to_linear[i] = static_cast<uint16_t>(l * 65535.0 + 0.5);
+			}
+
+			for (uint32_t i = 0; i != 65536; ++i)
+			{
+				const double l = i / 65535.0;
+
+				const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+
+				to_srgb[i] = static_cast<uint8_t>(c * 255.0 + 0.5);
+			}
+		}
+	};
+
+	static const srgb_tables& get_srgb_tables()
+	{
+		static const srgb_tables tables;
+
+		return tables;
+	}
+
+	// Averages colour in linear space, since the texels are stored sRGB encoded. Alpha is linear already.
+	static uint32_t average_texels(uint32_t t0, uint32_t t1, uint32_t t2, uint32_t t3)
+	{
+		const srgb_tables& tables = get_srgb_tables();
+
+		uint32_t avg = ((((t0 >> 24) & 0xFF) + ((t1 >> 24) & 0xFF) + ((t2 >> 24) & 0xFF) + ((t3 >> 24) & 0xFF) + 2) >> 2) << 24;
+
+		for (uint32_t shift = 0; shift != 24; shift += 8)
+		{
+			const uint32_t sum = tables.to_linear[(t0 >> shift) & 0xFF] + tables.to_linear[(t1 >> shift) & 0xFF] + tables.to_linear[(t2 >> shift) & 0xFF] + tables.to_linear[(t3 >> shift) & 0xFF];
+
+			avg |= static_cast<uint32_t>(tables.to_srgb[(sum + 2) >> 2]) << shift;
+		}
+
+		return avg;
+	}
+
+	// Approximates the given mip level straight from the source bitmap by averaging four taps per texel.
+	// For level 0 this is an exact conversion to BGRA.
+	static void sample_bitmap_sparse(const bitmap_header& header, uint32_t level, uint32_t* out_texels)
+	{
+		const uint32_t src_w = static_cast<uint32_t>(header.width);
+		const uint32_t src_h = static_cast<uint32_t>(header.height);
+
+		const uint32_t dst_w = mip_extent(src_w, level);
+		const uint32_t dst_h = mip_extent(src_h, level);
+
+		const uint32_t step = 1 << level;
+
+		for (uint32_t y = 0; y != dst_h; ++y)
+			for (uint32_t x = 0; x != dst_w; ++x)
+			{
+				if (level == 0)
+				{
+					out_texels[y * dst_w + x] = load_bitmap_texel(header, x, y);
+
+					continue;
+				}
+
+				uint32_t x0 = x * step + (step >> 2), x1 = x0 + (step >> 1);
+				uint32_t y0 = y * step + (step >> 2), y1 = y0 + (step >> 1);
+
+				if (x0 >= src_w) x0 = src_w - 1;
+				if (x1 >= src_w) x1 = src_w - 1;
+				if (y0 >= src_h) y0 = src_h - 1;
+				if (y1 >= src_h) y1 = src_h - 1;
+
+				out_texels[y * dst_w + x] = average_texels(load_bitmap_texel(header, x0, y0), load_bitmap_texel(header, x1, y0), load_bitmap_texel(header, x0, y1), load_bitmap_texel(header, x1, y1));
+			}
+	}
+
+	static void downsample_texels(const uint32_t* src, uint32_t src_w, uint32_t src_h, uint32_t* dst)
+	{
+		const uint32_t dst_w = mip_extent(src_w, 1);
+		const uint32_t dst_h = mip_extent(src_h, 1);
+
+		for (uint32_t y = 0; y != dst_h; ++y)
+		{
+			const uint32_t y0 = y * 2, y1 = y * 2 + 1 < src_h ? y * 2 + 1 : src_h - 1;
+
+			for (uint32_t x = 0; x != dst_w; ++x)
+			{
+				const uint32_t x0 = x * 2, x1 = x * 2 + 1 < src_w ? x * 2 + 1 : src_w - 1;
+
+				dst[y * dst_w + x] = average_texels(src[y0 * src_w + x0], src[y0 * src_w + x1], src[y1 * src_w + x0], src[y1 * src_w + x1]);
+			}
+		}
+	}
+
 	void normalize_model(std::vector<vertex>& verts, glm::vec3 center = { 0.0F, 0.0F, 0.0F }, float scale = 2.0F)
 	{
 		float max_x = -INFINITY, max_y = -INFINITY, max_z = -INFINITY, min_x = INFINITY, min_y = INFINITY, min_z = INFINITY;
@@ -2175,7 +6483,156 @@ struct hello_vulkan
 	}
 };
 
-int main()
+void print_error_stack()
+{
+	och::print("An Error occurred!\n");
+
+	auto stack = och::get_stacktrace();
+
+	for (auto e : stack)
+		och::print("Function {} on Line {}: \"{}\"\n\n", e->function, e->line_num, e->call);
+}
+
+void print_usage()
+{
+	och::print(
+		"Usage: och_vk_test [options]\n"
+		"  --scene <path>                  Scene file listing meshes and textures\n"
+		"  --device <name>                 Use the physical device with this name\n"
+		"  --trace <path>                  Write a trace of the run\n"
+		"  --startup-report <path>         Write per-stage startup timings\n"
+		"  --headless                      Render offscreen without a window\n"
+		"  --standard-z                    Use a standard instead of a reversed depth range\n"
+		"  --depth-prepass                 Lay down depth before shading\n"
+		"  --resolution <w>[x<h>]          Window or offscreen extent, nonzero\n"
+		"  --frames <n>                    Frames to render headless, nonzero\n"
+		"  --gpu-budget <ms>               GPU frame time to scale resolution towards\n"
+		"  --warmup <n>                    Frames to skip before collecting statistics\n"
+		"  --benchmark <name>              Run the benchmark sweep, writing <name>.csv and <name>.json\n"
+		"  --baseline <path>               Benchmark CSV to check for regressions against\n"
+		"  --threshold <percent>           Allowed regression against the baseline\n"
+		"  --msaa <list>                   MSAA sample counts to sweep\n"
+		"  --present-mode <list>           Present modes to sweep\n"
+		"  --frames-in-flight <list>       Frames in flight to sweep\n"
+		"  --instances <list>              Instance counts to sweep\n"
+		"  --swapchain-images <n>          Requested swapchain image count\n"
+		"  --frame-policy <policy>         low-latency, balanced or throughput\n");
+}
+
+// Parses a nonzero decimal count, leaving out_end just past its last digit
+bool parse_count(const char* str, uint32_t& out, const char*& out_end)
+{
+	// strtoull would also accept leading whitespace and signs
+	if (*str < '0' || *str > '9')
+		return false;
+
+	char* end;
+
+	const unsigned long long value = strtoull(str, &end, 10);
+
+	if (value == 0 || value > UINT32_MAX)
+		return false;
+
+	out = static_cast<uint32_t>(value);
+
+	out_end = end;
+
+	return true;
+}
+
+// Runs every configuration of the sweep on a fresh hello_vulkan with the settings of base.
+// Returns the number of failed runs and regressions against the baseline, if one is given.
+uint32_t run_benchmark(const hello_vulkan& base, const och::benchmark_sweep& sweep, const char* output_name, const char* baseline_path, float threshold_percent)
+{
+	if (base.headless && sweep.present_modes.size() > 1)
+		och::print("Headless runs do not present, so present modes only label the results\n\n");
+
+	std::vector<och::benchmark_result> results;
+
+	uint32_t failure_cnt = 0;
+
+	for (const och::benchmark_config& config : sweep.expand())
+	{
+		och::print("Benchmark: {}x MSAA, {}, {} frames in flight, {} instances\n\n", config.msaa_samples, och::benchmark_present_mode_names[static_cast<uint32_t>(config.present_mode)], config.frames_in_flight, config.instance_cnt);
+
+		// hello_vulkan does not support being initialized twice, so every run gets its own
+		auto vk = std::make_unique<hello_vulkan>();
+
+		vk->scene_path = base.scene_path;
+		vk->window_width = base.window_width;
+		vk->window_height = base.window_height;
+		vk->headless = base.headless;
+		vk->physical_device_override = base.physical_device_override;
+		vk->headless_frame_cnt = base.headless_frame_cnt;
+		vk->warmup_frame_cnt = base.warmup_frame_cnt;
+		vk->fixed_timestep = base.fixed_timestep;
+		vk->benchmark = true;
+		vk->msaa_sample_limit = config.msaa_samples;
+		vk->reversed_z = base.reversed_z;
+		vk->depth_prepass = base.depth_prepass;
+		vk->preferred_present_mode = hello_vulkan::policy_present_modes[static_cast<uint32_t>(config.present_mode)];
+		vk->requested_swapchain_image_cnt = base.requested_swapchain_image_cnt;
+		vk->frames_in_flight = config.frames_in_flight;
+		vk->instance_cnt = config.instance_cnt;
+
+		if (vk->run())
+		{
+			print_error_stack();
+
+			++failure_cnt;
+
+			continue;
+		}
+
+		// The device may support fewer samples than requested, which would make the result mislabeled
+		if (static_cast<uint32_t>(vk->vk_msaa_samples) != config.msaa_samples)
+		{
+			och::print("Skipping result, as only {}x MSAA is supported\n\n", static_cast<uint32_t>(vk->vk_msaa_samples));
+
+			continue;
+		}
+
+		vk->benchmark_stats.config = config;
+
+		results.push_back(vk->benchmark_stats);
+	}
+
+	const std::string csv_path = std::string(output_name) + ".csv";
+
+	const std::string json_path = std::string(output_name) + ".json";
+
+	if (!och::write_benchmark_csv(csv_path.c_str(), results) || !och::write_benchmark_json(json_path.c_str(), results))
+	{
+		och::print("Could not write benchmark results to {}\n", output_name);
+
+		++failure_cnt;
+	}
+
+	if (!baseline_path)
+		return failure_cnt;
+
+	std::vector<och::benchmark_result> baseline;
+
+	if (!och::read_benchmark_csv(baseline_path, baseline))
+	{
+		och::print("Could not read benchmark baseline {}\n", baseline_path);
+
+		return failure_cnt + 1;
+	}
+
+	std::vector<och::benchmark_regression> regressions;
+
+	och::compare_benchmark_results(baseline, results, threshold_percent, regressions);
+
+	for (const och::benchmark_regression& r : regressions)
+		och::print("Regression: {} went from {} to {} ({}x MSAA, {}, {} frames in flight, {} instances)\n", r.metric, static_cast<float>(r.baseline), static_cast<float>(r.current), r.config.msaa_samples, och::benchmark_present_mode_names[static_cast<uint32_t>(r.config.present_mode)], r.config.frames_in_flight, r.config.instance_cnt);
+
+	och::print("{} regressions beyond {}% against {}\n", regressions.size(), threshold_percent, baseline_path);
+
+	return failure_cnt + static_cast<uint32_t>(regressions.size());
+}
+
+int main(int argc, const char** argv)
 {
 	//glm::mat4 mglm = glm::perspective(0.25F, 1440.0F / 810.0F, 0.1F, 10.0F); mglm[1][1] *= -1;
 	//och::mat4 moch = och::perspective(0.25F, 1440.0F / 810.0F, 0.1F, 10.0F);
@@ -2198,18 +6655,183 @@ int main()
 	//	och::print("Equal\n\n");
 
 	hello_vulkan vk;
+
+	och::benchmark_sweep benchmark_sweep;
+
+	const char* benchmark_name = nullptr;
+
+	const char* benchmark_baseline = nullptr;
+
+	float benchmark_threshold = 5.0F;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--scene") && i + 1 < argc)
+			vk.scene_path = argv[++i];
+		else if (!strcmp(argv[i], "--device") && i + 1 < argc)
+			vk.physical_device_override = argv[++i];
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			vk.trace_path = argv[++i];
+		else if (!strcmp(argv[i], "--startup-report") && i + 1 < argc)
+			vk.startup_report_path = argv[++i];
+		else if (!strcmp(argv[i], "--headless"))
+			vk.headless = true;
+		else if (!strcmp(argv[i], "--standard-z"))
+			vk.reversed_z = false;
+		else if (!strcmp(argv[i], "--depth-prepass"))
+			vk.depth_prepass = true;
+		else if (!strcmp(argv[i], "--resolution") && i + 1 < argc)
+		{
+			const char* resolution = argv[++i];
+
+			const char* end;
+
+			bool is_valid = parse_count(resolution, vk.window_width, end);
+
+			// The height is optional
+			if (is_valid && *end == 'x')
+				is_valid = parse_count(end + 1, vk.window_height, end);
+
+			if (!is_valid || *end)
+			{
+				och::print("Invalid resolution {}\n\n", resolution);
+
+				print_usage();
+
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+		{
+			const char* end;
+
+			if (!parse_count(argv[++i], vk.headless_frame_cnt, end) || *end)
+			{
+				och::print("Invalid frame count {}\n\n", argv[i]);
+
+				print_usage();
+
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "--gpu-budget") && i + 1 < argc)
+			vk.gpu_frame_budget_ms = strtof(argv[++i], nullptr);
+		else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)
+			vk.warmup_frame_cnt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (!strcmp(argv[i], "--benchmark") && i + 1 < argc)
+			benchmark_name = argv[++i];
+		else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+			benchmark_baseline = argv[++i];
+		else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+			benchmark_threshold = strtof(argv[++i], nullptr);
+		else if (!strcmp(argv[i], "--msaa") && i + 1 < argc)
+		{
+			std::vector<uint32_t> values;
+
+			if (och::parse_benchmark_list(argv[++i], values) && std::none_of(values.begin(), values.end(), [](uint32_t n) { return n > 8 || (n & (n - 1)); }))
+				benchmark_sweep.msaa_samples = values;
+			else
+				och::print("Ignoring invalid MSAA sample counts {}\n", argv[i]);
+		}
+		else if (!strcmp(argv[i], "--present-mode") && i + 1 < argc)
+		{
+			std::vector<och::benchmark_present_mode> values;
+
+			if (och::parse_benchmark_list(argv[++i], values))
+			{
+				benchmark_sweep.present_modes = values;
+
+				vk.preferred_present_mode = hello_vulkan::policy_present_modes[static_cast<uint32_t>(values[0])];
+			}
+			else
+				och::print("Ignoring invalid present modes {}\n", argv[i]);
+		}
+		else if (!strcmp(argv[i], "--frames-in-flight") && i + 1 < argc)
+		{
+			std::vector<uint32_t> values;
+
+			if (och::parse_benchmark_list(argv[++i], values) && std::none_of(values.begin(), values.end(), [](uint32_t n) { return n > hello_vulkan::max_frames_in_flight; }))
+			{
+				benchmark_sweep.frames_in_flight = values;
+
+				vk.frames_in_flight = values[0];
+			}
+			else
+				och::print("Ignoring invalid frames in flight {}\n", argv[i]);
+		}
+		else if (!strcmp(argv[i], "--swapchain-images") && i + 1 < argc)
+			vk.requested_swapchain_image_cnt = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (!strcmp(argv[i], "--frame-policy") && i + 1 < argc)
+		{
+			// Presets trading latency for throughput; image counts are clamped to what the surface supports
+			const char* policy = argv[++i];
+
+			if (!strcmp(policy, "low-latency"))
+			{
+				vk.frames_in_flight = 1;
+
+				vk.requested_swapchain_image_cnt = 1;
+
+				vk.preferred_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+			}
+			else if (!strcmp(policy, "balanced"))
+			{
+				vk.frames_in_flight = 2;
+
+				vk.requested_swapchain_image_cnt = 0;
+
+				vk.preferred_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+			}
+			else if (!strcmp(policy, "throughput"))
+			{
+				vk.frames_in_flight = 3;
+
+				vk.requested_swapchain_image_cnt = 4;
+
+				vk.preferred_present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			}
+			else
+				och::print("Ignoring unknown frame policy {}\n", policy);
+		}
+		else if (!strcmp(argv[i], "--instances") && i + 1 < argc)
+		{
+			std::vector<uint32_t> values;
+
+			if (och::parse_benchmark_list(argv[++i], values))
+				benchmark_sweep.instance_cnts = values;
+			else
+				och::print("Ignoring invalid instance counts {}\n", argv[i]);
+		}
+		else
+			och::print("Ignoring unknown argument {}\n", argv[i]);
+	}
 	
-	err_info err = vk.run();
+	if (vk.trace_path)
+		och::trace_begin();
 
-	if (err)
+	if (benchmark_name)
 	{
-		och::print("An Error occurred!\n");
+		// Animation advances by a fixed step, so every run renders the same sequence of frames
+		vk.fixed_timestep = 1.0F / 60.0F;
+
+		if (!vk.warmup_frame_cnt)
+			vk.warmup_frame_cnt = 100;
+
+		const uint32_t problem_cnt = run_benchmark(vk, benchmark_sweep, benchmark_name, benchmark_baseline, benchmark_threshold);
 
-		auto stack = och::get_stacktrace();
+		if (vk.trace_path && !och::trace_write(vk.trace_path))
+			och::print("Could not write trace to {}\n", vk.trace_path);
 
-		for (auto e : stack)
-			och::print("Function {} on Line {}: \"{}\"\n\n", e->function, e->line_num, e->call);
+		return problem_cnt ? 1 : 0;
 	}
+
+	err_info err = vk.run();
+
+	if (vk.trace_path && !och::trace_write(vk.trace_path))
+		och::print("Could not write trace to {}\n", vk.trace_path);
+
+	if (err)
+		print_error_stack();
 	else
 		och::print("\nProcess terminated successfully\n");
 }
@@ -2220,3 +6842,48 @@ void framebuffer_resize_callback_fn(GLFWwindow* window, int width, int height)
 
 	reinterpret_cast<hello_vulkan*>(glfwGetWindowUserPointer(window))->framebuffer_resized = true;
 }
+
+void key_callback_fn(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	scancode, mods;
+
+	if (action != GLFW_PRESS)
+		return;
+
+	hello_vulkan* vk = reinterpret_cast<hello_vulkan*>(glfwGetWindowUserPointer(window));
+
+	if (key == GLFW_KEY_P)
+		vk->profile_dump_requested = true;
+	else if (key == GLFW_KEY_M)
+	{
+		vk->msaa_sample_limit = vk->msaa_sample_limit >= 8 ? 1 : vk->msaa_sample_limit * 2;
+
+		vk->msaa_change_requested = true;
+	}
+	else if (key == GLFW_KEY_N)
+	{
+		vk->sample_shading = !vk->sample_shading;
+
+		vk->msaa_change_requested = true;
+	}
+	else if (key == GLFW_KEY_Z)
+	{
+		vk->depth_prepass = !vk->depth_prepass;
+
+		vk->msaa_change_requested = true;
+	}
+	else if (key == GLFW_KEY_B)
+		vk->cull_mode = vk->cull_mode == VK_CULL_MODE_NONE ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+	else if (key == GLFW_KEY_L)
+		vk->wireframe = !vk->wireframe;
+	else if (key == GLFW_KEY_T)
+		vk->depth_test = !vk->depth_test;
+	else if (key == GLFW_KEY_C)
+		vk->shader_features ^= och::shader_feature_vertex_colour;
+	else if (key == GLFW_KEY_U)
+		vk->shader_features ^= och::shader_feature_texture_coordinates;
+	else if (key == GLFW_KEY_F)
+		vk->next_frames_in_flight = vk->frames_in_flight % hello_vulkan::max_frames_in_flight + 1;
+	else if (key == GLFW_KEY_V)
+		vk->present_mode_change_requested = true;
+}
@@ -0,0 +1,246 @@
+#include "och_benchmark.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace och
+{
+	static constexpr const char* csv_header = "msaa_samples,present_mode,frames_in_flight,instance_cnt,frame_cnt,wall_ms,cpu_frame_p50_us,cpu_frame_p95_us,cpu_frame_p99_us,cpu_frame_max_us,gpu_frame_min_ms,gpu_frame_avg_ms,gpu_frame_p99_ms,present_latency_p50_us,present_latency_p99_us,first_present_ms";
+
+	static constexpr uint32_t csv_field_cnt = 16;
+
+	// Header of baselines written before first_present_ms, which lack the last field
+	static constexpr const char* legacy_csv_header = "msaa_samples,present_mode,frames_in_flight,instance_cnt,frame_cnt,wall_ms,cpu_frame_p50_us,cpu_frame_p95_us,cpu_frame_p99_us,cpu_frame_max_us,gpu_frame_min_ms,gpu_frame_avg_ms,gpu_frame_p99_ms,present_latency_p50_us,present_latency_p99_us";
+
+	static const char* present_mode_name(benchmark_present_mode mode) noexcept
+	{
+		return benchmark_present_mode_names[static_cast<uint32_t>(mode)];
+	}
+
+	static bool parse_present_mode(const char* beg, const char* end, benchmark_present_mode& out_mode) noexcept
+	{
+		for (uint32_t i = 0; i != static_cast<uint32_t>(benchmark_present_mode::cnt); ++i)
+			if (strlen(benchmark_present_mode_names[i]) == static_cast<size_t>(end - beg) && !strncmp(benchmark_present_mode_names[i], beg, end - beg))
+			{
+				out_mode = static_cast<benchmark_present_mode>(i);
+
+				return true;
+			}
+
+		return false;
+	}
+
+	std::vector<benchmark_config> benchmark_sweep::expand() const
+	{
+		std::vector<benchmark_config> configs;
+
+		for (uint32_t msaa : msaa_samples)
+			for (benchmark_present_mode present_mode : present_modes)
+				for (uint32_t frames : frames_in_flight)
+					for (uint32_t instances : instance_cnts)
+						configs.push_back({ msaa, present_mode, frames, instances });
+
+		return configs;
+	}
+
+	bool parse_benchmark_list(const char* str, std::vector<uint32_t>& out_values) noexcept
+	{
+		out_values.clear();
+
+		while (true)
+		{
+			char* end;
+
+			const unsigned long value = strtoul(str, &end, 10);
+
+			if (end == str || value == 0)
+				return false;
+
+			out_values.push_back(static_cast<uint32_t>(value));
+
+			if (*end == '\0')
+				return true;
+
+			if (*end != ',')
+				return false;
+
+			str = end + 1;
+		}
+	}
+
+	bool parse_benchmark_list(const char* str, std::vector<benchmark_present_mode>& out_values) noexcept
+	{
+		out_values.clear();
+
+		while (true)
+		{
+			const char* end = str;
+
+			while (*end != ',' && *end != '\0')
+				++end;
+
+			benchmark_present_mode mode;
+
+			if (!parse_present_mode(str, end, mode))
+				return false;
+
+			out_values.push_back(mode);
+
+			if (*end == '\0')
+				return true;
+
+			str = end + 1;
+		}
+	}
+
+	bool write_benchmark_csv(const char* filename, const std::vector<benchmark_result>& results) noexcept
+	{
+		std::ofstream out(filename);
+
+		if (!out)
+			return false;
+
+		out << csv_header << '\n';
+
+		for (const benchmark_result& r : results)
+			out << r.config.msaa_samples << ',' << present_mode_name(r.config.present_mode) << ',' << r.config.frames_in_flight << ',' << r.config.instance_cnt << ','
+				<< r.frame_cnt << ',' << r.wall_ms << ','
+				<< r.cpu_frame_p50_us << ',' << r.cpu_frame_p95_us << ',' << r.cpu_frame_p99_us << ',' << r.cpu_frame_max_us << ','
+				<< r.gpu_frame_min_ms << ',' << r.gpu_frame_avg_ms << ',' << r.gpu_frame_p99_ms << ','
+				<< r.present_latency_p50_us << ',' << r.present_latency_p99_us << ',' << r.first_present_ms << '\n';
+
+		return static_cast<bool>(out);
+	}
+
+	bool write_benchmark_json(const char* filename, const std::vector<benchmark_result>& results) noexcept
+	{
+		std::ofstream out(filename);
+
+		if (!out)
+			return false;
+
+		out << "{\"results\":[";
+
+		for (size_t i = 0; i != results.size(); ++i)
+		{
+			const benchmark_result& r = results[i];
+
+			out << (i ? ",\n" : "\n")
+				<< "{\"msaa_samples\":" << r.config.msaa_samples << ",\"present_mode\":\"" << present_mode_name(r.config.present_mode)
+				<< "\",\"frames_in_flight\":" << r.config.frames_in_flight << ",\"instance_cnt\":" << r.config.instance_cnt
+				<< ",\"frame_cnt\":" << r.frame_cnt << ",\"wall_ms\":" << r.wall_ms
+				<< ",\"cpu_frame_us\":{\"p50\":" << r.cpu_frame_p50_us << ",\"p95\":" << r.cpu_frame_p95_us << ",\"p99\":" << r.cpu_frame_p99_us << ",\"max\":" << r.cpu_frame_max_us
+				<< "},\"gpu_frame_ms\":{\"min\":" << r.gpu_frame_min_ms << ",\"avg\":" << r.gpu_frame_avg_ms << ",\"p99\":" << r.gpu_frame_p99_ms
+				<< "},\"present_latency_us\":{\"p50\":" << r.present_latency_p50_us << ",\"p99\":" << r.present_latency_p99_us << "},\"first_present_ms\":" << r.first_present_ms << '}';
+		}
+
+		out << "\n]}\n";
+
+		return static_cast<bool>(out);
+	}
+
+	bool read_benchmark_csv(const char* filename, std::vector<benchmark_result>& out_results) noexcept
+	{
+		out_results.clear();
+
+		std::ifstream file(filename);
+
+		if (!file)
+			return false;
+
+		std::string line;
+
+		if (!std::getline(file, line))
+			return false;
+
+		const bool is_legacy = line == legacy_csv_header;
+
+		if (!is_legacy && line != csv_header)
+			return false;
+
+		const uint32_t expected_field_cnt = is_legacy ? csv_field_cnt - 1 : csv_field_cnt;
+
+		while (std::getline(file, line))
+		{
+			if (line.empty())
+				continue;
+
+			const char* fields[csv_field_cnt];
+
+			uint32_t field_cnt = 0;
+
+			fields[field_cnt++] = line.c_str();
+
+			for (char& c : line)
+				if (c == ',')
+				{
+					if (field_cnt == expected_field_cnt)
+						return false;
+
+					c = '\0';
+
+					fields[field_cnt++] = &c + 1;
+				}
+
+			if (field_cnt != expected_field_cnt)
+				return false;
+
+			benchmark_result r{};
+
+			if (!parse_present_mode(fields[1], fields[1] + strlen(fields[1]), r.config.present_mode))
+				return false;
+
+			r.config.msaa_samples = static_cast<uint32_t>(strtoul(fields[0], nullptr, 10));
+			r.config.frames_in_flight = static_cast<uint32_t>(strtoul(fields[2], nullptr, 10));
+			r.config.instance_cnt = static_cast<uint32_t>(strtoul(fields[3], nullptr, 10));
+			r.frame_cnt = static_cast<uint32_t>(strtoul(fields[4], nullptr, 10));
+			r.wall_ms = strtof(fields[5], nullptr);
+			r.cpu_frame_p50_us = strtoull(fields[6], nullptr, 10);
+			r.cpu_frame_p95_us = strtoull(fields[7], nullptr, 10);
+			r.cpu_frame_p99_us = strtoull(fields[8], nullptr, 10);
+			r.cpu_frame_max_us = strtoull(fields[9], nullptr, 10);
+			r.gpu_frame_min_ms = strtof(fields[10], nullptr);
+			r.gpu_frame_avg_ms = strtof(fields[11], nullptr);
+			r.gpu_frame_p99_ms = strtof(fields[12], nullptr);
+			r.present_latency_p50_us = strtoull(fields[13], nullptr, 10);
+			r.present_latency_p99_us = strtoull(fields[14], nullptr, 10);
+			r.first_present_ms = is_legacy ? 0.0F : strtof(fields[15], nullptr);
+
+			out_results.push_back(r);
+		}
+
+		return true;
+	}
+
+	void compare_benchmark_results(const std::vector<benchmark_result>& baseline, const std::vector<benchmark_result>& current, float threshold_percent, std::vector<benchmark_regression>& out_regressions)
+	{
+		out_regressions.clear();
+
+		const double limit = 1.0 + threshold_percent / 100.0;
+
+		for (const benchmark_result& cur : current)
+			for (const benchmark_result& base : baseline)
+			{
+				if (!(cur.config == base.config))
+					continue;
+
+				const struct { const char* metric; double baseline; double current; } metrics[]{
+					{ "cpu_frame_p50_us", static_cast<double>(base.cpu_frame_p50_us), static_cast<double>(cur.cpu_frame_p50_us) },
+					{ "cpu_frame_p99_us", static_cast<double>(base.cpu_frame_p99_us), static_cast<double>(cur.cpu_frame_p99_us) },
+					{ "gpu_frame_avg_ms", base.gpu_frame_avg_ms, cur.gpu_frame_avg_ms },
+					{ "gpu_frame_p99_ms", base.gpu_frame_p99_ms, cur.gpu_frame_p99_ms },
+					{ "present_latency_p99_us", static_cast<double>(base.present_latency_p99_us), static_cast<double>(cur.present_latency_p99_us) },
+					{ "first_present_ms", base.first_present_ms, cur.first_present_ms },
+				};
+
+				// A zero baseline means the metric was not measured, e.g. without GPU timestamps
+				for (const auto& m : metrics)
+					if (m.baseline != 0.0 && m.current > m.baseline * limit)
+						out_regressions.push_back({ cur.config, m.metric, m.baseline, m.current });
+
+				break;
+			}
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace och
+{
+	enum class benchmark_present_mode : uint32_t
+	{
+		fifo,
+		mailbox,
+		immediate,
+		fifo_relaxed,
+		cnt,
+	};
+
+	inline constexpr const char* benchmark_present_mode_names[static_cast<uint32_t>(benchmark_present_mode::cnt)]{ "fifo", "mailbox", "immediate", "fifo_relaxed" };
+
+	struct benchmark_config
+	{
+		uint32_t msaa_samples;
+
+		benchmark_present_mode present_mode;
+
+		uint32_t frames_in_flight;
+
+		uint32_t instance_cnt;
+
+		bool operator==(const benchmark_config& rhs) const noexcept = default;
+	};
+
+	// CPU times come from the frame histogram in microseconds, GPU times from the render pass timestamps in milliseconds.
+	// GPU fields stay 0 if the device has no timestamp support, latency fields in headless runs.
+	struct benchmark_result
+	{
+		benchmark_config config;
+
+		uint32_t frame_cnt;
+
+		float wall_ms;
+
+		uint64_t cpu_frame_p50_us;
+
+		uint64_t cpu_frame_p95_us;
+
+		uint64_t cpu_frame_p99_us;
+
+		uint64_t cpu_frame_max_us;
+
+		float gpu_frame_min_ms;
+
+		float gpu_frame_avg_ms;
+
+		float gpu_frame_p99_ms;
+
+		uint64_t present_latency_p50_us;
+
+		uint64_t present_latency_p99_us;
+
+		// From hello_vulkan::run until the first warm-up frame was presented, or submitted in headless runs
+		float first_present_ms;
+	};
+
+	struct benchmark_regression
+	{
+		benchmark_config config;
+
+		const char* metric;
+
+		double baseline;
+
+		double current;
+	};
+
+	// Every list holds the values swept for one parameter; the sweep is their cartesian product
+	struct benchmark_sweep
+	{
+		std::vector<uint32_t> msaa_samples{ 1 };
+
+		std::vector<benchmark_present_mode> present_modes{ benchmark_present_mode::fifo };
+
+		std::vector<uint32_t> frames_in_flight{ 2 };
+
+		std::vector<uint32_t> instance_cnts{ 1 };
+
+		std::vector<benchmark_config> expand() const;
+	};
+
+	// Parses a comma separated list such as "1,2,4"
+	bool parse_benchmark_list(const char* str, std::vector<uint32_t>& out_values) noexcept;
+
+	// Parses a comma separated list of benchmark_present_mode_names
+	bool parse_benchmark_list(const char* str, std::vector<benchmark_present_mode>& out_values) noexcept;
+
+	bool write_benchmark_csv(const char* filename, const std::vector<benchmark_result>& results) noexcept;
+
+	bool write_benchmark_json(const char* filename, const std::vector<benchmark_result>& results) noexcept;
+
+	// Reads a file written by write_benchmark_csv. Files from before first_present_ms was recorded read it as 0.
+	bool read_benchmark_csv(const char* filename, std::vector<benchmark_result>& out_results) noexcept;
+
+	// Reports every metric that got slower than the baseline by more than threshold_percent.
+	// Configurations missing from the baseline are skipped.
+	void compare_benchmark_results(const std::vector<benchmark_result>& baseline, const std::vector<benchmark_result>& current, float threshold_percent, std::vector<benchmark_regression>& out_regressions);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <bit>
+
+// Log-linear histogram in the style of HdrHistogram. Every power of two is split into
+// sub_bucket_cnt equally sized buckets, so any recorded value is off by at most 1/sub_bucket_cnt.
+// Recording is lock-free and safe from any thread. It takes two relaxed atomic increments, plus a compare-exchange
+// loop on the maximum that only runs while the value exceeds it.
+struct latency_histogram
+{
+	static constexpr uint32_t sub_bucket_bits = 5;
+
+	static constexpr uint32_t sub_bucket_cnt = 1 << sub_bucket_bits;
+
+	static constexpr uint32_t bucket_cnt = (65 - sub_bucket_bits) * sub_bucket_cnt;
+
+	std::atomic<uint64_t> counts[bucket_cnt]{};
+
+	std::atomic<uint64_t> total_cnt = 0;
+
+	std::atomic<uint64_t> max_value = 0;
+
+	static uint32_t bucket_idx(uint64_t value) noexcept
+	{
+		if (value < sub_bucket_cnt)
+			return static_cast<uint32_t>(value);
+
+		const uint32_t shift = static_cast<uint32_t>(std::bit_width(value)) - 1 - sub_bucket_bits;
+
+		return (shift + 1) * sub_bucket_cnt + static_cast<uint32_t>((value >> shift) - sub_bucket_cnt);
+	}
+
+	// Smallest value that lands in the given bucket
+	static uint64_t bucket_value(uint32_t idx) noexcept
+	{
+		if (idx < 2 * sub_bucket_cnt)
+			return idx;
+
+		const uint32_t shift = idx / sub_bucket_cnt - 1;
+
+		return static_cast<uint64_t>(idx % sub_bucket_cnt + sub_bucket_cnt) << shift;
+	}
+
+	void record(uint64_t value) noexcept
+	{
+		counts[bucket_idx(value)].fetch_add(1, std::memory_order_relaxed);
+
+		total_cnt.fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t prev_max = max_value.load(std::memory_order_relaxed);
+
+		while (prev_max < value && !max_value.compare_exchange_weak(prev_max, value, std::memory_order_relaxed));
+	}
+
+	// Highest value equivalent to the one at the given percentile, clamped to the recorded maximum
+	uint64_t percentile(double p) const noexcept
+	{
+		const uint64_t total = total_cnt.load(std::memory_order_relaxed);
+
+		if (!total)
+			return 0;
+
+		uint64_t target = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+
+		if (target == 0)
+			target = 1;
+
+		uint64_t seen = 0;
+
+		for (uint32_t i = 0; i != bucket_cnt; ++i)
+		{
+			seen += counts[i].load(std::memory_order_relaxed);
+
+			if (seen >= target)
+			{
+				const uint64_t max = max_value.load(std::memory_order_relaxed);
+
+				const uint64_t upper = i + 1 == bucket_cnt ? max : bucket_value(i + 1) - 1;
+
+				return upper < max ? upper : max;
+			}
+		}
+
+		return max_value.load(std::memory_order_relaxed);
+	}
+
+	void reset() noexcept
+	{
+		for (auto& count : counts)
+			count.store(0, std::memory_order_relaxed);
+
+		total_cnt.store(0, std::memory_order_relaxed);
+
+		max_value.store(0, std::memory_order_relaxed);
+	}
+};
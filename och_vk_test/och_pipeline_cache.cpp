@@ -0,0 +1,269 @@
+#include "och_pipeline_cache.h"
+
+#include <algorithm>
+
+#include "och_trace.h"
+
+namespace och
+{
+	size_t pipeline_variant_hash::operator()(const pipeline_variant& variant) const noexcept
+	{
+		// FNV-1a
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&variant);
+
+		uint64_t hash = 0xCBF2'9CE4'8422'2325;
+
+		for (size_t i = 0; i != sizeof(variant); ++i)
+			hash = (hash ^ bytes[i]) * 0x0000'0100'0000'01B3;
+
+		return static_cast<size_t>(hash);
+	}
+
+	static uint32_t differing_field_cnt(const pipeline_variant& a, const pipeline_variant& b) noexcept
+	{
+		return (a.cull_mode != b.cull_mode) + (a.polygon_mode != b.polygon_mode) + (a.depth_compare_op != b.depth_compare_op) + (a.shader_features != b.shader_features)
+			+ (a.sample_shading != b.sample_shading) + (a.depth_test != b.depth_test);
+	}
+
+	void pipeline_variant_cache::start(VkDevice dev, uint32_t worker_cnt, build_fn fn)
+	{
+		device = dev;
+
+		build = std::move(fn);
+
+		is_stopping = false;
+
+		for (uint32_t i = 0; i != worker_cnt; ++i)
+			workers.emplace_back(&pipeline_variant_cache::worker_fn, this);
+	}
+
+	void pipeline_variant_cache::stop() noexcept
+	{
+		{
+			std::lock_guard lock(mutex);
+
+			is_stopping = true;
+
+			queue.clear();
+		}
+
+		queued_cv.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		workers.clear();
+
+		// Without a device nothing was ever built
+		if (device)
+		{
+			for (auto& [variant, entry] : entries)
+			{
+				vkDestroyPipeline(device, entry.pipelines.pipeline, nullptr);
+
+				vkDestroyPipeline(device, entry.pipelines.depth_prepass_pipeline, nullptr);
+			}
+
+			for (VkPipeline pipeline : retired)
+				vkDestroyPipeline(device, pipeline, nullptr);
+		}
+
+		entries.clear();
+
+		retired.clear();
+
+		device = nullptr;
+	}
+
+	void pipeline_variant_cache::request(const pipeline_variant& variant, bool is_urgent)
+	{
+		{
+			std::lock_guard lock(mutex);
+
+			request_locked(variant, is_urgent);
+		}
+
+		queued_cv.notify_one();
+	}
+
+	pipeline_variant_cache::lookup_result pipeline_variant_cache::lookup(const pipeline_variant& variant, pipeline_pair& out)
+	{
+		std::unique_lock lock(mutex);
+
+		auto it = entries.find(variant);
+
+		if (it != entries.end() && it->second.pipelines.pipeline)
+		{
+			out = it->second.pipelines;
+
+			return lookup_result::exact;
+		}
+
+		request_locked(variant, true);
+
+		uint32_t best_difference = ~0u;
+
+		for (const auto& [candidate, entry] : entries)
+		{
+			if (!entry.pipelines.pipeline || !candidate.is_compatible(variant))
+				continue;
+
+			const uint32_t difference = differing_field_cnt(candidate, variant);
+
+			if (difference < best_difference)
+			{
+				best_difference = difference;
+
+				out = entry.pipelines;
+			}
+		}
+
+		if (best_difference != ~0u)
+			++fallback_cnt;
+
+		lock.unlock();
+
+		queued_cv.notify_one();
+
+		return best_difference == ~0u ? lookup_result::missing : lookup_result::fallback;
+	}
+
+	bool pipeline_variant_cache::wait(const pipeline_variant& variant, pipeline_pair& out)
+	{
+		OCH_ZONE(__FUNCTION__);
+
+		std::unique_lock lock(mutex);
+
+		request_locked(variant, true);
+
+		queued_cv.notify_one();
+
+		const entry& e = entries[variant];
+
+		built_cv.wait(lock, [&]() { return e.pipelines.pipeline || e.has_failed || is_stopping; });
+
+		out = e.pipelines;
+
+		return out.pipeline != nullptr;
+	}
+
+	void pipeline_variant_cache::invalidate()
+	{
+		{
+			std::lock_guard lock(mutex);
+
+			++generation;
+
+			for (auto& [variant, entry] : entries)
+				request_locked(variant, false);
+		}
+
+		queued_cv.notify_all();
+	}
+
+	void pipeline_variant_cache::collect_retired(std::vector<VkPipeline>& out)
+	{
+		std::lock_guard lock(mutex);
+
+		out.insert(out.end(), retired.begin(), retired.end());
+
+		retired.clear();
+	}
+
+	void pipeline_variant_cache::request_locked(const pipeline_variant& variant, bool is_urgent)
+	{
+		entry& e = entries[variant];
+
+		const bool is_current = e.pipelines.pipeline && e.generation == generation;
+
+		if (is_current)
+			return;
+
+		if (e.is_queued)
+		{
+			if (!is_urgent)
+				return;
+
+			// Moves it to the front
+			queue.erase(std::find(queue.begin(), queue.end(), variant));
+		}
+		else if (e.has_failed && e.generation == generation)
+		{
+			// Only retried once shaders changed
+			return;
+		}
+
+		e.is_queued = true;
+
+		if (is_urgent)
+			queue.push_front(variant);
+		else
+			queue.push_back(variant);
+	}
+
+	void pipeline_variant_cache::worker_fn()
+	{
+		trace_set_thread_name("pipeline worker");
+
+		std::unique_lock lock(mutex);
+
+		while (true)
+		{
+			queued_cv.wait(lock, [&]() { return is_stopping || !queue.empty(); });
+
+			if (is_stopping)
+				return;
+
+			const pipeline_variant variant = queue.front();
+
+			queue.pop_front();
+
+			entries[variant].is_queued = false;
+
+			const uint64_t build_generation = generation;
+
+			lock.unlock();
+
+			pipeline_pair pipelines;
+
+			const bool is_built = build(variant, pipelines);
+
+			lock.lock();
+
+			entry& e = entries[variant];
+
+			// A worker that picked the variant up again after an invalidate may have finished first
+			if (is_built && build_generation >= e.generation)
+			{
+				if (e.pipelines.pipeline)
+					retired.push_back(e.pipelines.pipeline);
+
+				if (e.pipelines.depth_prepass_pipeline)
+					retired.push_back(e.pipelines.depth_prepass_pipeline);
+
+				e.pipelines = pipelines;
+
+				e.generation = build_generation;
+
+				e.has_failed = false;
+
+				++built_cnt;
+			}
+			else if (is_built)
+			{
+				retired.push_back(pipelines.pipeline);
+
+				if (pipelines.depth_prepass_pipeline)
+					retired.push_back(pipelines.depth_prepass_pipeline);
+			}
+			else if (build_generation >= e.generation)
+			{
+				e.generation = build_generation;
+
+				e.has_failed = true;
+			}
+
+			built_cv.notify_all();
+		}
+	}
+}
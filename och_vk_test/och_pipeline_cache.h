@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+#include <vulkan/vulkan.h>
+
+namespace och
+{
+	// Bits of pipeline_variant::shader_features, passed to shader.frag as boolean specialization constants starting at id 8
+	inline constexpr uint32_t shader_feature_vertex_colour = 1;
+
+	inline constexpr uint32_t shader_feature_texture_coordinates = 2;
+
+	inline constexpr uint32_t shader_feature_cnt = 2;
+
+	// Full description of a scene pipeline, hashed byte by byte. colour_format, msaa_samples and depth_prepass determine the
+	// render pass a variant is compatible with, and feedback_width the virtual texture feedback buffer it writes to.
+	struct pipeline_variant
+	{
+		VkFormat colour_format = VK_FORMAT_UNDEFINED;
+
+		VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+
+		VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+
+		VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS;
+
+		uint32_t shader_features = 0;
+
+		uint32_t feedback_width = 0;
+
+		bool sample_shading = false;
+
+		bool depth_prepass = false;
+
+		bool depth_test = true;
+
+		bool reserved = false;
+
+		bool operator==(const pipeline_variant&) const noexcept = default;
+
+		bool is_compatible(const pipeline_variant& other) const noexcept
+		{
+			return colour_format == other.colour_format && msaa_samples == other.msaa_samples && depth_prepass == other.depth_prepass && feedback_width == other.feedback_width;
+		}
+	};
+
+	static_assert(std::has_unique_object_representations_v<pipeline_variant>, "pipeline_variant must not contain padding, as it is hashed byte by byte");
+
+	struct pipeline_variant_hash
+	{
+		size_t operator()(const pipeline_variant& variant) const noexcept;
+	};
+
+	// The depth pre-pass pipeline is null for variants without one
+	struct pipeline_pair
+	{
+		VkPipeline pipeline = nullptr;
+
+		VkPipeline depth_prepass_pipeline = nullptr;
+
+		bool operator==(const pipeline_pair&) const noexcept = default;
+	};
+
+	// Builds pipeline variants on a pool of worker threads and keeps them by a hash of their description.
+	// lookup never blocks: a variant that is not built yet is queued, and a ready variant compatible with it is returned instead.
+	// invalidate rebuilds every variant, which keeps its previous pipelines until then. Replaced pipelines are handed out by collect_retired.
+	struct pipeline_variant_cache
+	{
+		enum class lookup_result
+		{
+			exact,
+			fallback,
+			missing,
+		};
+
+		// Runs on a worker thread. Returns false if the variant could not be built.
+		using build_fn = std::function<bool(const pipeline_variant&, pipeline_pair&)>;
+
+		struct entry
+		{
+			pipeline_pair pipelines;
+
+			// Value of generation when the variant was last built, or failed to build
+			uint64_t generation = 0;
+
+			bool is_queued = false;
+
+			bool has_failed = false;
+		};
+
+		VkDevice device = nullptr;
+
+		build_fn build;
+
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+
+		// Wakes workers when variants are queued or the cache stops
+		std::condition_variable queued_cv;
+
+		// Wakes wait when a build finished
+		std::condition_variable built_cv;
+
+		std::unordered_map<pipeline_variant, entry, pipeline_variant_hash> entries;
+
+		std::deque<pipeline_variant> queue;
+
+		std::vector<VkPipeline> retired;
+
+		uint64_t generation = 0;
+
+		bool is_stopping = false;
+
+		uint64_t built_cnt = 0;
+
+		// Lookups answered with a compatible variant instead of the requested one
+		uint64_t fallback_cnt = 0;
+
+		pipeline_variant_cache() noexcept = default;
+
+		pipeline_variant_cache(const pipeline_variant_cache&) = delete;
+
+		// Joins workers left running if stop was skipped. Pipelines still held then need the device to be alive.
+		~pipeline_variant_cache() { stop(); }
+
+		void start(VkDevice dev, uint32_t worker_cnt, build_fn fn);
+
+		// Joins the workers and destroys every pipeline, so the device must be idle. Does nothing once stopped, or if never started.
+		void stop() noexcept;
+
+		// Queues variant unless it is built or queued already. Urgent requests are built before all others.
+		void request(const pipeline_variant& variant, bool is_urgent = false);
+
+		// Fills out with variant's pipelines if they are ready. Otherwise requests variant urgently and fills out with the ready variant
+		// compatible with it that differs in the fewest fields, if there is one.
+		lookup_result lookup(const pipeline_variant& variant, pipeline_pair& out);
+
+		// Blocks until variant is built, building it first. Returns false if that failed.
+		bool wait(const pipeline_variant& variant, pipeline_pair& out);
+
+		void invalidate();
+
+		// Moves out pipelines that were replaced by a rebuild. The caller destroys them once no submitted frame uses them.
+		void collect_retired(std::vector<VkPipeline>& out);
+
+		void worker_fn();
+
+		void request_locked(const pipeline_variant& variant, bool is_urgent);
+	};
+}
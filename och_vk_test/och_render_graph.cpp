@@ -0,0 +1,357 @@
+#include "och_render_graph.h"
+
+#include <algorithm>
+
+namespace och
+{
+	// Synchronization state of a piece of memory: its last write and the reads since then
+	struct rg_slot_state
+	{
+		VkPipelineStageFlags write_stages;
+
+		VkAccessFlags write_access;
+
+		VkPipelineStageFlags read_stages;
+
+		// Where the last write has been made visible already
+		VkPipelineStageFlags visible_stages;
+
+		VkAccessFlags visible_access;
+	};
+
+	struct rg_barrier_batch
+	{
+		VkPipelineStageFlags src_stages = 0;
+
+		VkPipelineStageFlags dst_stages = 0;
+
+		VkAccessFlags src_access = 0;
+
+		VkAccessFlags dst_access = 0;
+
+		std::vector<VkImageMemoryBarrier> image_barriers;
+
+		bool is_empty() const noexcept
+		{
+			return !src_stages && !dst_stages && image_barriers.empty();
+		}
+
+		void record(VkCommandBuffer cmd) const
+		{
+			if (is_empty())
+				return;
+
+			VkMemoryBarrier memory_barrier{};
+			memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memory_barrier.srcAccessMask = src_access;
+			memory_barrier.dstAccessMask = dst_access;
+
+			const uint32_t memory_barrier_cnt = src_access || dst_access ? 1 : 0;
+
+			vkCmdPipelineBarrier(cmd, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				memory_barrier_cnt, &memory_barrier, 0, nullptr, static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+		}
+	};
+
+	// Adds whatever makes usage safe after the slot's previous accesses to the batch and advances slot and layout past it
+	static void rg_transition(const render_graph::resource& r, const rg_usage& usage, rg_slot_state& slot, VkImageLayout& layout, rg_barrier_batch& batch)
+	{
+		const bool needs_layout = r.is_image && usage.layout != VK_IMAGE_LAYOUT_UNDEFINED && usage.layout != layout;
+
+		if (needs_layout)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = slot.write_access;
+			barrier.dstAccessMask = usage.access;
+			barrier.oldLayout = layout;
+			barrier.newLayout = usage.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = r.image;
+			barrier.subresourceRange = { r.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+			batch.image_barriers.push_back(barrier);
+
+			batch.src_stages |= slot.write_stages | slot.read_stages;
+
+			batch.dst_stages |= usage.stages;
+
+			// The transition itself counts as a write, which is visible to this usage's scope only
+			if (usage.is_write)
+				slot = { usage.stages, usage.access, 0, 0, 0 };
+			else
+				slot = { usage.stages, 0, usage.stages, usage.stages, usage.access };
+		}
+		else if (usage.is_write)
+		{
+			// Write-after-write needs the earlier write made available, write-after-read only an execution dependency
+			if (slot.write_stages || slot.read_stages)
+			{
+				batch.src_stages |= slot.write_stages | slot.read_stages;
+
+				batch.dst_stages |= usage.stages;
+
+				batch.src_access |= slot.write_access;
+
+				if (slot.write_access)
+					batch.dst_access |= usage.access;
+			}
+
+			slot = { usage.stages, usage.access, 0, 0, 0 };
+		}
+		else
+		{
+			if (slot.write_stages && usage.access && ((usage.stages & ~slot.visible_stages) || (usage.access & ~slot.visible_access)))
+			{
+				batch.src_stages |= slot.write_stages;
+
+				batch.dst_stages |= usage.stages;
+
+				batch.src_access |= slot.write_access;
+
+				batch.dst_access |= usage.access;
+
+				slot.visible_stages |= usage.stages;
+
+				slot.visible_access |= usage.access;
+			}
+
+			slot.read_stages |= usage.stages;
+		}
+
+		if (r.is_image)
+			layout = usage.layout_after;
+	}
+
+	uint32_t render_graph::import_image(const char* name, VkImage image, VkImageAspectFlags aspect, const rg_usage& initial_state)
+	{
+		resources.push_back({ name, image, aspect, initial_state, {}, true, false, false, 0, no_block, ~0u, 0 });
+
+		return static_cast<uint32_t>(resources.size() - 1);
+	}
+
+	uint32_t render_graph::import_buffer(const char* name, const rg_usage& initial_state)
+	{
+		resources.push_back({ name, nullptr, 0, initial_state, {}, false, false, false, 0, no_block, ~0u, 0 });
+
+		return static_cast<uint32_t>(resources.size() - 1);
+	}
+
+	uint32_t render_graph::create_transient_image(const char* name, VkImage image, VkImageAspectFlags aspect, uint32_t alias_class)
+	{
+		resources.push_back({ name, image, aspect, {}, {}, true, true, false, alias_class, no_block, ~0u, 0 });
+
+		return static_cast<uint32_t>(resources.size() - 1);
+	}
+
+	uint32_t render_graph::add_pass(const char* name, record_fn record)
+	{
+		passes.push_back({ name, std::move(record), {}, false });
+
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	void render_graph::use(uint32_t pass_idx, uint32_t resource_idx, const rg_usage& usage)
+	{
+		passes[pass_idx].uses.push_back({ resource_idx, usage });
+	}
+
+	void render_graph::set_output(uint32_t resource_idx, const rg_usage& final_usage)
+	{
+		resources[resource_idx].is_output = true;
+
+		resources[resource_idx].final_usage = final_usage;
+	}
+
+	void render_graph::compile()
+	{
+		// Walking backwards, a resource is needed while its current contents are still consumed later on
+		std::vector<bool> is_needed(resources.size());
+
+		for (size_t i = 0; i != resources.size(); ++i)
+			is_needed[i] = resources[i].is_output;
+
+		for (size_t p = passes.size(); p-- != 0;)
+		{
+			pass& curr = passes[p];
+
+			curr.is_live = std::any_of(curr.uses.begin(), curr.uses.end(), [&](const resource_use& u) { return u.usage.is_write && is_needed[u.resource_idx]; });
+
+			if (!curr.is_live)
+				continue;
+
+			// Images written from UNDEFINED do not depend on earlier writers, everything else may only be partially overwritten
+			for (const resource_use& u : curr.uses)
+				if (u.usage.is_write && resources[u.resource_idx].is_image && u.usage.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+					is_needed[u.resource_idx] = false;
+
+			for (const resource_use& u : curr.uses)
+				if (!u.usage.is_write)
+					is_needed[u.resource_idx] = true;
+		}
+
+		for (resource& r : resources)
+		{
+			r.first_pass = ~0u;
+
+			r.last_pass = 0;
+		}
+
+		for (uint32_t p = 0; p != passes.size(); ++p)
+		{
+			if (!passes[p].is_live)
+				continue;
+
+			for (const resource_use& u : passes[p].uses)
+			{
+				resource& r = resources[u.resource_idx];
+
+				r.first_pass = std::min(r.first_pass, p);
+
+				r.last_pass = std::max(r.last_pass, p);
+			}
+		}
+	}
+
+	void render_graph::plan_aliasing(const VkMemoryRequirements* reqs, std::vector<rg_memory_block>& out_blocks, std::vector<uint32_t>& out_block_idxs) const
+	{
+		out_blocks.clear();
+
+		out_block_idxs.assign(resources.size(), no_block);
+
+		std::vector<uint32_t> order;
+
+		for (uint32_t i = 0; i != resources.size(); ++i)
+			if (resources[i].is_transient && resources[i].first_pass <= resources[i].last_pass)
+				order.push_back(i);
+
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return reqs[a].size > reqs[b].size; });
+
+		std::vector<std::vector<uint32_t>> block_members;
+
+		for (uint32_t i : order)
+		{
+			const resource& r = resources[i];
+
+			uint32_t block_idx = no_block;
+
+			for (uint32_t b = 0; b != out_blocks.size() && block_idx == no_block; ++b)
+			{
+				if (out_blocks[b].alias_class != r.alias_class || !(out_blocks[b].memory_type_bits & reqs[i].memoryTypeBits))
+					continue;
+
+				const bool overlaps = std::any_of(block_members[b].begin(), block_members[b].end(), [&](uint32_t m) { return resources[m].first_pass <= r.last_pass && r.first_pass <= resources[m].last_pass; });
+
+				if (!overlaps)
+					block_idx = b;
+			}
+
+			if (block_idx == no_block)
+			{
+				block_idx = static_cast<uint32_t>(out_blocks.size());
+
+				out_blocks.push_back({ 0, ~0u, r.alias_class });
+
+				block_members.emplace_back();
+			}
+
+			out_blocks[block_idx].size = std::max(out_blocks[block_idx].size, reqs[i].size);
+
+			out_blocks[block_idx].memory_type_bits &= reqs[i].memoryTypeBits;
+
+			block_members[block_idx].push_back(i);
+
+			out_block_idxs[i] = block_idx;
+		}
+	}
+
+	void render_graph::set_aliasing(const std::vector<uint32_t>& block_idxs)
+	{
+		for (size_t i = 0; i != resources.size() && i != block_idxs.size(); ++i)
+			resources[i].block_idx = block_idxs[i];
+	}
+
+	void render_graph::record(VkCommandBuffer cmd) const
+	{
+		// Images sharing a block share one slot, so taking over the memory waits for the previous occupant
+		std::vector<uint32_t> slot_idxs(resources.size());
+
+		uint32_t slot_cnt = static_cast<uint32_t>(resources.size());
+
+		uint32_t block_cnt = 0;
+
+		for (const resource& r : resources)
+			if (r.block_idx != no_block)
+				block_cnt = std::max(block_cnt, r.block_idx + 1);
+
+		for (uint32_t i = 0; i != resources.size(); ++i)
+			slot_idxs[i] = resources[i].block_idx != no_block ? slot_cnt + resources[i].block_idx : i;
+
+		std::vector<rg_slot_state> slots(slot_cnt + block_cnt);
+
+		std::vector<VkImageLayout> layouts(resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+
+		for (uint32_t i = 0; i != resources.size(); ++i)
+		{
+			const resource& r = resources[i];
+
+			if (r.is_transient)
+				continue;
+
+			const rg_usage& s = r.initial_state;
+
+			slots[slot_idxs[i]] = s.is_write ? rg_slot_state{ s.stages, s.access, 0, 0, 0 } : rg_slot_state{ 0, 0, s.stages, 0, 0 };
+
+			layouts[i] = s.layout;
+		}
+
+		// Transient memory may still be in use by the previous frame, which is assumed to have touched it in every way this one does
+		for (const pass& p : passes)
+		{
+			if (!p.is_live)
+				continue;
+
+			for (const resource_use& u : p.uses)
+			{
+				if (!resources[u.resource_idx].is_transient)
+					continue;
+
+				rg_slot_state& slot = slots[slot_idxs[u.resource_idx]];
+
+				slot.write_stages |= u.usage.stages;
+
+				if (u.usage.is_write)
+					slot.write_access |= u.usage.access;
+			}
+		}
+
+		for (const pass& p : passes)
+		{
+			if (!p.is_live)
+				continue;
+
+			rg_barrier_batch batch;
+
+			for (const resource_use& u : p.uses)
+				rg_transition(resources[u.resource_idx], u.usage, slots[slot_idxs[u.resource_idx]], layouts[u.resource_idx], batch);
+
+			batch.record(cmd);
+
+			p.record(cmd);
+		}
+
+		rg_barrier_batch final_batch;
+
+		for (uint32_t i = 0; i != resources.size(); ++i)
+			if (resources[i].is_output)
+				rg_transition(resources[i], resources[i].final_usage, slots[slot_idxs[i]], layouts[i], final_batch);
+
+		final_batch.record(cmd);
+	}
+
+	uint32_t render_graph::live_pass_cnt() const noexcept
+	{
+		return static_cast<uint32_t>(std::count_if(passes.begin(), passes.end(), [](const pass& p) { return p.is_live; }));
+	}
+}
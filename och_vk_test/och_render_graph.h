@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include <vulkan/vulkan.h>
+
+namespace och
+{
+	// How a pass touches a resource. layout is what the pass expects on entry, UNDEFINED if it discards the contents,
+	// and layout_after what it leaves behind. The two differ for attachments a render pass transitions itself.
+	struct rg_usage
+	{
+		VkPipelineStageFlags stages;
+
+		VkAccessFlags access;
+
+		VkImageLayout layout;
+
+		VkImageLayout layout_after;
+
+		bool is_write;
+	};
+
+	inline constexpr rg_usage rg_transfer_src{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+
+	inline constexpr rg_usage rg_transfer_dst{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+
+	inline constexpr rg_usage rg_fragment_shader_write{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, true };
+
+	inline constexpr rg_usage rg_host_read{ VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, false };
+
+	inline constexpr rg_usage rg_present{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+
+	// Initial state of a swapchain image whose acquire semaphore is waited on at the colour attachment output stage
+	inline constexpr rg_usage rg_acquired{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, false };
+
+	// Cleared by a render pass starting from UNDEFINED and left in final_layout
+	constexpr rg_usage rg_colour_attachment(VkImageLayout final_layout) noexcept
+	{
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, final_layout, true };
+	}
+
+	constexpr rg_usage rg_depth_attachment(VkImageLayout final_layout) noexcept
+	{
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, final_layout, true };
+	}
+
+	// Memory shared by transient images whose lifetimes do not overlap. Every image is bound at offset 0.
+	struct rg_memory_block
+	{
+		VkDeviceSize size;
+
+		uint32_t memory_type_bits;
+
+		uint32_t alias_class;
+	};
+
+	// Describes one frame as passes in submission order, each declaring the resources it uses.
+	// Barriers and layout transitions are derived from these declarations, so pass callbacks only record their own work.
+	struct render_graph
+	{
+		using record_fn = std::function<void(VkCommandBuffer)>;
+
+		static constexpr uint32_t no_block = ~0u;
+
+		struct resource
+		{
+			const char* name;
+
+			VkImage image;
+
+			VkImageAspectFlags aspect;
+
+			rg_usage initial_state;
+
+			rg_usage final_usage;
+
+			bool is_image;
+
+			bool is_transient;
+
+			bool is_output;
+
+			// Only transient images in the same class share memory, e.g. to keep lazily allocated attachments apart from the rest
+			uint32_t alias_class;
+
+			uint32_t block_idx;
+
+			// Live pass indices of the first and last use; first_pass > last_pass if there is none
+			uint32_t first_pass;
+
+			uint32_t last_pass;
+		};
+
+		struct resource_use
+		{
+			uint32_t resource_idx;
+
+			rg_usage usage;
+		};
+
+		struct pass
+		{
+			const char* name;
+
+			record_fn record;
+
+			std::vector<resource_use> uses;
+
+			bool is_live;
+		};
+
+		std::vector<resource> resources;
+
+		std::vector<pass> passes;
+
+		uint32_t import_image(const char* name, VkImage image, VkImageAspectFlags aspect, const rg_usage& initial_state);
+
+		uint32_t import_buffer(const char* name, const rg_usage& initial_state);
+
+		// Contents of transient images do not survive the frame, so every frame starts them from UNDEFINED
+		uint32_t create_transient_image(const char* name, VkImage image, VkImageAspectFlags aspect, uint32_t alias_class);
+
+		uint32_t add_pass(const char* name, record_fn record);
+
+		void use(uint32_t pass_idx, uint32_t resource_idx, const rg_usage& usage);
+
+		// Outputs are what keeps passes alive. final_usage is applied after the last pass.
+		void set_output(uint32_t resource_idx, const rg_usage& final_usage);
+
+		// Culls passes none of whose writes reach an output and computes the lifetimes of transient images
+		void compile();
+
+		// Packs the live transient images into blocks, largest first, given memory requirements indexed by resource.
+		// out_block_idxs is indexed by resource as well and holds no_block for everything that needs no memory.
+		void plan_aliasing(const VkMemoryRequirements* reqs, std::vector<rg_memory_block>& out_blocks, std::vector<uint32_t>& out_block_idxs) const;
+
+		// Makes barriers account for images taking over a block from earlier ones. Expects the output of plan_aliasing.
+		void set_aliasing(const std::vector<uint32_t>& block_idxs);
+
+		// Records every live pass preceded by one batched pipeline barrier, then moves the outputs to their final usage
+		void record(VkCommandBuffer cmd) const;
+
+		uint32_t live_pass_cnt() const noexcept;
+	};
+}
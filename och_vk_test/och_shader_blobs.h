@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace och
+{
+	// SPIR-V embedded at build time. The pre-build step (see shaders/compile_shaders.bat) has glslc write every shader
+	// as comma separated words to shaders/<name>.spv.inc. As uint32_t arrays they meet the alignment VkShaderModuleCreateInfo::pCode requires.
+	namespace spirv
+	{
+		inline constexpr uint32_t vert[]{
+#include "shaders/vert.spv.inc"
+		};
+
+		inline constexpr uint32_t depth_vert[]{
+#include "shaders/depth_vert.spv.inc"
+		};
+
+		inline constexpr uint32_t frag[]{
+#include "shaders/frag.spv.inc"
+		};
+
+		inline constexpr uint32_t frag_vt[]{
+#include "shaders/frag_vt.spv.inc"
+		};
+
+		inline constexpr uint32_t frag_bindless[]{
+#include "shaders/frag_bindless.spv.inc"
+		};
+
+		inline constexpr uint32_t downsample_comp[]{
+#include "shaders/downsample_comp.spv.inc"
+		};
+	}
+
+	struct shader_blob
+	{
+		// Name of the SPIR-V file glslc would write, which shader hot reload still does
+		std::string_view name;
+
+		const uint32_t* words;
+
+		size_t word_cnt;
+
+		constexpr size_t bytes() const noexcept
+		{
+			return word_cnt * sizeof(uint32_t);
+		}
+	};
+
+	inline constexpr shader_blob shader_blobs[]{
+		{ "vert.spv", spirv::vert, sizeof(spirv::vert) / sizeof(*spirv::vert) },
+		{ "depth_vert.spv", spirv::depth_vert, sizeof(spirv::depth_vert) / sizeof(*spirv::depth_vert) },
+		{ "frag.spv", spirv::frag, sizeof(spirv::frag) / sizeof(*spirv::frag) },
+		{ "frag_vt.spv", spirv::frag_vt, sizeof(spirv::frag_vt) / sizeof(*spirv::frag_vt) },
+		{ "frag_bindless.spv", spirv::frag_bindless, sizeof(spirv::frag_bindless) / sizeof(*spirv::frag_bindless) },
+		{ "downsample_comp.spv", spirv::downsample_comp, sizeof(spirv::downsample_comp) / sizeof(*spirv::downsample_comp) },
+	};
+
+	// Usable in constant expressions, so shader names can be checked and selected at compile time
+	constexpr const shader_blob* find_shader_blob(std::string_view name) noexcept
+	{
+		for (const shader_blob& blob : shader_blobs)
+			if (blob.name == name)
+				return &blob;
+
+		return nullptr;
+	}
+}
@@ -0,0 +1,202 @@
+#include "och_shader_reload.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif // _WIN32
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <thread>
+#include <chrono>
+#endif // __linux__
+
+namespace och
+{
+	file_watcher::~file_watcher() noexcept
+	{
+		close();
+	}
+
+#ifdef __linux__
+	bool file_watcher::open(const char* dir) noexcept
+	{
+		directory = dir;
+
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+		if (inotify_fd < 0)
+			return false;
+
+		// Editors either write in place or move a temporary file over the original
+		if (inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			close();
+
+			return false;
+		}
+
+		return true;
+	}
+
+	void file_watcher::close() noexcept
+	{
+		if (inotify_fd >= 0)
+			::close(inotify_fd);
+
+		inotify_fd = -1;
+	}
+
+	std::vector<std::string> file_watcher::wait(uint32_t timeout_ms)
+	{
+		std::vector<std::string> changed;
+
+		pollfd poll_fd{ inotify_fd, POLLIN, 0 };
+
+		if (poll(&poll_fd, 1, static_cast<int>(timeout_ms)) <= 0)
+			return changed;
+
+		alignas(inotify_event) char buf[4096];
+
+		ssize_t len;
+
+		while ((len = read(inotify_fd, buf, sizeof(buf))) > 0)
+			for (ssize_t i = 0; i < len;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buf + i);
+
+				if (event->len && std::find(changed.begin(), changed.end(), event->name) == changed.end())
+					changed.emplace_back(event->name);
+
+				i += sizeof(inotify_event) + event->len;
+			}
+
+		return changed;
+	}
+#else
+	bool file_watcher::open(const char* dir) noexcept
+	{
+		directory = dir;
+
+		std::error_code ec;
+
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(dir, ec))
+			if (entry.is_regular_file(ec))
+				write_times[entry.path().filename().string()] = entry.last_write_time(ec);
+
+		if (ec)
+			return false;
+
+#ifdef _WIN32
+		change_handle = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+
+		if (change_handle == INVALID_HANDLE_VALUE)
+		{
+			change_handle = nullptr;
+
+			return false;
+		}
+#endif // _WIN32
+
+		return true;
+	}
+
+	void file_watcher::close() noexcept
+	{
+#ifdef _WIN32
+		if (change_handle)
+			FindCloseChangeNotification(change_handle);
+#endif // _WIN32
+
+		change_handle = nullptr;
+
+		write_times.clear();
+	}
+
+	std::vector<std::string> file_watcher::wait(uint32_t timeout_ms)
+	{
+		std::vector<std::string> changed;
+
+#ifdef _WIN32
+		if (WaitForSingleObject(change_handle, timeout_ms) != WAIT_OBJECT_0)
+			return changed;
+
+		FindNextChangeNotification(change_handle);
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+#endif // _WIN32
+
+		std::error_code ec;
+
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, ec))
+		{
+			if (!entry.is_regular_file(ec))
+				continue;
+
+			const std::filesystem::file_time_type write_time = entry.last_write_time(ec);
+
+			if (ec)
+				continue;
+
+			std::string name = entry.path().filename().string();
+
+			auto it = write_times.find(name);
+
+			if (it != write_times.end() && it->second == write_time)
+				continue;
+
+			write_times[name] = write_time;
+
+			changed.push_back(std::move(name));
+		}
+
+		return changed;
+	}
+#endif // __linux__
+
+	bool compile_glsl(const char* source_path, const char* defines, const char* output_path)
+	{
+		std::string glslc = "glslc";
+
+#ifdef _WIN32
+		char sdk_path[MAX_PATH];
+
+		const DWORD sdk_path_len = GetEnvironmentVariableA("VULKAN_SDK", sdk_path, MAX_PATH);
+
+		if (sdk_path_len && sdk_path_len < MAX_PATH)
+			glslc = std::string(sdk_path, sdk_path_len) + "\\Bin\\glslc.exe";
+#else
+		if (const char* sdk_path = std::getenv("VULKAN_SDK"))
+			glslc = std::string(sdk_path) + "/bin/glslc";
+#endif // _WIN32
+
+		const std::string tmp_path = std::string(output_path) + ".tmp";
+
+		std::string command = '"' + glslc + "\" " + defines + " \"" + source_path + "\" -o \"" + tmp_path + '"';
+
+#ifdef _WIN32
+		// cmd.exe strips the outermost pair of quotes from commands starting with one
+		command = '"' + command + '"';
+#endif // _WIN32
+
+		if (std::system(command.c_str()) != 0)
+		{
+			std::remove(tmp_path.c_str());
+
+			return false;
+		}
+
+		std::error_code ec;
+
+		std::filesystem::rename(tmp_path, output_path, ec);
+
+		return !ec;
+	}
+}
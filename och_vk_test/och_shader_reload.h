@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#ifndef __linux__
+#include <filesystem>
+#include <unordered_map>
+#endif // !__linux__
+
+namespace och
+{
+	// Reports files written in one directory, which is not watched recursively.
+	// Uses inotify on Linux. Elsewhere write times are compared, waking up on directory change notifications on Windows.
+	struct file_watcher
+	{
+		std::string directory;
+
+#ifdef __linux__
+		int inotify_fd = -1;
+#else
+		void* change_handle = nullptr;
+
+		std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
+#endif // __linux__
+
+		file_watcher() noexcept = default;
+
+		file_watcher(const file_watcher&) = delete;
+
+		~file_watcher() noexcept;
+
+		bool open(const char* dir) noexcept;
+
+		void close() noexcept;
+
+		// Waits at most timeout_ms for writes and returns the names of the files written since the last call, relative to the directory
+		std::vector<std::string> wait(uint32_t timeout_ms);
+	};
+
+	// Compiles a GLSL file to SPIR-V by running glslc from the Vulkan SDK, or from PATH if VULKAN_SDK is not set.
+	// defines is passed through to glslc and may be empty. The output only replaces output_path once it is complete.
+	bool compile_glsl(const char* source_path, const char* defines, const char* output_path);
+}
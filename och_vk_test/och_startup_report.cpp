@@ -0,0 +1,90 @@
+#include "och_startup_report.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "och_trace.h"
+
+namespace och
+{
+	static float ns_to_ms(uint64_t ns) noexcept
+	{
+		return static_cast<float>(ns) / 1'000'000.0F;
+	}
+
+	startup_stage_timer::startup_stage_timer() noexcept : beg_ns{ trace_now_ns() }, beg_cpu_ns{ trace_thread_cpu_ns() }, beg_peak_resident{ trace_peak_resident_bytes() } {}
+
+	void startup_report::add(std::string name, const startup_stage_timer& timer)
+	{
+		const uint64_t end_ns = trace_now_ns();
+
+		stages.push_back({ std::move(name), ns_to_ms(timer.beg_ns - beg_ns), ns_to_ms(end_ns - timer.beg_ns), ns_to_ms(trace_thread_cpu_ns() - timer.beg_cpu_ns), trace_peak_resident_bytes() - timer.beg_peak_resident, true });
+	}
+
+	void startup_report::add(const task_graph& graph)
+	{
+		const std::vector<uint32_t> critical_path = graph.critical_path();
+
+		for (uint32_t i = 0; i != graph.tasks.size(); ++i)
+		{
+			const task_graph::task& t = graph.tasks[i];
+
+			if (!t.has_run)
+				continue;
+
+			const bool is_critical = std::find(critical_path.begin(), critical_path.end(), i) != critical_path.end();
+
+			stages.push_back({ t.name, ns_to_ms(graph.beg_ns + t.beg_ns - beg_ns), ns_to_ms(t.end_ns - t.beg_ns), ns_to_ms(t.cpu_ns), t.peak_resident_growth, is_critical });
+		}
+
+		graph_wall_ms = ns_to_ms(graph.wall_ns);
+
+		graph_sequential_ms = ns_to_ms(graph.sequential_ns());
+	}
+
+	std::vector<const startup_stage*> startup_report::sorted_stages() const
+	{
+		std::vector<const startup_stage*> sorted;
+
+		for (const startup_stage& stage : stages)
+			sorted.push_back(&stage);
+
+		std::stable_sort(sorted.begin(), sorted.end(), [](const startup_stage* l, const startup_stage* r) { return l->wall_ms > r->wall_ms; });
+
+		return sorted;
+	}
+
+	bool write_startup_report_json(const char* filename, const startup_report& report) noexcept
+	{
+		std::ofstream out(filename);
+
+		if (!out)
+			return false;
+
+		out << "{\"first_present_ms\":" << report.first_present_ms << ",\"peak_resident_bytes\":" << report.peak_resident_bytes
+			<< ",\"graph_wall_ms\":" << report.graph_wall_ms << ",\"graph_sequential_ms\":" << report.graph_sequential_ms << ",\"stages\":[";
+
+		// Stage names are function names and asset paths, so only backslashes and quotes need escaping
+		for (size_t i = 0; i != report.stages.size(); ++i)
+		{
+			const startup_stage& stage = report.stages[i];
+
+			out << (i ? ",\n" : "\n") << "{\"name\":\"";
+
+			for (char c : stage.name)
+			{
+				if (c == '\\' || c == '"')
+					out << '\\';
+
+				out << c;
+			}
+
+			out << "\",\"beg_ms\":" << stage.beg_ms << ",\"wall_ms\":" << stage.wall_ms << ",\"cpu_ms\":" << stage.cpu_ms
+				<< ",\"peak_resident_growth\":" << stage.peak_resident_growth << ",\"is_critical\":" << (stage.is_critical ? "true" : "false") << '}';
+		}
+
+		out << "\n]}\n";
+
+		return static_cast<bool>(out);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "och_task_graph.h"
+
+namespace och
+{
+	struct startup_stage
+	{
+		std::string name;
+
+		// Milliseconds since startup_report::beg_ns
+		float beg_ms;
+
+		float wall_ms;
+
+		float cpu_ms;
+
+		// Growth of the process's peak resident set while the stage ran, shared between stages running at the same time
+		uint64_t peak_resident_growth;
+
+		bool is_critical;
+	};
+
+	// Measures a stage running on the calling thread from construction on
+	struct startup_stage_timer
+	{
+		uint64_t beg_ns;
+
+		uint64_t beg_cpu_ns;
+
+		uint64_t beg_peak_resident;
+
+		startup_stage_timer() noexcept;
+	};
+
+	struct startup_report
+	{
+		// trace_now_ns when startup began
+		uint64_t beg_ns = 0;
+
+		std::vector<startup_stage> stages;
+
+		// Wall time of the task graph, and what its tasks would take one after another
+		float graph_wall_ms = 0.0F;
+
+		float graph_sequential_ms = 0.0F;
+
+		// Until the first frame was presented, or submitted without a swapchain. 0 until then.
+		float first_present_ms = 0.0F;
+
+		uint64_t peak_resident_bytes = 0;
+
+		// Adds a stage run outside the task graph. Those run one after another, so they are all on the critical path.
+		void add(std::string name, const startup_stage_timer& timer);
+
+		// Adds every task that ran, marking the ones on the critical path
+		void add(const task_graph& graph);
+
+		// Stages by decreasing wall time
+		std::vector<const startup_stage*> sorted_stages() const;
+	};
+
+	bool write_startup_report_json(const char* filename, const startup_report& report) noexcept;
+}
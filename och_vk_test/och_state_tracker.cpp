@@ -0,0 +1,253 @@
+#include "och_state_tracker.h"
+
+namespace och
+{
+	static constexpr uint64_t write_access_mask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+#ifdef OCH_SYNCHRONIZATION2
+		| VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR
+#endif // OCH_SYNCHRONIZATION2
+		;
+
+	// Moves state past access and fills the barrier's masks and layouts. Returns false if no barrier is needed.
+	static bool advance_state(resource_state_tracker::subresource_state& state, const resource_access& access, bool has_layout, bool discard, resource_state_tracker::pending_barrier& out_barrier)
+	{
+		const bool needs_layout = has_layout && access.layout != state.layout;
+
+		const bool is_write = (access.access & write_access_mask) != 0;
+
+		out_barrier.dst_stages = access.stages;
+
+		out_barrier.dst_access = access.access;
+
+		out_barrier.old_layout = has_layout ? discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+		out_barrier.new_layout = has_layout ? access.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (needs_layout || is_write)
+		{
+			// Nothing touched it yet, so a plain write can go ahead
+			const bool needs_barrier = needs_layout || state.write_stages || state.read_stages;
+
+			// Waiting for reads only needs an execution dependency, waiting for a write also its availability
+			out_barrier.src_stages = state.write_stages | state.read_stages;
+
+			out_barrier.src_access = state.write_access;
+
+			// A layout transition counts as a write which is visible to this access only
+			if (is_write)
+				state = { has_layout ? access.layout : state.layout, access.stages, access.access, 0, 0 };
+			else
+				state = { access.layout, access.stages, 0, access.stages, access.access };
+
+			return needs_barrier;
+		}
+
+		const bool is_visible = !state.write_stages || (!(access.stages & ~state.read_stages) && !(access.access & ~state.read_access));
+
+		state.read_stages |= access.stages;
+
+		state.read_access |= access.access;
+
+		if (is_visible)
+			return false;
+
+		out_barrier.src_stages = state.write_stages;
+
+		out_barrier.src_access = state.write_access;
+
+		return true;
+	}
+
+	void resource_state_tracker::track_image(VkImage image, VkImageAspectFlags aspect, uint32_t level_cnt, uint32_t layer_cnt, VkImageLayout layout)
+	{
+		images[image] = { aspect, level_cnt, layer_cnt, std::vector<subresource_state>(static_cast<size_t>(level_cnt) * layer_cnt, { layout, 0, 0, 0, 0 }) };
+	}
+
+	void resource_state_tracker::track_buffer(VkBuffer buffer)
+	{
+		buffers[buffer] = { VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0 };
+	}
+
+	void resource_state_tracker::forget_image(VkImage image)
+	{
+		images.erase(image);
+	}
+
+	void resource_state_tracker::forget_buffer(VkBuffer buffer)
+	{
+		buffers.erase(buffer);
+	}
+
+	void resource_state_tracker::access_image(VkImage image, const resource_access& access, uint32_t base_level, uint32_t level_cnt, bool discard)
+	{
+		image_entry& entry = images.at(image);
+
+		const uint32_t end_level = level_cnt == VK_REMAINING_MIP_LEVELS ? entry.level_cnt : base_level + level_cnt;
+
+		for (uint32_t layer = 0; layer != entry.layer_cnt; ++layer)
+		{
+			// Consecutive levels with identical barriers are merged into one, which is the common case for whole images
+			const size_t first_new = pending.size();
+
+			for (uint32_t level = base_level; level != end_level; ++level)
+			{
+				pending_barrier barrier{};
+				barrier.image = image;
+
+				if (!advance_state(entry.subresources[layer * entry.level_cnt + level], access, true, discard, barrier))
+				{
+					++skipped_access_cnt;
+
+					continue;
+				}
+
+				barrier.range = { entry.aspect, level, 1, layer, 1 };
+
+				if (pending.size() != first_new)
+				{
+					pending_barrier& prev = pending.back();
+
+					if (prev.range.baseMipLevel + prev.range.levelCount == level && prev.src_stages == barrier.src_stages && prev.src_access == barrier.src_access && prev.old_layout == barrier.old_layout)
+					{
+						++prev.range.levelCount;
+
+						continue;
+					}
+				}
+
+				pending.push_back(barrier);
+			}
+		}
+	}
+
+	void resource_state_tracker::access_buffer(VkBuffer buffer, const resource_access& access)
+	{
+		pending_barrier barrier{};
+		barrier.buffer = buffer;
+
+		if (advance_state(buffers.at(buffer), access, false, false, barrier))
+			pending.push_back(barrier);
+		else
+			++skipped_access_cnt;
+	}
+
+	void resource_state_tracker::flush(VkCommandBuffer cmd)
+	{
+		if (pending.empty())
+			return;
+
+		++flush_cnt;
+
+		recorded_barrier_cnt += pending.size();
+
+#ifdef OCH_SYNCHRONIZATION2
+		if (cmd_pipeline_barrier_2)
+		{
+			std::vector<VkImageMemoryBarrier2KHR> image_barriers;
+
+			std::vector<VkBufferMemoryBarrier2KHR> buffer_barriers;
+
+			for (const pending_barrier& p : pending)
+			{
+				if (p.image)
+				{
+					VkImageMemoryBarrier2KHR barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+					barrier.srcStageMask = p.src_stages;
+					barrier.srcAccessMask = p.src_access;
+					barrier.dstStageMask = p.dst_stages;
+					barrier.dstAccessMask = p.dst_access;
+					barrier.oldLayout = p.old_layout;
+					barrier.newLayout = p.new_layout;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = p.image;
+					barrier.subresourceRange = p.range;
+
+					image_barriers.push_back(barrier);
+				}
+				else
+				{
+					VkBufferMemoryBarrier2KHR barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+					barrier.srcStageMask = p.src_stages;
+					barrier.srcAccessMask = p.src_access;
+					barrier.dstStageMask = p.dst_stages;
+					barrier.dstAccessMask = p.dst_access;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.buffer = p.buffer;
+					barrier.offset = 0;
+					barrier.size = VK_WHOLE_SIZE;
+
+					buffer_barriers.push_back(barrier);
+				}
+			}
+
+			VkDependencyInfoKHR dependency_info{};
+			dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+			dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+			dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+			dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+			dependency_info.pImageMemoryBarriers = image_barriers.data();
+
+			cmd_pipeline_barrier_2(cmd, &dependency_info);
+
+			pending.clear();
+
+			return;
+		}
+#endif // OCH_SYNCHRONIZATION2
+
+		// Legacy barriers share one pair of stage masks, so every barrier waits for the union of all source stages
+		VkPipelineStageFlags src_stages = 0;
+
+		VkPipelineStageFlags dst_stages = 0;
+
+		std::vector<VkImageMemoryBarrier> image_barriers;
+
+		std::vector<VkBufferMemoryBarrier> buffer_barriers;
+
+		for (const pending_barrier& p : pending)
+		{
+			src_stages |= static_cast<VkPipelineStageFlags>(p.src_stages);
+
+			dst_stages |= static_cast<VkPipelineStageFlags>(p.dst_stages);
+
+			if (p.image)
+			{
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = static_cast<VkAccessFlags>(p.src_access);
+				barrier.dstAccessMask = static_cast<VkAccessFlags>(p.dst_access);
+				barrier.oldLayout = p.old_layout;
+				barrier.newLayout = p.new_layout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = p.image;
+				barrier.subresourceRange = p.range;
+
+				image_barriers.push_back(barrier);
+			}
+			else
+			{
+				VkBufferMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = static_cast<VkAccessFlags>(p.src_access);
+				barrier.dstAccessMask = static_cast<VkAccessFlags>(p.dst_access);
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = p.buffer;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+
+				buffer_barriers.push_back(barrier);
+			}
+		}
+
+		vkCmdPipelineBarrier(cmd, src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+			static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(), static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+
+		pending.clear();
+	}
+}
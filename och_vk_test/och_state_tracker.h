@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+// VK_KHR_synchronization2 needs headers from SDK 1.2.182 on. Without it, or without device support, barriers are recorded with vkCmdPipelineBarrier.
+#ifdef VK_KHR_synchronization2
+#define OCH_SYNCHRONIZATION2
+#endif // VK_KHR_synchronization2
+
+namespace och
+{
+	// Stage and access bits as in VkPipelineStageFlags2 and VkAccessFlags2, whose lower 32 bits match the legacy flags
+	struct resource_access
+	{
+		uint64_t stages;
+
+		uint64_t access;
+
+		// Ignored for buffers
+		VkImageLayout layout;
+	};
+
+	inline constexpr resource_access access_transfer_src{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+
+	inline constexpr resource_access access_transfer_dst{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+
+	inline constexpr resource_access access_fragment_sampled{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+	// Knows the layout and the accesses since the last write of every tracked image subresource and buffer.
+	// Requested accesses are turned into barriers that are queued until flush records all of them with a single call.
+	// Tracked state follows recording order, so command buffers have to be submitted in the order they were recorded.
+	struct resource_state_tracker
+	{
+		struct subresource_state
+		{
+			VkImageLayout layout;
+
+			// Last write, or the last layout transition which counts as one
+			uint64_t write_stages;
+
+			uint64_t write_access;
+
+			// Reads since then, which the last write is already visible to
+			uint64_t read_stages;
+
+			uint64_t read_access;
+		};
+
+		struct image_entry
+		{
+			VkImageAspectFlags aspect;
+
+			uint32_t level_cnt;
+
+			uint32_t layer_cnt;
+
+			// Indexed by layer * level_cnt + level
+			std::vector<subresource_state> subresources;
+		};
+
+		struct pending_barrier
+		{
+			VkImage image;
+
+			VkBuffer buffer;
+
+			uint64_t src_stages;
+
+			uint64_t src_access;
+
+			uint64_t dst_stages;
+
+			uint64_t dst_access;
+
+			VkImageLayout old_layout;
+
+			VkImageLayout new_layout;
+
+			VkImageSubresourceRange range;
+		};
+
+		std::unordered_map<VkImage, image_entry> images;
+
+		std::unordered_map<VkBuffer, subresource_state> buffers;
+
+		std::vector<pending_barrier> pending;
+
+#ifdef OCH_SYNCHRONIZATION2
+		// Null without device support for synchronization2
+		PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier_2 = nullptr;
+#endif // OCH_SYNCHRONIZATION2
+
+		uint64_t flush_cnt = 0;
+
+		uint64_t recorded_barrier_cnt = 0;
+
+		// Subresource accesses that needed no barrier at all
+		uint64_t skipped_access_cnt = 0;
+
+		void track_image(VkImage image, VkImageAspectFlags aspect, uint32_t level_cnt, uint32_t layer_cnt = 1, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		void track_buffer(VkBuffer buffer);
+
+		void forget_image(VkImage image);
+
+		void forget_buffer(VkBuffer buffer);
+
+		// Queues whatever barrier the given subresources need before access, or nothing if they are already good to go.
+		// discard allows transitioning from UNDEFINED, dropping the current contents. Each subresource may be accessed once per flush.
+		void access_image(VkImage image, const resource_access& access, uint32_t base_level = 0, uint32_t level_cnt = VK_REMAINING_MIP_LEVELS, bool discard = false);
+
+		void access_buffer(VkBuffer buffer, const resource_access& access);
+
+		// Records every queued barrier in one vkCmdPipelineBarrier2KHR call, or one vkCmdPipelineBarrier call without synchronization2
+		void flush(VkCommandBuffer cmd);
+	};
+}
@@ -0,0 +1,187 @@
+#include "och_task_graph.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include "och_trace.h"
+
+namespace och
+{
+	uint32_t task_graph::add(std::string name, task_fn fn, std::vector<uint32_t> dependencies, bool is_pinned)
+	{
+		const uint32_t idx = static_cast<uint32_t>(tasks.size());
+
+		for (uint32_t dependency : dependencies)
+			tasks[dependency].dependents.push_back(idx);
+
+		tasks.push_back({ std::move(name), std::move(fn), std::move(dependencies), {}, 0, 0, 0, 0, 0, no_task, is_pinned, false });
+
+		return idx;
+	}
+
+	bool task_graph::run(uint32_t worker_cnt)
+	{
+		std::mutex mutex;
+
+		std::condition_variable ready_cv;
+
+		std::deque<uint32_t> ready;
+
+		std::deque<uint32_t> pinned_ready;
+
+		std::vector<uint32_t> remaining_dependencies(tasks.size());
+
+		uint32_t unfinished_cnt = static_cast<uint32_t>(tasks.size());
+
+		uint32_t running_cnt = 0;
+
+		bool has_failed = false;
+
+		for (uint32_t i = 0; i != tasks.size(); ++i)
+		{
+			tasks[i].has_run = false;
+
+			remaining_dependencies[i] = static_cast<uint32_t>(tasks[i].dependencies.size());
+
+			if (remaining_dependencies[i] == 0)
+				(tasks[i].is_pinned ? pinned_ready : ready).push_back(i);
+		}
+
+		beg_ns = trace_now_ns();
+
+		auto worker_fn = [&](bool is_caller)
+		{
+			std::unique_lock lock(mutex);
+
+			while (true)
+			{
+				std::deque<uint32_t>* queue = nullptr;
+
+				// Stops once everything finished, or nothing more will be started after a failure
+				ready_cv.wait(lock, [&]()
+					{
+						// The calling thread keeps to pinned tasks, so they are never held up behind others
+						if (is_caller)
+							queue = !pinned_ready.empty() ? &pinned_ready : worker_cnt == 0 && !ready.empty() ? &ready : nullptr;
+						else
+							queue = ready.empty() ? nullptr : &ready;
+
+						return queue || unfinished_cnt == 0 || (has_failed && running_cnt == 0);
+					});
+
+				if (!queue || has_failed)
+					return;
+
+				const uint32_t idx = queue->front();
+
+				queue->pop_front();
+
+				++running_cnt;
+
+				task& t = tasks[idx];
+
+				lock.unlock();
+
+				const uint64_t beg_cpu_ns = trace_thread_cpu_ns();
+
+				const uint64_t beg_peak_resident = trace_peak_resident_bytes();
+
+				t.beg_ns = trace_now_ns() - beg_ns;
+
+				const bool is_ok = t.fn();
+
+				t.end_ns = trace_now_ns() - beg_ns;
+
+				t.cpu_ns = trace_thread_cpu_ns() - beg_cpu_ns;
+
+				t.peak_resident_growth = trace_peak_resident_bytes() - beg_peak_resident;
+
+				lock.lock();
+
+				--running_cnt;
+
+				--unfinished_cnt;
+
+				t.has_run = true;
+
+				if (!is_ok)
+					has_failed = true;
+				else
+					for (uint32_t dependent : t.dependents)
+						if (--remaining_dependencies[dependent] == 0)
+							(tasks[dependent].is_pinned ? pinned_ready : ready).push_back(dependent);
+
+				ready_cv.notify_all();
+			}
+		};
+
+		std::vector<std::thread> workers;
+
+		for (uint32_t i = 0; i != worker_cnt; ++i)
+			workers.emplace_back([&]()
+				{
+					trace_set_thread_name("task worker");
+
+					worker_fn(false);
+				});
+
+		worker_fn(true);
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		wall_ns = trace_now_ns() - beg_ns;
+
+		// Insertion order is topological, so every dependency's path is known before its dependents'
+		for (task& t : tasks)
+		{
+			t.path_ns = 0;
+
+			t.path_predecessor = no_task;
+
+			if (!t.has_run)
+				continue;
+
+			for (uint32_t dependency : t.dependencies)
+				if (tasks[dependency].path_ns > t.path_ns)
+				{
+					t.path_ns = tasks[dependency].path_ns;
+
+					t.path_predecessor = dependency;
+				}
+
+			t.path_ns += t.end_ns - t.beg_ns;
+		}
+
+		return !has_failed;
+	}
+
+	std::vector<uint32_t> task_graph::critical_path() const
+	{
+		uint32_t last = no_task;
+
+		for (uint32_t i = 0; i != tasks.size(); ++i)
+			if (tasks[i].has_run && (last == no_task || tasks[i].path_ns > tasks[last].path_ns))
+				last = i;
+
+		std::vector<uint32_t> path;
+
+		for (uint32_t i = last; i != no_task; i = tasks[i].path_predecessor)
+			path.push_back(i);
+
+		return std::vector<uint32_t>(path.rbegin(), path.rend());
+	}
+
+	uint64_t task_graph::sequential_ns() const
+	{
+		uint64_t sum = 0;
+
+		for (const task& t : tasks)
+			if (t.has_run)
+				sum += t.end_ns - t.beg_ns;
+
+		return sum;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <functional>
+
+namespace och
+{
+	// Runs tasks on a pool of threads as soon as everything they depend on finished, and records when each ran.
+	// Dependencies can only refer to tasks added before, so insertion order is a topological order.
+	struct task_graph
+	{
+		// Returns false if the task failed, in which case no further tasks are started
+		using task_fn = std::function<bool()>;
+
+		struct task
+		{
+			std::string name;
+
+			task_fn fn;
+
+			std::vector<uint32_t> dependencies;
+
+			std::vector<uint32_t> dependents;
+
+			// Nanoseconds since run started
+			uint64_t beg_ns;
+
+			uint64_t end_ns;
+
+			// CPU time of the thread running it, so time spent waiting does not count
+			uint64_t cpu_ns;
+
+			// How much the process's peak resident set grew while it ran. Tasks running at the same time each see the other's growth.
+			uint64_t peak_resident_growth;
+
+			// Longest chain of task durations ending with this one, and its previous task on that chain
+			uint64_t path_ns;
+
+			uint32_t path_predecessor;
+
+			// Only runs on the thread that called run, for work tied to it such as windowing calls
+			bool is_pinned;
+
+			bool has_run;
+		};
+
+		static constexpr uint32_t no_task = ~0u;
+
+		std::vector<task> tasks;
+
+		// trace_now_ns when the last run started, and its duration
+		uint64_t beg_ns = 0;
+
+		uint64_t wall_ns = 0;
+
+		uint32_t add(std::string name, task_fn fn, std::vector<uint32_t> dependencies = {}, bool is_pinned = false);
+
+		// Runs every task on worker_cnt threads plus the calling one, which only runs pinned tasks unless there are no workers. Returns false if a task failed, after the running ones finished.
+		bool run(uint32_t worker_cnt);
+
+		// Tasks of the longest chain of dependencies by measured duration, first to last. Empty before run.
+		std::vector<uint32_t> critical_path() const;
+
+		// What running the tasks that ran one after another would have taken
+		uint64_t sequential_ns() const;
+	};
+}
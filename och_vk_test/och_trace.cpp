@@ -0,0 +1,245 @@
+#include "och_trace.h"
+
+#include <chrono>
+#include <vector>
+#include <fstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <ctime>
+#include <sys/resource.h>
+#endif // _WIN32
+
+namespace och
+{
+	struct trace_event
+	{
+		const char* name;
+
+		uint64_t beg_ns;
+
+		uint64_t end_ns;
+
+		uint32_t tid;
+	};
+
+	// Single producer (the owning thread), single consumer (trace_collect)
+	struct trace_ring
+	{
+		static constexpr uint32_t capacity = 1 << 14;
+
+		trace_event events[capacity];
+
+		std::atomic<uint32_t> write_idx = 0;
+
+		std::atomic<uint32_t> read_idx = 0;
+
+		std::atomic<uint32_t> dropped_cnt = 0;
+
+		std::atomic<const char*> thread_name = nullptr;
+
+		uint32_t tid;
+
+		trace_ring* next;
+
+		void push(const trace_event& e) noexcept
+		{
+			const uint32_t w = write_idx.load(std::memory_order_relaxed);
+
+			if (w - read_idx.load(std::memory_order_acquire) == capacity)
+			{
+				dropped_cnt.fetch_add(1, std::memory_order_relaxed);
+
+				return;
+			}
+
+			events[w % capacity] = e;
+
+			write_idx.store(w + 1, std::memory_order_release);
+		}
+	};
+
+	// GPU zones get their own track, everything else is numbered by thread from 1
+	static constexpr uint32_t gpu_tid = 0;
+
+	static constexpr uint64_t max_collected_events = 1 << 22;
+
+	std::atomic<bool> trace_enabled = false;
+
+	// Rings are never freed, so events of threads that already exited can still be collected
+	static std::atomic<trace_ring*> ring_list = nullptr;
+
+	static std::atomic<uint32_t> ring_cnt = 0;
+
+	static uint64_t trace_start_ns;
+
+	static std::vector<trace_event> collected_events;
+
+	static uint64_t overflow_cnt = 0;
+
+	static trace_ring* get_thread_ring() noexcept
+	{
+		thread_local trace_ring* ring = nullptr;
+
+		if (!ring)
+		{
+			ring = new trace_ring;
+
+			ring->tid = ring_cnt.fetch_add(1, std::memory_order_relaxed) + 1;
+
+			ring->next = ring_list.load(std::memory_order_relaxed);
+
+			while (!ring_list.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		return ring;
+	}
+
+	uint64_t trace_now_ns() noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	uint64_t trace_host_ticks_to_ns(uint64_t ticks) noexcept
+	{
+#ifdef _WIN32
+		static const uint64_t frequency = []() { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return static_cast<uint64_t>(f.QuadPart); }();
+
+		return (ticks / frequency) * 1'000'000'000 + (ticks % frequency) * 1'000'000'000 / frequency;
+#else
+		return ticks;
+#endif // _WIN32
+	}
+
+	uint64_t trace_thread_cpu_ns() noexcept
+	{
+#ifdef _WIN32
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+
+		if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+			return 0;
+
+		const uint64_t kernel_ticks = (static_cast<uint64_t>(kernel_time.dwHighDateTime) << 32) | kernel_time.dwLowDateTime;
+
+		const uint64_t user_ticks = (static_cast<uint64_t>(user_time.dwHighDateTime) << 32) | user_time.dwLowDateTime;
+
+		// FILETIME counts in 100 ns
+		return (kernel_ticks + user_ticks) * 100;
+#else
+		timespec ts;
+
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+			return 0;
+
+		return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(ts.tv_nsec);
+#endif // _WIN32
+	}
+
+	uint64_t trace_peak_resident_bytes() noexcept
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage;
+
+		if (getrusage(RUSAGE_SELF, &usage))
+			return 0;
+
+		// Reported in KiB
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif // _WIN32
+	}
+
+	void trace_begin() noexcept
+	{
+		trace_start_ns = trace_now_ns();
+
+		trace_set_thread_name("main");
+
+		trace_enabled.store(true, std::memory_order_relaxed);
+	}
+
+	void trace_set_thread_name(const char* name) noexcept
+	{
+		get_thread_ring()->thread_name.store(name, std::memory_order_relaxed);
+	}
+
+	void trace_zone_emit(const char* name, uint64_t beg_ns, uint64_t end_ns) noexcept
+	{
+		trace_ring* ring = get_thread_ring();
+
+		ring->push({ name, beg_ns, end_ns, ring->tid });
+	}
+
+	void trace_gpu_zone_emit(const char* name, uint64_t beg_ns, uint64_t end_ns) noexcept
+	{
+		if (!trace_enabled.load(std::memory_order_relaxed))
+			return;
+
+		get_thread_ring()->push({ name, beg_ns, end_ns, gpu_tid });
+	}
+
+	void trace_collect() noexcept
+	{
+		for (trace_ring* ring = ring_list.load(std::memory_order_acquire); ring; ring = ring->next)
+		{
+			const uint32_t w = ring->write_idx.load(std::memory_order_acquire);
+
+			for (uint32_t r = ring->read_idx.load(std::memory_order_relaxed); r != w; ++r)
+				if (collected_events.size() < max_collected_events)
+					collected_events.push_back(ring->events[r % trace_ring::capacity]);
+				else
+					++overflow_cnt;
+
+			ring->read_idx.store(w, std::memory_order_release);
+		}
+	}
+
+	bool trace_write(const char* filename) noexcept
+	{
+		trace_collect();
+
+		std::ofstream out(filename);
+
+		if (!out)
+			return false;
+
+		out.precision(3);
+
+		out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpu_tid << ",\"args\":{\"name\":\"GPU\"}}";
+
+		uint64_t dropped_cnt = overflow_cnt;
+
+		for (trace_ring* ring = ring_list.load(std::memory_order_acquire); ring; ring = ring->next)
+		{
+			const char* thread_name = ring->thread_name.load(std::memory_order_relaxed);
+
+			out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->tid << ",\"args\":{\"name\":\"" << (thread_name ? thread_name : "worker") << "\"}}";
+
+			dropped_cnt += ring->dropped_cnt.load(std::memory_order_relaxed);
+		}
+
+		for (const trace_event& e : collected_events)
+		{
+			// Signed, as calibrated GPU zones may start slightly before the trace did
+			const double ts_us = (static_cast<double>(e.beg_ns) - static_cast<double>(trace_start_ns)) / 1'000.0;
+
+			const double dur_us = (static_cast<double>(e.end_ns) - static_cast<double>(e.beg_ns)) / 1'000.0;
+
+			out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid << ",\"ts\":" << ts_us << ",\"dur\":" << dur_us << '}';
+		}
+
+		out << "\n],\"otherData\":{\"dropped_events\":" << dropped_cnt << "}}\n";
+
+		return static_cast<bool>(out);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+namespace och
+{
+	// Zones are recorded into a per-thread single-producer ring buffer and moved into the trace by trace_collect.
+	// Names must outlive the trace, which string literals and __FUNCTION__ do.
+
+	extern std::atomic<bool> trace_enabled;
+
+	// Nanoseconds on std::chrono::steady_clock, which is the QPC / CLOCK_MONOTONIC domain Vulkan calibrates against
+	uint64_t trace_now_ns() noexcept;
+
+	// Converts a raw value of the host time domain returned by vkGetCalibratedTimestampsEXT to trace_now_ns units
+	uint64_t trace_host_ticks_to_ns(uint64_t ticks) noexcept;
+
+	// CPU time the calling thread spent in user and kernel mode
+	uint64_t trace_thread_cpu_ns() noexcept;
+
+	// Largest resident set (working set on Windows) the process had so far
+	uint64_t trace_peak_resident_bytes() noexcept;
+
+	void trace_begin() noexcept;
+
+	void trace_set_thread_name(const char* name) noexcept;
+
+	void trace_zone_emit(const char* name, uint64_t beg_ns, uint64_t end_ns) noexcept;
+
+	void trace_gpu_zone_emit(const char* name, uint64_t beg_ns, uint64_t end_ns) noexcept;
+
+	// Drains all thread rings. Must only be called from one thread at a time.
+	void trace_collect() noexcept;
+
+	// Writes everything collected so far in the Chrome trace event format, readable by chrome://tracing and Perfetto
+	bool trace_write(const char* filename) noexcept;
+
+	struct trace_zone
+	{
+		const char* name;
+
+		uint64_t beg_ns;
+
+		trace_zone(const char* name) noexcept : name{ name }, beg_ns{ trace_enabled.load(std::memory_order_relaxed) ? trace_now_ns() : 0 } {}
+
+		~trace_zone() noexcept
+		{
+			if (beg_ns)
+				trace_zone_emit(name, beg_ns, trace_now_ns());
+		}
+	};
+
+#define OCH_TRACE_CONCAT_IMPL(a, b) a##b
+#define OCH_TRACE_CONCAT(a, b) OCH_TRACE_CONCAT_IMPL(a, b)
+
+#define OCH_ZONE(name) och::trace_zone OCH_TRACE_CONCAT(och_trace_zone_, __LINE__)(name)
+}
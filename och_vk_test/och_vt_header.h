@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#pragma pack(push, 1)
+struct virtual_texture_header
+{
+	char magic[4];
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_cnt;
+	uint32_t page_dim;
+	uint32_t border_dim;
+
+	uint32_t tile_dim() const
+	{
+		return page_dim + 2 * border_dim;
+	}
+
+	uint64_t tile_bytes() const
+	{
+		return static_cast<uint64_t>(tile_dim()) * tile_dim() * 4;
+	}
+
+	uint32_t pages_x(uint32_t level) const
+	{
+		const uint32_t extent = width >> level ? width >> level : 1;
+
+		return (extent + page_dim - 1) / page_dim;
+	}
+
+	uint32_t pages_y(uint32_t level) const
+	{
+		const uint32_t extent = height >> level ? height >> level : 1;
+
+		return (extent + page_dim - 1) / page_dim;
+	}
+
+	//Offset of a tile relative to the start of the file. Tiles are stored level by level in row-major order.
+	uint64_t tile_offset(uint32_t level, uint32_t page_x, uint32_t page_y) const
+	{
+		uint64_t tile_idx = 0;
+
+		for (uint32_t i = 0; i != level; ++i)
+			tile_idx += static_cast<uint64_t>(pages_x(i)) * pages_y(i);
+
+		tile_idx += static_cast<uint64_t>(page_y) * pages_x(level) + page_x;
+
+		return sizeof(virtual_texture_header) + tile_idx * tile_bytes();
+	}
+};
+#pragma pack(pop)
@@ -1,3 +1,7 @@
-C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.vert -o vert.spv
-C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.vert -mfmt=num -o vert.spv.inc
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe depth.vert -mfmt=num -o depth_vert.spv.inc
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.frag -mfmt=num -o frag.spv.inc
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.frag -DOCH_VIRTUAL_TEXTURE -mfmt=num -o frag_vt.spv.inc
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe shader.frag -DOCH_BINDLESS -mfmt=num -o frag_bindless.spv.inc
+C:\VulkanSDK\1.2.176.1\Bin\glslc.exe downsample.comp -mfmt=num -o downsample_comp.spv.inc
 pause
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Premultiplied on the CPU
+layout(binding = 0) uniform uniform_buffer_obj{
+    mat4 model_view_projection;
+} ubo;
+
+layout(location = 0) in vec3 in_position;
+
+// Must produce bit-identical depth to shader.vert for the main pass' EQUAL test
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.model_view_projection * vec4(in_position, 1.0);
+}
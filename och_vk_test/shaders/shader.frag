@@ -1,14 +1,83 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef OCH_BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location = 0) in vec3 frag_colour;
 layout(location = 1) in vec2 frag_tex_position;
+layout(location = 2) flat in uint frag_texture_idx;
 
+#ifdef OCH_BINDLESS
+layout(binding = 1) uniform sampler tex_sampler;
+
+layout(binding = 2) uniform texture2D textures[];
+#else
 layout(binding = 1) uniform sampler2D tex_sampler;
+#endif
+
+#ifdef OCH_VIRTUAL_TEXTURE
+layout(constant_id = 0) const uint vt_width = 1;
+layout(constant_id = 1) const uint vt_height = 1;
+layout(constant_id = 2) const uint vt_level_cnt = 1;
+layout(constant_id = 3) const uint vt_page_dim = 128;
+layout(constant_id = 4) const uint vt_border_dim = 4;
+layout(constant_id = 5) const uint vt_atlas_dim = 2176;
+layout(constant_id = 6) const uint vt_feedback_scale = 8;
+layout(constant_id = 7) const uint vt_feedback_width = 1;
+
+layout(binding = 2) uniform usampler2D page_table;
+
+layout(std430, binding = 3) buffer feedback_buffer{
+    uint requests[];
+} feedback;
+#endif
+
+// Feature toggles, see och::shader_feature_*
+layout(constant_id = 8) const bool tint_vertex_colour = false;
+layout(constant_id = 9) const bool show_texture_coordinates = false;
 
 layout(location = 0) out vec4 out_colour;
 
 void main()
 {
+#ifdef OCH_VIRTUAL_TEXTURE
+    vec2 vt_size = vec2(vt_width, vt_height);
+
+    vec2 texel_position = clamp(frag_tex_position, 0.0, 1.0) * vt_size;
+
+    vec2 dx = dFdx(frag_tex_position * vt_size);
+    vec2 dy = dFdy(frag_tex_position * vt_size);
+
+    uint level = min(uint(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0))), vt_level_cnt - 1);
+
+    ivec2 page = clamp(ivec2(texel_position / float(vt_page_dim << level)), ivec2(0), textureSize(page_table, int(level)) - 1);
+
+    // Only one fragment per vt_feedback_scale^2 block reports the page it wants
+    uvec2 frag_position = uvec2(gl_FragCoord.xy);
+
+    if (frag_position.x % vt_feedback_scale == 0 && frag_position.y % vt_feedback_scale == 0)
+        feedback.requests[(frag_position.y / vt_feedback_scale) * vt_feedback_width + frag_position.x / vt_feedback_scale] = 0x80000000u | (level << 24) | (uint(page.y) << 12) | uint(page.x);
+
+    // The entry may point to a coarser ancestor if the requested page is not resident yet
+    uint entry = texelFetch(page_table, page, int(level)).r;
+
+    uint entry_level = (entry >> 16) & 0xFFu;
+
+    vec2 page_position = fract(texel_position / float(vt_page_dim << entry_level));
+
+    vec2 atlas_position = vec2(entry & 0xFFu, (entry >> 8) & 0xFFu) * float(vt_page_dim + 2 * vt_border_dim) + float(vt_border_dim) + page_position * float(vt_page_dim);
+
+    out_colour = textureLod(tex_sampler, atlas_position / float(vt_atlas_dim), 0.0);
+#elif defined(OCH_BINDLESS)
+    out_colour = texture(sampler2D(textures[nonuniformEXT(frag_texture_idx)], tex_sampler), frag_tex_position);
+#else
     out_colour = texture(tex_sampler, frag_tex_position);
+#endif
+
+    if (tint_vertex_colour)
+        out_colour.rgb *= frag_colour;
+
+    if (show_texture_coordinates)
+        out_colour = vec4(fract(frag_tex_position), 0.0, 1.0);
 }
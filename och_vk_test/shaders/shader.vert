@@ -1,10 +1,9 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Premultiplied on the CPU
 layout(binding = 0) uniform uniform_buffer_obj{
-    mat4 model;
-    mat4 view;
-    mat4 projection;
+    mat4 model_view_projection;
 } ubo;
 
 layout(location = 0) in vec3 in_position;
@@ -13,9 +12,14 @@ layout(location = 2) in vec2 in_tex_position;
 
 layout(location = 0) out vec3 frag_colour;
 layout(location = 1) out vec2 frag_tex_position;
+layout(location = 2) flat out uint frag_texture_idx;
+
+// Matches depth.vert, whose depth the main pass tests for equality after a pre-pass
+invariant gl_Position;
 
 void main() {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(in_position, 1.0);
+    gl_Position = ubo.model_view_projection * vec4(in_position, 1.0);
     frag_colour = in_colour;
     frag_tex_position = in_tex_position;
+    frag_texture_idx = uint(gl_InstanceIndex);
 }